@@ -4,6 +4,12 @@
 2. Set up multithresholding
 3. Perform FFT
 4. Analyse FFT
+
+Build: g++ -O2 -o main Main.cpp decimator.cpp plans.cpp wavstream.cpp workers.cpp -lsndfile -lfftw3 -lpthread
+Usage: main [file.wav] [--stream] [--channel <k|all>] [--rate <Hz>]
+       main --corpus <directory|manifest> [--workers n] [--summary corpus.json] [--channel <k|all>] [--rate <Hz>]
+--rate is the rate recordings are decimated to before analysis, the Pi's 8kHz by default,
+so windows have the same length and band indeces as on the device. 0 analyses at the file's rate.
 */
 
 #include <cstdio>
@@ -14,29 +20,42 @@
 #include <iostream>
 #include <fstream>
 #include <math.h>
+#include <string>
+#include <chrono>
+#include <algorithm>
+#include <vector>
+#include <thread>
+#include <dirent.h>
+#include "decimator.h"
+#include "detconfig.h"
+#include "plans.h"
+#include "wavstream.h"
+#include "workers.h"
 
 // Extreme doppler effect coefficients
-const double DOPPLER_MIN = 0.8491;
-const double DOPPLER_MAX = 1.0425;
+constexpr double DOPPLER_MIN = 0.8491;
+constexpr double DOPPLER_MAX = 1.0425;
 // Define doppler-adjusted frequency band of interest
-const double BAND_FREQ_MIN = 700;
-const double BAND_FREQ_MAX = 1550;
+constexpr double BAND_FREQ_MIN = 700;
+constexpr double BAND_FREQ_MAX = 1550;
 // Frequencies for multithresholding
-const double noiseThreshLowMin = 150;
-const double noiseThreshLowMax = 510;
-const double noiseThreshHighMin = 1885;
-const double noiseThreshHighMax = 3000;
+constexpr double noiseThreshLowMin = 150;
+constexpr double noiseThreshLowMax = 510;
+constexpr double noiseThreshHighMin = 1885;
+constexpr double noiseThreshHighMax = 3000;
 // Number of bands for multithresholding
 const int BANDS = 6;
 const int noiseMultiplier = 2.5;
 // Sampling constants
-const double fullWindow = 2.058; // Seconds
+constexpr double fullWindow = 2.058; // Seconds
 const int W = 2; // Number of windows to keep
 // Directionality constants
 const int SPLIT = 2;
-const double subWindow = fullWindow / SPLIT;
+constexpr double subWindow = fullWindow / SPLIT;
 const int SW = SPLIT * W;
 const double dirMargin = 0.02; // Changes below this magnitude (%) are considered to be inconclusive
+const int ALL_CHANNELS = -1; // Channel selection analysing every channel of a recording
+const int ANALYSIS_RATE = 8000; // Hz, as sampled on the Pi
 
 struct rec_data {
 	int channels;
@@ -45,20 +64,32 @@ struct rec_data {
 	double *samples;
 };
 
-struct multi_thresh_indeces {
-	int bandIndeces[BANDS + 1];
-	int bandLength;
-	int noiseIndexLowMin;
-	int noiseIndexLowMax;
-	int noiseIndexHighMin;
-	int noiseIndexHighMax;
+// The band layout above, see detconfig.h
+struct recording_bands {
+	static constexpr int bands = BANDS;
+	static constexpr double bandMin = BAND_FREQ_MIN;
+	static constexpr double bandMax = BAND_FREQ_MAX;
+	static constexpr double dopplerMin = DOPPLER_MIN;
+	static constexpr double dopplerMax = DOPPLER_MAX;
+	static constexpr double noiseLowMin = noiseThreshLowMin;
+	static constexpr double noiseLowMax = noiseThreshLowMax;
+	static constexpr double noiseHighMin = noiseThreshHighMin;
+	static constexpr double noiseHighMax = noiseThreshHighMax;
 };
 
+typedef band_table<BANDS> multi_thresh_indeces;
+
+// Parent windows at ANALYSIS_RATE, accounting for doppler, and the sub-windows direction compares, ignoring it
+typedef detector_config<recording_bands, (int)(fullWindow * ANALYSIS_RATE), ANALYSIS_RATE, true> parent_config;
+typedef detector_config<recording_bands, (int)(subWindow * ANALYSIS_RATE), ANALYSIS_RATE, false> sub_config;
+
+// Transforms straight off the interleaved frames, no de-interleaved copy
 struct fft_vars {
-	double *window;
-	fftw_complex *out;   
-	fftw_plan p;
+	fftw_complex *out;   // [rows][nWindow/2+1]
+	fftw_plan p;   // Strided by the channel count, one transform per row
 	double *absFFT;
+	int rows;   // # of channels transformed per execute, 1 or all of them
+	int first;   // Channel of row 0
 };
 
 struct fft_analysis {
@@ -110,58 +141,71 @@ rec_data readRecording(const char* fileName) {
 	return data;
 }
 
-multi_thresh_indeces setupMultiThresholding(const int &n, const int &fs, const bool &doppler) {
+// Whether recordings at fs are decimated before analysis, only ever to a lower rate
+bool decimates(const int &fs, const int &rate) {
+	return (rate > 0) && (rate < fs);
+}
 
-	multi_thresh_indeces mtIndeces;
+// Replaces the samples of a recording by their decimation to rate
+void decimateRecording(rec_data &rec, const int &rate) {
+	decimator dec = SetupDecimator(rec.fs, rate, rec.channels);
+	double *samples = (double*)malloc(sizeof(double) * rec.channels * (rec.n * dec.up / dec.down + 1));
+	rec.n = Decimate(dec, rec.samples, rec.n, samples);
+	rec.fs = rate;
+	free(rec.samples);
+	rec.samples = samples;
+	FreeDecimator(dec);
+}
 
-	double threshLow = BAND_FREQ_MIN * (1 + (doppler * (DOPPLER_MAX - 1)));
-	double threshHigh = BAND_FREQ_MAX * (1 + (doppler * (DOPPLER_MIN - 1)));
+multi_thresh_indeces setupMultiThresholding(const int &n, const int &fs, const bool &doppler) {
 	// TESTING ONLY
-	printf("The band minimum is %.1f and the maximum is %.1f \n", threshLow, threshHigh);
-
-	// Find array indeces
-	double df = (double)fs / (double)n;
-	mtIndeces.bandIndeces[0] = (int)(threshLow / df);
-	mtIndeces.bandIndeces[BANDS] = (int)(threshHigh / df);
-	mtIndeces.bandLength = (mtIndeces.bandIndeces[BANDS] - mtIndeces.bandIndeces[0]) / BANDS;
-	for (int i = 1; i < BANDS; i++) {
-		mtIndeces.bandIndeces[i] = mtIndeces.bandIndeces[i - 1] + mtIndeces.bandLength;
-	}
-
-	mtIndeces.noiseIndexLowMin = (int)(noiseThreshLowMin / df);
-	mtIndeces.noiseIndexLowMax = (int)(noiseThreshLowMax / df);
-	mtIndeces.noiseIndexHighMin = (int)(noiseThreshHighMin / df);
-	mtIndeces.noiseIndexHighMax = (int)(noiseThreshHighMax / df);
+	printf("The band minimum is %.1f and the maximum is %.1f \n", BandLow<recording_bands>(doppler), BandHigh<recording_bands>(doppler));
 
-	return mtIndeces;
+	return BandTable<recording_bands>(n, fs, doppler);
 }
 
-fft_vars setupFFT(const int &nWindow) {
+// Plans the transforms of one channel, or every channel with ALL_CHANNELS, of frames interleaved as read from the file
+fft_vars setupFFT(const int &nWindow, const int &channels, const int &channel) {
 	fft_vars vars;
-	vars.window = (double*)malloc(sizeof(double) * 2 * (nWindow / 2 - 1));
-	vars.out = (fftw_complex*)fftw_malloc(sizeof(fftw_complex) * 2 * (nWindow / 2 - 1));   // In-place fft requires in and 
-																						   // out to accomodate two out-arrays   
-																						   // Complex 1D, n/2-1 length output
-	vars.p = fftw_plan_dft_r2c_1d(nWindow, vars.window, vars.out, FFTW_ESTIMATE); // MEASURE consumes extra time on initial 
-																				  // plan execution. ESTIMATE has no initial timecost.
+	vars.rows = (channel == ALL_CHANNELS) ? channels : 1;
+	vars.first = std::max(channel, 0);
+	vars.out = (fftw_complex*)fftw_malloc(sizeof(fftw_complex) * (nWindow / 2 + 1) * vars.rows);   // Complex 1D, n/2+1 length output per row
+	// One plan per length and layout, loaded from wisdom after the first run. Windows start
+	// at any frame, so the input is unaligned, and consecutive channels are one sample apart.
+	vars.p = GetPlan(nWindow, false, vars.rows, 1, FFTW_UNALIGNED, channels);
 	vars.absFFT = (double*)malloc(sizeof(double) * (nWindow / 2 - 1));	
 
 	return vars;
 }
 
-fft_analysis doFFT(fft_vars vars, const rec_data &rec, const multi_thresh_indeces &mtIndeces, const int &nWindow, int i) {
-	fft_analysis fftAnal;
+void freeFFT(fft_vars &vars) {
+	fftw_free(vars.out);
+	free(vars.absFFT);
+}
 
-	// SPLIT up sound file
-	for (int j = 0; j < rec.channels * nWindow; j += rec.channels) {
-		vars.window[j >> (rec.channels >> 1)] = rec.samples[i*nWindow + j]; // Ignore all channels but channel 0 
+// Exits unless the recording has the selected channel
+void checkChannel(const int &channel, const int &channels, const char* fileName) {
+	if (channel >= channels) {
+		printf("%s has no channel %d, only %d \n", fileName, channel, channels);
+		exit(1);
 	}
-	fftw_execute(vars.p); // Repeatable
+}
+
+// Transforms one window starting at frames, interleaved as read from the file, on every row of vars
+void transformWindow(fft_vars vars, const double *frames) {
+	// r2c leaves its input untouched, so the frames are read in place
+	fftw_execute_dft_r2c(vars.p, const_cast<double*>(frames) + vars.first, vars.out); // Repeatable
+}
+
+// Analyses the spectrum of one row of the last transformed window
+fft_analysis analyseChannel(fft_vars vars, const int &row, const multi_thresh_indeces &mtIndeces, const int &nWindow) {
+	fft_analysis fftAnal;
+	const fftw_complex *out = vars.out + (long)row * (nWindow / 2 + 1);
 
 	// Obtain absolute, normalised FFT
-	vars.absFFT[0] = vars.out[0][0] / nWindow;
+	vars.absFFT[0] = out[0][0] / nWindow;
 	for (long j = 1; j < (nWindow / 2 - 1); j++) {
-		vars.absFFT[j] = 2 * sqrt(pow(vars.out[j][0], 2) + pow(vars.out[j][1], 2)) / nWindow;
+		vars.absFFT[j] = 2 * sqrt(pow(out[j][0], 2) + pow(out[j][1], 2)) / nWindow;
 	}
 
 	// Obtain noise levels
@@ -185,18 +229,59 @@ fft_analysis doFFT(fft_vars vars, const rec_data &rec, const multi_thresh_indece
 		fftAnal.bandAvgs[j] = totalVol[j] / mtIndeces.bandLength;
 	}
 
+	return fftAnal;
+}
+
+// As analyseChannel for a window fixed at compile time, only the bins multithresholding reads
+template<typename Config>
+fft_analysis analyseChannelFixed(fft_vars vars, const int &row, const multi_thresh_indeces &, const int &) {
+	fft_analysis fftAnal;
+	const fftw_complex *out = vars.out + (long)row * (Config::n / 2 + 1);
+
+	for (int j = Config::lo; j < Config::hi; j++) {
+		vars.absFFT[j] = 2 * sqrt(pow(out[j][0], 2) + pow(out[j][1], 2)) / Config::n;
+	}
+	fftAnal.noiseThresh = noiseMultiplier * SpectrumBands<Config>(vars.absFFT, fftAnal.bandAvgs) / Config::noiseBins;
+
+	return fftAnal;
+}
+
+typedef fft_analysis (*channel_analyser)(fft_vars vars, const int &row, const multi_thresh_indeces &mtIndeces, const int &nWindow);
+
+// The analysis compiled for a window, or the one reading mtIndeces for any other length and rate
+channel_analyser analyserFor(const int &n, const int &fs, const bool &doppler) {
+	if ((n == parent_config::n) && (fs == parent_config::rate) && doppler) {
+		return analyseChannelFixed<parent_config>;
+	}
+	if ((n == sub_config::n) && (fs == sub_config::rate) && !doppler) {
+		return analyseChannelFixed<sub_config>;
+	}
+	return analyseChannel;
+}
+
+void printAnalysis(const fft_analysis &fftAnal, const int &i) {
 	// Print for testing
 	printf("Window %d: The noise threshold is %f, and the band averages are", i, fftAnal.noiseThresh);
 	for (int j = 0; j < BANDS; j++) {
 		printf(" %f ", fftAnal.bandAvgs[j]);
 	}
 	printf("\n");
+}
 
-	return fftAnal;
+// Labels output per channel, when more than one is analysed
+void printChannel(const fft_vars &vars, const int &row) {
+	if (vars.rows > 1) {
+		printf("Channel %d ", vars.first + row);
+	}
 }
 
+// Transforms window i of the recording, i windows of nWindow frames in
+void doFFT(fft_vars vars, const rec_data &rec, const int &nWindow, int i) {
+	transformWindow(vars, rec.samples + (long)i * nWindow * rec.channels);
+}
 
-void detect(const fft_analysis &fftAnal, int(&detectedBands)[BANDS]) {
+// Returns the # of bands above the noise threshold
+int countBands(const fft_analysis &fftAnal, int(&detectedBands)[BANDS]) {
 	int detections = 0;
 
 	for (int i = 0; i < BANDS; i++) {
@@ -205,6 +290,11 @@ void detect(const fft_analysis &fftAnal, int(&detectedBands)[BANDS]) {
 	for (int i = 0; i < BANDS; i++)	{
 		detections += detectedBands[i];
 	}
+	return detections;
+}
+
+void detect(const fft_analysis &fftAnal, int(&detectedBands)[BANDS]) {
+	int detections = countBands(fftAnal, detectedBands);
 	printf("The siren is present in %d out of %d bands, and they are:", detections, BANDS);
 
 	for (int j = 0; j < BANDS; j++)	{
@@ -213,23 +303,36 @@ void detect(const fft_analysis &fftAnal, int(&detectedBands)[BANDS]) {
 	printf("\n");
 }
 
+// Average level of a window over its detected bands
+double windowLevel(const fft_analysis &fftAnal, const int (&detectedBands)[BANDS]) {
+	double windowAvg = 0;
+
+	for (int j = 0; j < BANDS; j++) {
+		windowAvg += (fftAnal.bandAvgs[j] * detectedBands[j]);
+	}
+	return windowAvg / BANDS;
+}
+
+// 1 if the EV is approaching, -1 if moving away, 0 if inconclusive, from the relative change in level
+int directionVerdict(const double &rel) {
+	return (rel > (1 + dirMargin)) - (rel < (1 - dirMargin));
+}
+
 // Compare only parent windows
 void directionParentOnly(const fft_analysis *fftAnals, const int (&detectedBands)[W][BANDS]) {
 	double windowAvgs[W] = { 0 };
 
 	for (int i = 0; i < W; i++) {
-		for (int j = 0; j < BANDS; j++) {
-			windowAvgs[i] += (fftAnals[i].bandAvgs[j] * detectedBands[i][j]);
-		}
-		windowAvgs[i] = windowAvgs[i] / BANDS;
+		windowAvgs[i] = windowLevel(fftAnals[i], detectedBands[i]);
 	}
 
 	for (int i = 1; i < W; i++) {
 		double rel = windowAvgs[i] / windowAvgs[i - 1];
-		if (rel > (1 + dirMargin)) {
+		int dir = directionVerdict(rel);
+		if (dir > 0) {
 			printf("Detected EV is approaching at %f. \n", rel);
 		}
-		else if (rel < (1 - dirMargin)) {
+		else if (dir < 0) {
 			printf("Detected EV is moving away at %f. \n", rel);
 		}
 		else {
@@ -238,13 +341,13 @@ void directionParentOnly(const fft_analysis *fftAnals, const int (&detectedBands
 	}
 }
 
-// Compare all subwindows but only in parent detected bands
+// Compare all subwindows of window i but only in parent detected bands
 void directionSubParentBands(const fft_analysis *fftSubs, const int *detectedBands, const int &i) {
 	double windowAvgs[SPLIT] = { 0 };
 	printf("Window %d direction: \n", i);
 	for (int j = 0; j < SPLIT; j++) {
 		for (int k = 0; k < BANDS; k++) {
-			windowAvgs[j] += (fftSubs[SPLIT*i+j].bandAvgs[k] * detectedBands[k]);
+			windowAvgs[j] += (fftSubs[j].bandAvgs[k] * detectedBands[k]);
 		}
 		windowAvgs[j] = windowAvgs[j] / BANDS;
 		printf(" %f ", windowAvgs[j]);
@@ -252,7 +355,7 @@ void directionSubParentBands(const fft_analysis *fftSubs, const int *detectedBan
 	printf("\n");
 }
 
-// Compare all subwindows, in all bands (and with doppler-ignoring bands)
+// Compare all subwindows of window i, in all bands (and with doppler-ignoring bands)
 // NB: Currently *accumulating* subwindow averages
 void directionSubAllBands(const fft_analysis *fftSubs, const int &i) {
 	double windowAvgs[SPLIT] = { 0 };
@@ -262,7 +365,7 @@ void directionSubAllBands(const fft_analysis *fftSubs, const int &i) {
 	printf("Window %d direction: \n", i);
 	for (int j = 0; j < SPLIT; j++) {
 		for (int k = 0; k < BANDS; k++) {
-			windowAvgs[j] += (fftSubs[SPLIT*i + j].bandAvgs[k]);
+			windowAvgs[j] += (fftSubs[j].bandAvgs[k]);
 		}
 		windowAvgs[j] = windowAvgs[j] / BANDS;
 		windowAvgsTotal += windowAvgs[j];
@@ -285,52 +388,497 @@ void directionSubAllBands(const fft_analysis *fftSubs, const int &i) {
 	printf("Detected EV is moving in direction %d \n", dir);
 }
 
-int main()
+// Analyses a recording of any length window by window as it is read, keeping
+// only the last W windows' analyses and one window of samples in memory
+void streamRecording(const char* fileName, const int &channel, const int &rate) {
+	wav_stream stream;
+	OpenWavStream(stream, fileName);
+	checkChannel(channel, stream.channels, fileName);
+	auto begin = std::chrono::steady_clock::now();
+
+	bool decimate = decimates(stream.fs, rate);
+	int fs = decimate ? rate : stream.fs;
+	int nWindow = fullWindow * fs;
+	int nSubWindow = subWindow * fs;
+	multi_thresh_indeces mtIndeces = setupMultiThresholding(nWindow, fs, true); // Account doppler
+	multi_thresh_indeces mtIndecesDir = setupMultiThresholding(nSubWindow, fs, false); // Ignore doppler
+	channel_analyser analyse = analyserFor(nWindow, fs, true);
+	channel_analyser analyseDir = analyserFor(nSubWindow, fs, false);
+	fft_vars fftV = setupFFT(nWindow, stream.channels, channel);
+	fft_vars fftVDir = setupFFT(nSubWindow, stream.channels, channel);
+	SavePlanRegistry();
+
+	int rows = fftV.rows;
+	double *frames = (double*)malloc(sizeof(double) * stream.channels * nWindow);
+	decimator dec;
+	double *in = NULL;   // A window's worth of frames at the file's rate
+	long need = nWindow;
+	if (decimate) {
+		dec = SetupDecimator(stream.fs, fs, stream.channels);
+		in = (double*)malloc(sizeof(double) * stream.channels * ((long)nWindow * dec.down / dec.up + 1));
+		need = DecimatorInput(dec, nWindow);
+	}
+	fft_analysis (*fftAnals)[W] = new fft_analysis[rows][W]();
+	int (*detectedBands)[W][BANDS] = new int[rows][W][BANDS]();
+	fft_analysis (*fftAnalsDir)[SPLIT] = new fft_analysis[rows][SPLIT];
+	long windows = 0;
+
+	while (ReadFrames(stream, decimate ? in : frames, need) == need) {
+		if (decimate) {
+			Decimate(dec, in, need, frames);
+			need = DecimatorInput(dec, nWindow);
+		}
+
+		// Parent window, every channel in one transform
+		transformWindow(fftV, frames);
+		for (int r = 0; r < rows; r++) {
+			// Oldest window first, as directionParentOnly expects
+			for (int i = 1; i < W; i++) {
+				fftAnals[r][i - 1] = fftAnals[r][i];
+				std::copy(detectedBands[r][i], detectedBands[r][i] + BANDS, detectedBands[r][i - 1]);
+			}
+
+			fftAnals[r][W - 1] = analyse(fftV, r, mtIndeces, nWindow);
+			printChannel(fftV, r);
+			printAnalysis(fftAnals[r][W - 1], windows);
+			detect(fftAnals[r][W - 1], detectedBands[r][W - 1]);
+			if (windows + 1 >= W) {
+				directionParentOnly(fftAnals[r], detectedBands[r]);
+			}
+		}
+
+		// Sub-windows of this parent
+		for (int j = 0; j < SPLIT; j++) {
+			transformWindow(fftVDir, frames + (long)j * nSubWindow * stream.channels);
+			for (int r = 0; r < rows; r++) {
+				fftAnalsDir[r][j] = analyseDir(fftVDir, r, mtIndecesDir, nSubWindow);
+				printChannel(fftVDir, r);
+				printAnalysis(fftAnalsDir[r][j], SPLIT*windows + j);
+			}
+		}
+		for (int r = 0; r < rows; r++) {
+			printChannel(fftVDir, r);
+			directionSubAllBands(fftAnalsDir[r], windows);
+		}
+		windows++;
+	}
+
+	double elapsed = std::chrono::duration<double>(std::chrono::steady_clock::now() - begin).count();
+	printf("Streamed %ld windows (%.1f s of audio) in %.2f s. \n", windows, (double)windows * nWindow / fs, elapsed);
+
+	CloseWavStream(stream);
+	free(frames);
+	if (decimate) {
+		FreeDecimator(dec);
+		free(in);
+	}
+	delete[] fftAnals;
+	delete[] detectedBands;
+	delete[] fftAnalsDir;
+	freeFFT(fftV);
+	freeFFT(fftVDir);
+}
+
+// A recording of a corpus and what it is known to contain
+struct corpus_entry {
+	std::string path;
+	int label;   // 1 if a siren is present, 0 if not, -1 if unlabelled
+	int direction;   // Expected directionVerdict, 0 if unknown
+};
+
+struct corpus_result {
+	bool opened;
+	int fs;
+	int windows;   // # of whole parent windows analysed
+	int detectedWindows;
+	double timeToDetect;   // Seconds of audio until the end of the first detected window, -1 if none
+	int direction;   // Sign of the summed verdicts of consecutive detected windows
+	double seconds;   // Processing time of the file
+};
+
+// Per-worker analysis state, rebuilt whenever a file's rate or channel count differs from the last one
+struct corpus_worker {
+	int fs;   // The file's rate
+	int channels;
+	int channel;   // The selected channel, or ALL_CHANNELS
+	int rate;   // The analysis rate asked for, 0 for the file's own
+	bool decimate;
+	decimator dec;
+	int nWindow;   // At the analysis rate
+	multi_thresh_indeces mtIndeces;
+	channel_analyser analyse;
+	fft_vars fftV;
+	double *frames;
+	long capacity;   // # of doubles frames holds
+	double *in;   // Frames at the file's rate, when decimating
+	long inCapacity;
+};
+
+// Lists the .wav files of a directory, unlabelled, or reads a manifest of "file label [direction]" lines
+std::vector<corpus_entry> readCorpus(const char* path) {
+	std::vector<corpus_entry> corpus;
+	std::string base = path;
+	DIR *dir = opendir(path);
+
+	if (dir) {
+		struct dirent *ent;
+		while ((ent = readdir(dir))) {
+			std::string name = ent->d_name;
+			if ((name.size() > 4) && (name.compare(name.size() - 4, 4, ".wav") == 0)) {
+				corpus.push_back({ base + "/" + name, -1, 0 });
+			}
+		}
+		closedir(dir);
+		std::sort(corpus.begin(), corpus.end(), [](const corpus_entry &a, const corpus_entry &b) { return a.path < b.path; });
+		return corpus;
+	}
+
+	std::ifstream manifest(path);
+	if (!manifest) {
+		printf("Not able to open corpus %s \n", path);
+		exit(1);
+	}
+	// Manifest entries are relative to the manifest
+	size_t slash = base.rfind('/');
+	base = (slash == std::string::npos) ? "" : base.substr(0, slash + 1);
+
+	std::string line;
+	while (std::getline(manifest, line)) {
+		char file[1024], label[32], direction[32];
+		int fields = sscanf(line.c_str(), "%1023s %31s %31s", file, label, direction);
+		if ((fields < 1) || (file[0] == '#')) {
+			continue;
+		}
+		corpus_entry entry = { (file[0] == '/') ? file : base + file, -1, 0 };
+		if (fields > 1) {
+			std::string l = label;
+			entry.label = ((l == "siren") || (l == "1")) ? 1 : ((l == "none") || (l == "0")) ? 0 : -1;
+		}
+		if (fields > 2) {
+			std::string d = direction;
+			entry.direction = (d == "approaching") - (d == "away");
+		}
+		corpus.push_back(entry);
+	}
+	return corpus;
+}
+
+// Runs the parent-window detection over one file without printing, one window in memory at a time.
+// With every channel analysed, a window is detected if any channel detects it.
+corpus_result evaluateFile(corpus_worker &wk, const corpus_entry &entry) {
+	auto begin = std::chrono::steady_clock::now();
+	corpus_result res = { false, 0, 0, 0, -1, 0, 0 };
+	SNDFILE *file;
+	SF_INFO sfinfo;
+
+	if (!(file = sf_open(entry.path.c_str(), SFM_READ, &sfinfo))) {
+		return res;
+	}
+	if (wk.channel >= sfinfo.channels) {   // Counted as failed
+		sf_close(file);
+		return res;
+	}
+	res.opened = true;
+	res.fs = sfinfo.samplerate;
+
+	if ((wk.fs != sfinfo.samplerate) || (wk.channels != sfinfo.channels)) {
+		if (wk.fs) {
+			freeFFT(wk.fftV);
+		}
+		if (wk.fs && wk.decimate) {
+			FreeDecimator(wk.dec);
+		}
+		wk.fs = sfinfo.samplerate;
+		wk.channels = sfinfo.channels;
+		wk.decimate = decimates(wk.fs, wk.rate);
+		int fs = wk.decimate ? wk.rate : wk.fs;
+		wk.nWindow = fullWindow * fs;
+		wk.mtIndeces = setupMultiThresholding(wk.nWindow, fs, true); // Account doppler
+		wk.analyse = analyserFor(wk.nWindow, fs, true);
+		wk.fftV = setupFFT(wk.nWindow, wk.channels, wk.channel);
+		if (wk.decimate) {
+			wk.dec = SetupDecimator(wk.fs, fs, wk.channels);
+		}
+	}
+	if (wk.capacity < (long)wk.nWindow * sfinfo.channels) {
+		wk.capacity = (long)wk.nWindow * sfinfo.channels;
+		wk.frames = (double*)realloc(wk.frames, sizeof(double) * wk.capacity);
+	}
+	long need = wk.nWindow;
+	if (wk.decimate) {
+		ResetDecimator(wk.dec);
+		long inCapacity = ((long)wk.nWindow * wk.dec.down / wk.dec.up + 1) * sfinfo.channels;
+		if (wk.inCapacity < inCapacity) {
+			wk.inCapacity = inCapacity;
+			wk.in = (double*)realloc(wk.in, sizeof(double) * wk.inCapacity);
+		}
+		need = DecimatorInput(wk.dec, wk.nWindow);
+	}
+	double windowSeconds = (double)wk.nWindow / (wk.decimate ? wk.rate : wk.fs);
+
+	int rows = wk.fftV.rows;
+	fft_analysis *prev = new fft_analysis[rows];
+	int (*prevBands)[BANDS] = new int[rows][BANDS];
+	std::vector<char> prevDetected(rows, false);
+	int dirSum = 0;
+
+	while (sf_readf_double(file, wk.decimate ? wk.in : wk.frames, need) == need) {
+		if (wk.decimate) {
+			Decimate(wk.dec, wk.in, need, wk.frames);
+			need = DecimatorInput(wk.dec, wk.nWindow);
+		}
+		transformWindow(wk.fftV, wk.frames);
+		bool anyDetected = false;
+		res.windows++;
+
+		for (int r = 0; r < rows; r++) {
+			int detectedBands[BANDS];
+			fft_analysis fftAnal = wk.analyse(wk.fftV, r, wk.mtIndeces, wk.nWindow);
+			bool detected = (countBands(fftAnal, detectedBands) > (BANDS / 2));
+
+			if (detected && prevDetected[r]) {
+				dirSum += directionVerdict(windowLevel(fftAnal, detectedBands) / windowLevel(prev[r], prevBands[r]));
+			}
+			prev[r] = fftAnal;
+			std::copy(detectedBands, detectedBands + BANDS, prevBands[r]);
+			prevDetected[r] = detected;
+			anyDetected |= detected;
+		}
+
+		if (anyDetected) {
+			res.detectedWindows++;
+			if (res.timeToDetect < 0) {
+				res.timeToDetect = res.windows * windowSeconds;
+			}
+		}
+	}
+	sf_close(file);
+	delete[] prev;
+	delete[] prevBands;
+
+	res.direction = (dirSum > 0) - (dirSum < 0);
+	res.seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - begin).count();
+	return res;
+}
+
+void writeJsonString(FILE *out, const std::string &str) {
+	fputc('"', out);
+	for (char c : str) {
+		if ((c == '"') || (c == '\\')) {
+			fputc('\\', out);
+		}
+		fputc(c, out);
+	}
+	fputc('"', out);
+}
+
+// One JSON document: a result per file in corpus order, then the totals
+void writeSummary(const char* fileName, const std::vector<corpus_entry> &corpus, const std::vector<corpus_result> &results, const int &workers, const double &elapsed) {
+	FILE *out = fopen(fileName, "w");
+	if (!out) {
+		printf("Not able to write summary %s \n", fileName);
+		exit(1);
+	}
+
+	int failed = 0, tp = 0, fp = 0, tn = 0, fn = 0, dirLabelled = 0, dirCorrect = 0, detectedFiles = 0;
+	double audio = 0, detectTime = 0;
+
+	fprintf(out, "{\n\t\"files\": [\n");
+	for (size_t i = 0; i < corpus.size(); i++) {
+		const corpus_result &res = results[i];
+		bool detected = (res.detectedWindows > 0);
+
+		fprintf(out, "\t\t{\"path\": ");
+		writeJsonString(out, corpus[i].path);
+		fprintf(out, ", \"label\": %d, \"opened\": %s, \"fs\": %d, \"windows\": %d, \"detected_windows\": %d, \"detected\": %s, "
+			"\"time_to_detect\": %.3f, \"direction\": %d, \"seconds\": %.4f}%s\n",
+			corpus[i].label, res.opened ? "true" : "false", res.fs, res.windows, res.detectedWindows, detected ? "true" : "false",
+			res.timeToDetect, res.direction, res.seconds, (i + 1 < corpus.size()) ? "," : "");
+
+		if (!res.opened) {
+			failed++;
+			continue;
+		}
+		audio += (double)res.windows * fullWindow;
+		if (detected) {
+			detectedFiles++;
+			detectTime += res.timeToDetect;
+		}
+		tp += (corpus[i].label == 1) && detected;
+		fn += (corpus[i].label == 1) && !detected;
+		fp += (corpus[i].label == 0) && detected;
+		tn += (corpus[i].label == 0) && !detected;
+		if (corpus[i].direction && detected) {
+			dirLabelled++;
+			dirCorrect += (res.direction == corpus[i].direction);
+		}
+	}
+	fprintf(out, "\t],\n\t\"summary\": {\"files\": %zu, \"failed\": %d, \"workers\": %d, \"seconds\": %.3f, \"files_per_s\": %.2f, "
+		"\"audio_seconds\": %.1f, \"realtime_factor\": %.1f, \"tp\": %d, \"fp\": %d, \"tn\": %d, \"fn\": %d, "
+		"\"mean_time_to_detect\": %.3f, \"direction_labelled\": %d, \"direction_correct\": %d}\n}\n",
+		corpus.size(), failed, workers, elapsed, corpus.size() / elapsed, audio, audio / elapsed, tp, fp, tn, fn,
+		detectedFiles ? detectTime / detectedFiles : -1.0, dirLabelled, dirCorrect);
+	fclose(out);
+
+	printf("%zu files (%d failed, %.1f s of audio) in %.2f s on %d workers, %.1f files/s. tp %d fp %d tn %d fn %d \n",
+		corpus.size(), failed, audio, elapsed, workers, corpus.size() / elapsed, tp, fp, tn, fn);
+}
+
+// Evaluates every recording of a corpus concurrently, longest files balanced by work stealing
+void evaluateCorpus(const char* path, const int &workers, const char* summaryFile, const int &channel, const int &rate) {
+	std::vector<corpus_entry> corpus = readCorpus(path);
+	std::vector<corpus_result> results(corpus.size());
+	std::vector<corpus_worker> wks(workers);
+	for (corpus_worker &wk : wks) {
+		wk.fs = 0;
+		wk.channels = 0;
+		wk.channel = channel;
+		wk.rate = rate;
+		wk.decimate = false;
+		wk.frames = NULL;
+		wk.capacity = 0;
+		wk.in = NULL;
+		wk.inCapacity = 0;
+	}
+
+	worker_pool pool;
+	SetupWorkerPool(pool, workers);
+	auto begin = std::chrono::steady_clock::now();
+	RunOnPoolStealing(pool, corpus.size(), [&](const int &worker, const int &task) {
+		results[task] = evaluateFile(wks[worker], corpus[task]);
+	});
+	double elapsed = std::chrono::duration<double>(std::chrono::steady_clock::now() - begin).count();
+	FreeWorkerPool(pool);
+	SavePlanRegistry();
+
+	writeSummary(summaryFile, corpus, results, workers, elapsed);
+
+	for (corpus_worker &wk : wks) {
+		if (wk.fs) {
+			freeFFT(wk.fftV);
+		}
+		if (wk.fs && wk.decimate) {
+			FreeDecimator(wk.dec);
+		}
+		free(wk.frames);
+		free(wk.in);
+	}
+}
+
+int main(int argc, char *argv[])
 {
+	const char *fileName = "yt_yelp_approaching.wav";
+	const char *corpus = NULL;
+	const char *summaryFile = "corpus.json";
+	int workers = std::max((int)std::thread::hardware_concurrency(), 1);
+	bool stream = false;
+	int channel = 0;
+	int rate = ANALYSIS_RATE;
+
+	for (int i = 1; i < argc; i++) {
+		std::string arg = argv[i];
+		if (arg == "--stream") {
+			stream = true;
+		} else if ((arg == "--corpus") && (i + 1 < argc)) {
+			corpus = argv[++i];
+		} else if ((arg == "--workers") && (i + 1 < argc)) {
+			workers = std::max(atoi(argv[++i]), 1);
+		} else if ((arg == "--summary") && (i + 1 < argc)) {
+			summaryFile = argv[++i];
+		} else if ((arg == "--channel") && (i + 1 < argc)) {
+			i++;
+			channel = (std::string(argv[i]) == "all") ? ALL_CHANNELS : std::max(atoi(argv[i]), 0);
+		} else if ((arg == "--rate") && (i + 1 < argc)) {
+			rate = std::max(atoi(argv[++i]), 0);
+		} else {
+			fileName = argv[i];
+		}
+	}
+
+	SetupPlanRegistry(FFTW_MEASURE, WISDOM_FILE);
+
+	if (corpus) {
+		evaluateCorpus(corpus, workers, summaryFile, channel, rate);
+		FreePlanRegistry();
+		return 0;
+	}
+	if (stream) {
+		streamRecording(fileName, channel, rate);
+		FreePlanRegistry();
+		return 0;
+	}
+
 	// Read recording
-	rec_data recording = readRecording("yt_yelp_approaching.wav");
+	rec_data recording = readRecording(fileName);
+	checkChannel(channel, recording.channels, fileName);
+	if (decimates(recording.fs, rate)) {
+		decimateRecording(recording, rate);
+	}
 
 	// --------------------PARENT----------------\\
 	// Set up Multi-thresholding
 	int nWindow = fullWindow * recording.fs;
 	multi_thresh_indeces mtIndeces = setupMultiThresholding(nWindow, recording.fs, true); // Account doppler
+	channel_analyser analyse = analyserFor(nWindow, recording.fs, true);
 
-	fft_vars fftV = setupFFT(nWindow); // DO NOT RUN THIS AGAIN
+	fft_vars fftV = setupFFT(nWindow, recording.channels, channel);
+	int rows = fftV.rows;
 
 	// Obtain FFT-analysis
-	fft_analysis fftAnals[W];
-	int detectedBands[W][BANDS];
+	fft_analysis (*fftAnals)[W] = new fft_analysis[rows][W];
+	int (*detectedBands)[W][BANDS] = new int[rows][W][BANDS];
 	for (int i = 0; i < W; i++) {
-		fftAnals[i] = doFFT(fftV, recording, mtIndeces, nWindow, i);
-		// Detection
-		detect(fftAnals[i], detectedBands[i]);
+		doFFT(fftV, recording, nWindow, i);
+		for (int r = 0; r < rows; r++) {
+			fftAnals[r][i] = analyse(fftV, r, mtIndeces, nWindow);
+			printChannel(fftV, r);
+			printAnalysis(fftAnals[r][i], i);
+			// Detection
+			detect(fftAnals[r][i], detectedBands[r][i]);
+		}
 	}
 
 	// Direction
-	directionParentOnly(fftAnals, detectedBands);
+	for (int r = 0; r < rows; r++) {
+		printChannel(fftV, r);
+		directionParentOnly(fftAnals[r], detectedBands[r]);
+	}
 
 	//---------------------SUB---------------------\\
 	// Set up Multi-thresholding
 	int nSubWindow = subWindow * recording.fs;
 	multi_thresh_indeces mtIndecesDir = setupMultiThresholding(nSubWindow, recording.fs, false); // Ignore doppler
+	channel_analyser analyseDir = analyserFor(nSubWindow, recording.fs, false);
+	fft_vars fftVDir = setupFFT(nSubWindow, recording.channels, channel);
+	SavePlanRegistry();
 
 	// Obtain FFT-analysis
-	fft_analysis fftAnalsDir[SW];
-	int detectedBandsDir[SW][BANDS];
+	fft_analysis (*fftAnalsDir)[SW] = new fft_analysis[rows][SW];
 	for (int i = 0; i < SW; i++) {
-		fftAnalsDir[i] = doFFT(fftV, recording, mtIndecesDir, nSubWindow, i);
+		doFFT(fftVDir, recording, nSubWindow, i);
+		for (int r = 0; r < rows; r++) {
+			fftAnalsDir[r][i] = analyseDir(fftVDir, r, mtIndecesDir, nSubWindow);
+			printChannel(fftVDir, r);
+			printAnalysis(fftAnalsDir[r][i], i);
+		}
 	}
 
 	// Direction
-	for (int i = 0; i < W; i++) {
-		//directionSubParentBands(fftAnalsDir, detectedBands[i], i);
-		directionSubAllBands(fftAnalsDir, i);
+	for (int r = 0; r < rows; r++) {
+		for (int i = 0; i < W; i++) {
+			//directionSubParentBands(fftAnalsDir[r] + SPLIT*i, detectedBands[r][i], i);
+			printChannel(fftVDir, r);
+			directionSubAllBands(fftAnalsDir[r] + SPLIT*i, i);
+		}
 	}
 
-	free(recording.samples);    //in is destroyed by plan execution
-	fftw_destroy_plan(fftV.p);
-	fftw_free(fftV.out);
-	free(fftV.absFFT);
+	free(recording.samples);    // Only read by the transforms
+	delete[] fftAnals;
+	delete[] detectedBands;
+	delete[] fftAnalsDir;
+	freeFFT(fftV);
+	freeFFT(fftVDir);
+	FreePlanRegistry();
 
 	printf("Test was succesful. Somewhat. \n");
 
@@ -0,0 +1,163 @@
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <time.h>
+#include <unistd.h>
+#include <sys/ioctl.h>
+#include <bcm2835.h>
+#include "adcsource.h"
+
+
+/* Prepares a backend. bcm2835 must already be initialised for ADC_BCM2835.
+ * \param[in] backend Where samples come from
+ * \param[in] mock Whether SPI transfers go to the mock MCP3008 instead of hardware
+ * \param[in] rate The sampling rate
+ * \param[in] n The # of frames per block, for the simulated ADC
+ * \param[in] array The ADC input and chip select of every channel, sampled in channel order
+*/
+void SetupAdcSource(adc_source &src, const adc_backend &backend, const bool &mock, const double &rate, const int &n, const mic_array &array)
+{
+	int channels = array.count;
+	src.backend = backend;
+	src.mock = mock;
+	src.channels = channels;
+	src.synthEnd = 0;
+	src.cpu = 0;
+	src.tx = (char*)calloc(channels * 3, 1);
+	src.rx = (char*)calloc(channels * 3, 1);
+	src.xfers = (struct spi_ioc_transfer*)calloc(channels, sizeof(struct spi_ioc_transfer));
+	int x = 0;
+	for (int s = 0; s < MCP_SELECTS; s++) {
+		src.fds[s] = -1;
+		src.first[s] = x;
+		src.count[s] = SelectCount(array, s);
+		for (int ch = 0; ch < channels; ch++) {
+			if (array.mics[ch].select != s) { continue; }
+			src.slot[ch] = x;
+			McpCommand(array.mics[ch].input, src.tx + 3 * x);
+			src.xfers[x].tx_buf = (uintptr_t)(src.tx + 3 * x);
+			src.xfers[x].rx_buf = (uintptr_t)(src.rx + 3 * x);
+			src.xfers[x].len = 3;
+			src.xfers[x].speed_hz = (uint32_t)SPI_CLOCK_HZ;
+			src.xfers[x].bits_per_word = 8;
+			src.xfers[x].cs_change = (x < src.first[s] + src.count[s] - 1);   // Deassert between conversions, not after the last
+			x++;
+		}
+	}
+	SetupSimAdc(src.sim, rate, n, channels);
+	SetupSampleClock(src.clock, rate, SAMPLE_SPIN_NS);
+	SetMockSpiChannels(channels);
+	
+	if (!mock && (backend == ADC_BCM2835)) {
+		SpiSetup();
+	} else if (!mock && (backend == ADC_SPIDEV)) {
+		for (int s = 0; s < MCP_SELECTS; s++) {
+			if (src.count[s] > 0) { src.fds[s] = SpidevOpen(SPIDEV_PATHS[s]); }
+		}
+	}
+}
+
+void FreeAdcSource(adc_source &src)
+{
+	if (!src.mock && (src.backend == ADC_BCM2835)) {
+		bcm2835_spi_end();
+	}
+	for (int s = 0; s < MCP_SELECTS; s++) {
+		if (src.fds[s] >= 0) { close(src.fds[s]); }
+	}
+	if (src.backend == ADC_REPLAY) {
+		CloseReplay(src.replay);
+	}
+	free(src.tx);
+	free(src.rx);
+	free(src.xfers);
+}
+
+// One frame, a transfer per channel, switching chip select once per ADC when both are used
+static void FrameBcm2835(adc_source &src, uint16_t *frame)
+{
+	spi_transfer transfer = src.mock ? MockSpiTransfer : bcm2835_spi_transfernb;
+	bool switching = !src.mock && (src.count[1] > 0);
+	for (int s = 0; s < MCP_SELECTS; s++) {
+		if (switching && (src.count[s] > 0)) {
+			bcm2835_spi_chipSelect(s ? BCM2835_SPI_CS1 : BCM2835_SPI_CS0);
+		}
+		for (int x = src.first[s]; x < src.first[s] + src.count[s]; x++) {
+			transfer(src.tx + 3 * x, src.rx + 3 * x, 3); // send/receive 3 bytes
+		}
+	}
+	for (int ch = 0; ch < src.channels; ch++) {
+		frame[ch] = McpCode(src.rx + 3 * src.slot[ch]);
+	}
+}
+
+// One frame, all channels of each ADC in one message
+static void FrameSpidev(adc_source &src, uint16_t *frame)
+{
+	for (int s = 0; s < MCP_SELECTS; s++) {
+		if (src.count[s] == 0) { continue; }
+		if (src.mock) {
+			MockSpiMessage(src.xfers + src.first[s], src.count[s]);
+		} else if (ioctl(src.fds[s], SPI_IOC_MESSAGE(src.count[s]), src.xfers + src.first[s]) < 0) {
+			printf("SPI message failed \n");
+			exit(1);
+		}
+	}
+	for (int ch = 0; ch < src.channels; ch++) {
+		frame[ch] = McpCode(src.rx + 3 * src.slot[ch]);
+	}
+}
+
+/* Performs an entire sample window or hop (all channels), saving the raw codes
+ * frame by frame as they come off SPI. Conversion is left to the analysis
+ * thread. SPI frames each start on a deadline of the sample clock, whose jitter
+ * stats are reset per call. Called from the sampling thread only.
+ * \param[in] *frames The array that will hold all samples for this window, [n][channels]
+ * \param[in] n The # of samples to take per channel, the block size for ADC_SIM
+ * \return The time taken to complete the sampling window, measured between first samples,
+ * or negative once a replayed capture or generated scene has run out
+*/
+double AdcSample(adc_source &src, uint16_t *frames, const int &n)
+{
+	if (src.backend == ADC_SIM) {
+		return SimSampling(src.sim, frames);
+	}
+	if (src.backend == ADC_REPLAY) {
+		return ReplaySample(src.replay, frames, n);
+	}
+	if (src.backend == ADC_SYNTH) {
+		if (src.synth.i + n > src.synthEnd) { return -1; }
+		GenerateFrames(src.synth, frames, n);
+		return n / src.synth.fs;   // Virtual clock, exactly on rate
+	}
+	
+	void (*frame)(adc_source&, uint16_t*) = (src.backend == ADC_SPIDEV) ? FrameSpidev : FrameBcm2835;
+	struct timespec first, last;
+	
+	ResetJitter(src.clock.jitter);
+	for (int i = 0; i < n; i++) {
+		WaitNextSample(src.clock);
+		if (i == 0) { clock_gettime(CLOCK_MONOTONIC, &first); }
+		if (i == n - 1) { clock_gettime(CLOCK_MONOTONIC, &last); }
+		frame(src, frames + (long)i * src.channels);
+	}
+	
+	double spacing = (last.tv_sec - first.tv_sec) + (last.tv_nsec - first.tv_nsec) / 1e9;
+	return (n > 1) ? spacing * n / (n - 1) : 1.0 / src.clock.fs; // Get actual time
+}
+
+/* Backend by name
+ * \param[in] name "sim", "bcm2835" or "spidev"
+*/
+adc_backend AdcBackend(const char *name)
+{
+	if (strcmp(name, "sim") == 0) { return ADC_SIM; }
+	if (strcmp(name, "spidev") == 0) { return ADC_SPIDEV; }
+	return ADC_BCM2835;
+}
+
+const char *AdcBackendName(const adc_backend &backend)
+{
+	const char *names[5] = {"sim", "bcm2835", "spidev", "replay", "synth"};
+	return names[backend];
+}
@@ -0,0 +1,58 @@
+#ifndef ADCSOURCE_H
+#define ADCSOURCE_H
+
+#include <stdint.h>
+#include <linux/spi/spidev.h>
+#include "adcspi.h"
+#include "capture.h"
+#include "sampleclock.h"
+#include "simadc.h"
+#include "sirengen.h"
+
+enum adc_backend {
+	ADC_SIM,   // Simulated siren, no SPI
+	ADC_BCM2835,   // One bcm2835_spi_transfernb per channel per frame
+	ADC_SPIDEV,   // One SPI_IOC_MESSAGE per frame, all channel conversions chained
+	ADC_REPLAY,   // A recorded capture, opened with OpenReplay before setup
+	ADC_SYNTH   // Generated siren scene on a virtual clock, set up with SetupSirenGen after setup
+};
+
+/* Where sampled frames come from. Every backend fills the same raw
+ * interleaved [n][channels] blocks; the SPI ones pace frames on the sample
+ * clock. The MCP3008 only starts a conversion on a falling chip select, so
+ * conversions can't share one transfer with CS held. The spidev backend
+ * instead chains them as transfers of one message with cs_change set, so the
+ * driver toggles CS in between and a frame costs one call instead of channels.
+ * With ADCs on both chip selects, transfers are grouped per ADC: a frame is a
+ * message per spidev device, or one chip select switch per ADC on bcm2835.
+*/
+struct adc_source {
+	adc_backend backend;
+	bool mock;   // SPI goes to the mock MCP3008, for desktops
+	int channels;
+	sample_clock clock;
+	sim_adc sim;
+	char *tx;   // [channels][3] MCP3008 commands, grouped by chip select
+	char *rx;   // [channels][3] answers
+	int fds[MCP_SELECTS];   // spidev, -1 for a chip select nothing is sampled on
+	struct spi_ioc_transfer *xfers;   // [channels], each chip select's chained into one message
+	int first[MCP_SELECTS];   // Transfers of chip select s are [first[s], first[s] + count[s])
+	int count[MCP_SELECTS];
+	int slot[MAX_CH];   // Transfer of each channel
+	capture_replay replay;
+	siren_gen synth;
+	long synthEnd;   // # of frames the generated scene lasts
+	double cpu;   // CPU seconds the sampling thread spent, once it has finished
+};
+
+void SetupAdcSource(adc_source &src, const adc_backend &backend, const bool &mock, const double &rate, const int &n, const mic_array &array);
+
+void FreeAdcSource(adc_source &src);
+
+double AdcSample(adc_source &src, uint16_t *frames, const int &n);
+
+adc_backend AdcBackend(const char *name);
+
+const char *AdcBackendName(const adc_backend &backend);
+
+#endif
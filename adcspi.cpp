@@ -0,0 +1,126 @@
+#include <cstdio>
+#include <cstdlib>
+#include <math.h>
+#include <time.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/ioctl.h>
+#include <bcm2835.h>
+#include "adcspi.h"
+#include "detection.h"
+
+
+/* The 3 bytes that make the MCP3008 convert one single-ended channel:
+ * start bit, then SGL/DIFF and the channel # in the high nibble
+ * (0x80, 0x90, ... 0xf0 for inputs 0-7)
+ * \param[in] ch The ADC input, 0-7
+ * \param[in] *mosi The 3 bytes to fill
+*/
+void McpCommand(const int &ch, char *mosi)
+{
+	mosi[0] = 0x01;
+	mosi[1] = (char)((0x08 | ch) << 4);
+	mosi[2] = 0x00;
+}
+
+/* The 10-bit code in the last two bytes the MCP3008 answered with
+*/
+uint16_t McpCode(const char *miso)
+{
+	return ((miso[1] & 0x03) << 8) + (unsigned char)miso[2];
+}
+
+/* Configures the SPI communication with the ADC, bcm2835 already initialised
+*/
+void SpiSetup() 
+{
+	bcm2835_spi_begin();
+	bcm2835_spi_setBitOrder(BCM2835_SPI_BIT_ORDER_MSBFIRST);
+	bcm2835_spi_setDataMode(BCM2835_SPI_MODE0); // Data comes in on falling edge
+	bcm2835_spi_setClockDivider(BCM2835_SPI_CLOCK_DIVIDER_256); // 250MHz / 256 = ~1000kHz
+	bcm2835_spi_chipSelect(BCM2835_SPI_CS0);
+	bcm2835_spi_setChipSelectPolarity(BCM2835_SPI_CS0, LOW);
+	bcm2835_spi_setChipSelectPolarity(BCM2835_SPI_CS1, LOW);   // A second MCP3008, if the array has one
+}
+
+/* Opens a spidev device in the same mode and at the same clock as SpiSetup
+ * \param[in] path The device, e.g. SPIDEV_PATHS[0]
+ * \return The open file descriptor
+*/
+int SpidevOpen(const char *path)
+{
+	int fd = open(path, O_RDWR);
+	if (fd < 0) {
+		printf("Could not open %s \n", path);
+		exit(1);
+	}
+	uint8_t mode = SPI_MODE_0;
+	uint8_t bits = 8;
+	uint32_t hz = (uint32_t)SPI_CLOCK_HZ;
+	if ((ioctl(fd, SPI_IOC_WR_MODE, &mode) < 0) || (ioctl(fd, SPI_IOC_WR_BITS_PER_WORD, &bits) < 0) ||
+		(ioctl(fd, SPI_IOC_WR_MAX_SPEED_HZ, &hz) < 0)) {
+		printf("Could not configure %s \n", path);
+		exit(1);
+	}
+	return fd;
+}
+
+static int mockChannels = N_CH;   // Conversions per frame, so the mock tone keeps its pitch
+
+// Sets the # of conversions the mock takes as one frame
+void SetMockSpiChannels(const int &channels)
+{
+	mockChannels = channels;
+}
+
+// Answers one MCP3008 read with a 1 kHz tone plus noise on the requested channel
+static void MockConversion(const char *mosi, char *miso)
+{
+	static unsigned long calls = 0;
+	static unsigned int seed = 1;
+	
+	int ch = (mosi[1] >> 4) & 7;
+	double t = (calls++ / mockChannels) / fs;
+	int code = (int)(512 + 100 * sin(2 * M_PI * 1000 * t) / (1 + ch) + 20 * (2.0 * rand_r(&seed) / RAND_MAX - 1));
+	miso[0] = 0;
+	miso[1] = (code >> 8) & 3;
+	miso[2] = code & 0xff;
+}
+
+// Busy-waits for ns from begin
+static void MockBusy(const struct timespec &begin, const long &ns)
+{
+	struct timespec now;
+	do {
+		clock_gettime(CLOCK_MONOTONIC, &now);
+	} while ((now.tv_sec - begin.tv_sec) * 1000000000L + (now.tv_nsec - begin.tv_nsec) < ns);
+}
+
+/* Stands in for bcm2835_spi_transfernb on a desktop: busy-waits for
+ * MOCK_SPI_CALL_NS plus as long as len bytes take at SPI_CLOCK_HZ, and
+ * answers an MCP3008 read
+*/
+void MockSpiTransfer(char *mosi, char *miso, uint32_t len)
+{
+	struct timespec begin;
+	clock_gettime(CLOCK_MONOTONIC, &begin);
+	
+	MockConversion(mosi, miso);
+	MockBusy(begin, MOCK_SPI_CALL_NS + (long)(len * 8 / SPI_CLOCK_HZ * 1e9));
+}
+
+/* Stands in for ioctl(SPI_IOC_MESSAGE(count)): one call's fixed cost, then
+ * every transfer's bytes, answering each as an MCP3008 read
+*/
+void MockSpiMessage(struct spi_ioc_transfer *xfers, const int &count)
+{
+	struct timespec begin;
+	clock_gettime(CLOCK_MONOTONIC, &begin);
+	
+	long bytes = 0;
+	for (int i = 0; i < count; i++) {
+		MockConversion((const char*)(uintptr_t)xfers[i].tx_buf, (char*)(uintptr_t)xfers[i].rx_buf);
+		bytes += xfers[i].len;
+	}
+	MockBusy(begin, MOCK_SPI_CALL_NS + (long)(bytes * 8 / SPI_CLOCK_HZ * 1e9));
+}
@@ -0,0 +1,29 @@
+#ifndef ADCSPI_H
+#define ADCSPI_H
+
+#include <stdint.h>
+#include <linux/spi/spidev.h>
+#include "micarray.h"
+
+const double SPI_CLOCK_HZ = 250e6 / 256;   // BCM2835_SPI_CLOCK_DIVIDER_256, also what the mock takes per transfer
+const char SPIDEV_PATHS[MCP_SELECTS][16] = {"/dev/spidev0.0", "/dev/spidev0.1"};   // An MCP3008 per chip select, through the kernel driver
+const long MOCK_SPI_CALL_NS = 5000;   // Fixed cost the mock charges per transfer call, driver or register setup
+
+// Full-duplex transfer of len bytes, bcm2835_spi_transfernb or MockSpiTransfer
+typedef void (*spi_transfer)(char *mosi, char *miso, uint32_t len);
+
+void McpCommand(const int &ch, char *mosi);
+
+uint16_t McpCode(const char *miso);
+
+void SpiSetup();
+
+int SpidevOpen(const char *path);
+
+void SetMockSpiChannels(const int &channels);
+
+void MockSpiTransfer(char *mosi, char *miso, uint32_t len);
+
+void MockSpiMessage(struct spi_ioc_transfer *xfers, const int &count);
+
+#endif
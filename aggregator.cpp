@@ -0,0 +1,82 @@
+// Build: g++ -O2 -o aggregator aggregator.cpp fusion.cpp metrics.cpp netproto.cpp -lpthread
+// Fuses the detections of the nodes at an intersection cluster, each a mainpi run with --net <this host>[:port] --node <id>.
+// Run with --port <n> to listen on another port than NET_PORT, --sites <file> for where each node is mounted, one
+// "node x y heading" line per node (metres east and north of a common origin, degrees the array is turned), --span <s>
+// for how far apart detections may be to be fused, --report <s> for how often to print the fused verdict and counts
+
+#include <cstdio>
+#include <cstdlib>
+#include <string>
+#include <csignal>
+#include <atomic>
+#include "fusion.h"
+#include "netproto.h"
+
+std::atomic<bool> running(true);
+
+void StopHandler(int)
+{
+	running = false;
+}
+
+int main(int argc, char *argv[])
+{
+	int port = NET_PORT;
+	const char *sitesFile = NULL;
+	double span = FUSE_SPAN;
+	double report = 1;   // s
+	for (int i = 1; i < argc; i++) {
+		std::string arg = argv[i];
+		if ((arg == "--port") && (i + 1 < argc)) {
+			port = atoi(argv[++i]);
+		} else if ((arg == "--sites") && (i + 1 < argc)) {
+			sitesFile = argv[++i];
+		} else if ((arg == "--span") && (i + 1 < argc)) {
+			span = atof(argv[++i]);
+		} else if ((arg == "--report") && (i + 1 < argc)) {
+			report = atof(argv[++i]);
+		}
+	}
+
+	static fusion fu;
+	SetupFusion(fu);
+	if (sitesFile) { LoadNodeSites(fu, sitesFile); }
+	net_receiver rx;
+	OpenNetReceiver(rx, port);
+	printf("Listening for detections on port %d \n", rx.port);
+	signal(SIGINT, StopHandler);
+
+	uint64_t nextReport = NetNowNs() + (uint64_t)(report * 1e9);
+	uint64_t reported = 0;   // End of the latest detection reported
+	unsigned long lastRecords = 0;
+	while (running) {
+		int count = ReceiveDatagrams(rx, 100);   // Wakes up to report and to see if it was stopped
+		uint64_t now = NetNowNs();
+		for (int d = 0; d < count; d++) {
+			IngestDatagram(fu, rx.buffers[d], rx.msgs[d].msg_len, now);
+		}
+		if (now < nextReport) { continue; }
+
+		fused_estimate est = FuseDetections(fu, span);
+		if (est.nodes && (est.endNs != reported)) {
+			PrintFusion(est);
+			reported = est.endNs;
+		}
+		unsigned long lost = 0;
+		for (int n = 0; n < fu.count; n++) {
+			lost += fu.nodes[n].lost;
+		}
+		if (fu.records != lastRecords) {   // Quiet while no node sends
+			printf("%d nodes, %.0f records/s, %lu datagrams lost, %lu malformed, latency p50 %.1fms p99 %.1fms \n", fu.count,
+				(fu.records - lastRecords) / report, lost, fu.malformed, HistogramPercentile(fu.latency, 50) / 1e6,
+				HistogramPercentile(fu.latency, 99) / 1e6);
+		}
+		lastRecords = fu.records;
+		nextReport = now + (uint64_t)(report * 1e9);
+	}
+
+	CloseNetReceiver(rx);
+	FreeFusion(fu);
+	printf("Program ended \n");
+	return 0;
+}
@@ -0,0 +1,72 @@
+#include <cstddef>
+#include <cstring>
+#include <atomic>
+#include "alloccheck.h"
+
+// glibc's own allocator, which the definitions below forward to
+extern "C" void *__libc_malloc(size_t size);
+extern "C" void *__libc_calloc(size_t n, size_t size);
+extern "C" void *__libc_realloc(void *p, size_t size);
+extern "C" void *__libc_memalign(size_t alignment, size_t size);
+
+static std::atomic<unsigned long> allocs(0);
+static thread_local bool armed = false;   // Plain TLS, reading it never allocates
+
+static inline void NoteAlloc()
+{
+	if (armed) { allocs.fetch_add(1, std::memory_order_relaxed); }
+}
+
+extern "C" void *malloc(size_t size)
+{
+	NoteAlloc();
+	return __libc_malloc(size);
+}
+
+extern "C" void *calloc(size_t n, size_t size)
+{
+	NoteAlloc();
+	return __libc_calloc(n, size);
+}
+
+extern "C" void *realloc(void *p, size_t size)
+{
+	NoteAlloc();
+	return __libc_realloc(p, size);
+}
+
+extern "C" void *memalign(size_t alignment, size_t size)
+{
+	NoteAlloc();
+	return __libc_memalign(alignment, size);
+}
+
+extern "C" void *aligned_alloc(size_t alignment, size_t size)
+{
+	NoteAlloc();
+	return __libc_memalign(alignment, size);
+}
+
+extern "C" int posix_memalign(void **p, size_t alignment, size_t size)
+{
+	NoteAlloc();
+	*p = __libc_memalign(alignment, size);
+	return *p ? 0 : 12;   // ENOMEM
+}
+
+// From here on, heap allocations on the calling thread are counted
+void ArmAllocCheck()
+{
+	armed = true;
+}
+
+void DisarmAllocCheck()
+{
+	armed = false;
+}
+
+// # of heap allocations made by armed threads
+unsigned long AllocsAfterInit()
+{
+	return allocs.load();
+}
@@ -0,0 +1,16 @@
+#ifndef ALLOCCHECK_H
+#define ALLOCCHECK_H
+
+/* Test hook for the allocation-free steady state. Linking alloccheck.cpp
+ * routes malloc and friends, and so new, through a counter. Threads that have
+ * armed the check count every heap allocation they make, anything else
+ * allocates as usual.
+*/
+
+void ArmAllocCheck();
+
+void DisarmAllocCheck();
+
+unsigned long AllocsAfterInit();
+
+#endif
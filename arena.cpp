@@ -0,0 +1,48 @@
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include "arena.h"
+
+
+// Bytes an allocation takes up in an arena, for sizing one up front
+size_t ArenaBytes(const size_t &bytes)
+{
+	return (bytes + ARENA_ALIGN - 1) / ARENA_ALIGN * ARENA_ALIGN;
+}
+
+/* Reserves and zeroes the whole arena
+ * \param[in] size The # of bytes, the sum of ArenaBytes of everything it will hold
+*/
+void SetupArena(arena &mem, const size_t &size)
+{
+	mem.size = ArenaBytes(size);
+	mem.used = 0;
+	mem.base = (char*)aligned_alloc(ARENA_ALIGN, mem.size ? mem.size : ARENA_ALIGN);
+	if (mem.base == NULL) {
+		printf("Not able to reserve a %zu byte arena \n", mem.size);
+		exit(1);
+	}
+	memset(mem.base, 0, mem.size);   // Touched now, so no page faults later
+}
+
+/* Hands out the next bytes of the arena. Running out is a sizing bug, so it
+ * ends the program rather than falling back to the heap.
+*/
+void *ArenaAlloc(arena &mem, const size_t &bytes)
+{
+	if (mem.used + ArenaBytes(bytes) > mem.size) {
+		printf("Arena of %zu bytes exhausted by %zu more \n", mem.size, bytes);
+		exit(1);
+	}
+	void *p = mem.base + mem.used;
+	mem.used += ArenaBytes(bytes);
+	return p;
+}
+
+void FreeArena(arena &mem)
+{
+	free(mem.base);
+	mem.base = NULL;
+	mem.size = 0;
+	mem.used = 0;
+}
@@ -0,0 +1,26 @@
+#ifndef ARENA_H
+#define ARENA_H
+
+#include <cstddef>
+
+const size_t ARENA_ALIGN = 64;   // Every allocation starts on its own cache line
+
+/* One block reserved at startup and handed out front to back. Nothing is
+ * freed on its own, the whole arena is released at once, so buffers that
+ * live as long as the analysis never go back to the heap.
+*/
+struct arena {
+	char *base;
+	size_t size;   // Bytes reserved
+	size_t used;   // Bytes handed out, rounded up to ARENA_ALIGN
+};
+
+size_t ArenaBytes(const size_t &bytes);
+
+void SetupArena(arena &mem, const size_t &size);
+
+void *ArenaAlloc(arena &mem, const size_t &bytes);
+
+void FreeArena(arena &mem);
+
+#endif
@@ -0,0 +1,215 @@
+#include <math.h>
+#include <algorithm>
+#include "bandsum.h"
+
+#if defined(__AVX2__) || defined(__SSE2__)
+#include <immintrin.h>
+#elif defined(__ARM_NEON)
+#include <arm_neon.h>
+#endif
+
+
+/* The smallest bin range covering both noise ranges and all bands. Union the
+ * ranges of two configurations (e.g. doppler and no doppler) to serve both
+ * from one prefix.
+ * \param[out] lo The first bin needed
+ * \param[out] hi One past the last bin needed
+*/
+void BinRange(const multi_thresh_indeces &mtIndeces, int &lo, int &hi)
+{
+	lo = std::min(mtIndeces.noiseIndexLowMin, mtIndeces.bandIndeces[0]);
+	hi = std::max(mtIndeces.noiseIndexHighMax, mtIndeces.bandIndeces[BANDS]);
+}
+
+/* Reference path, the magnitude formula of Magnitudes() summed bin by bin
+ * \param[in] *out The FFT output of an n-point window, fftw_complex or fftwf_complex
+ * \param[in] n The window length
+ * \param[in] lo The first bin, > 0
+ * \param[in] hi One past the last bin
+ * \param[in] *prefix The array to hold hi - lo + 1 prefix sums
+*/
+template<typename T>
+void MagnitudePrefixScalar(const T (*out)[2], const int &n, const int &lo, const int &hi, double *prefix)
+{
+	double total = 0;
+
+	prefix[0] = 0;
+	for (int j = lo; j < hi; j++) {
+		total += 2 * sqrt(pow(out[j][0], 2) + pow(out[j][1], 2)) / n;
+		prefix[j - lo + 1] = total;
+	}
+}
+
+template void MagnitudePrefixScalar(const double (*out)[2], const int &n, const int &lo, const int &hi, double *prefix);
+template void MagnitudePrefixScalar(const float (*out)[2], const int &n, const int &lo, const int &hi, double *prefix);
+
+/* Vectorised path: AVX2 or SSE2 on x86, NEON on 64-bit ARM. 32-bit ARM NEON
+ * has no double precision, so the Pi running a 32-bit OS takes the scalar path.
+ * Magnitudes are computed SIMD-wide into a small block, then accumulated.
+*/
+void MagnitudePrefix(const fftw_complex *out, const int &n, const int &lo, const int &hi, double *prefix)
+{
+	const double *re = &out[0][0];   // Interleaved re, im
+	double total = 0;
+	double mag[4];
+	int j = lo;
+
+	prefix[0] = 0;
+#if defined(__AVX2__)
+	const __m256d scale = _mm256_set1_pd(2.0);
+	const __m256d div = _mm256_set1_pd((double)n);
+	for (; j + 4 <= hi; j += 4) {
+		__m256d a = _mm256_loadu_pd(re + 2 * j);   // r0 i0 r1 i1
+		__m256d b = _mm256_loadu_pd(re + 2 * j + 4);   // r2 i2 r3 i3
+		__m256d sq = _mm256_hadd_pd(_mm256_mul_pd(a, a), _mm256_mul_pd(b, b));   // |0|2 |2|2 |1|2 |3|2
+		sq = _mm256_permute4x64_pd(sq, _MM_SHUFFLE(3, 1, 2, 0));
+		_mm256_storeu_pd(mag, _mm256_div_pd(_mm256_mul_pd(scale, _mm256_sqrt_pd(sq)), div));
+		for (int l = 0; l < 4; l++) {
+			total += mag[l];
+			prefix[j - lo + l + 1] = total;
+		}
+	}
+#elif defined(__SSE2__)
+	const __m128d scale = _mm_set1_pd(2.0);
+	const __m128d div = _mm_set1_pd((double)n);
+	for (; j + 2 <= hi; j += 2) {
+		__m128d a = _mm_loadu_pd(re + 2 * j);   // r0 i0
+		__m128d b = _mm_loadu_pd(re + 2 * j + 2);   // r1 i1
+		a = _mm_mul_pd(a, a);
+		b = _mm_mul_pd(b, b);
+		__m128d sq = _mm_add_pd(_mm_unpacklo_pd(a, b), _mm_unpackhi_pd(a, b));
+		_mm_storeu_pd(mag, _mm_div_pd(_mm_mul_pd(scale, _mm_sqrt_pd(sq)), div));
+		total += mag[0];
+		prefix[j - lo + 1] = total;
+		total += mag[1];
+		prefix[j - lo + 2] = total;
+	}
+#elif defined(__aarch64__)
+	const float64x2_t scale = vdupq_n_f64(2.0);
+	const float64x2_t div = vdupq_n_f64((double)n);
+	for (; j + 2 <= hi; j += 2) {
+		float64x2x2_t c = vld2q_f64(re + 2 * j);   // Deinterleaves into re and im
+		float64x2_t sq = vaddq_f64(vmulq_f64(c.val[0], c.val[0]), vmulq_f64(c.val[1], c.val[1]));
+		vst1q_f64(mag, vdivq_f64(vmulq_f64(scale, vsqrtq_f64(sq)), div));
+		total += mag[0];
+		prefix[j - lo + 1] = total;
+		total += mag[1];
+		prefix[j - lo + 2] = total;
+	}
+#endif
+	for (; j < hi; j++) {
+		total += 2 * sqrt(out[j][0] * out[j][0] + out[j][1] * out[j][1]) / n;
+		prefix[j - lo + 1] = total;
+	}
+}
+
+/* Single precision: twice the lanes of the double kernel, and NEON on
+ * 32-bit ARM too, where a refined reciprocal square root estimate stands in
+ * for the missing vector sqrt and divide.
+*/
+void MagnitudePrefix(const fftwf_complex *out, const int &n, const int &lo, const int &hi, double *prefix)
+{
+	const float *re = &out[0][0];   // Interleaved re, im
+	double total = 0;
+	float mag[8];
+	int j = lo;
+
+	prefix[0] = 0;
+#if defined(__AVX2__)
+	const __m256 scale = _mm256_set1_ps(2.0f);
+	const __m256 div = _mm256_set1_ps((float)n);
+	for (; j + 8 <= hi; j += 8) {
+		__m256 a = _mm256_loadu_ps(re + 2 * j);   // r0 i0 .. r3 i3
+		__m256 b = _mm256_loadu_ps(re + 2 * j + 8);   // r4 i4 .. r7 i7
+		__m256 sq = _mm256_hadd_ps(_mm256_mul_ps(a, a), _mm256_mul_ps(b, b));   // |0 1 4 5 2 3 6 7|2
+		sq = _mm256_castpd_ps(_mm256_permute4x64_pd(_mm256_castps_pd(sq), _MM_SHUFFLE(3, 1, 2, 0)));
+		_mm256_storeu_ps(mag, _mm256_div_ps(_mm256_mul_ps(scale, _mm256_sqrt_ps(sq)), div));
+		for (int l = 0; l < 8; l++) {
+			total += mag[l];
+			prefix[j - lo + l + 1] = total;
+		}
+	}
+#elif defined(__SSE2__)
+	const __m128 scale = _mm_set1_ps(2.0f);
+	const __m128 div = _mm_set1_ps((float)n);
+	for (; j + 4 <= hi; j += 4) {
+		__m128 a = _mm_loadu_ps(re + 2 * j);   // r0 i0 r1 i1
+		__m128 b = _mm_loadu_ps(re + 2 * j + 4);   // r2 i2 r3 i3
+		a = _mm_mul_ps(a, a);
+		b = _mm_mul_ps(b, b);
+		__m128 sq = _mm_add_ps(_mm_shuffle_ps(a, b, _MM_SHUFFLE(2, 0, 2, 0)), _mm_shuffle_ps(a, b, _MM_SHUFFLE(3, 1, 3, 1)));
+		_mm_storeu_ps(mag, _mm_div_ps(_mm_mul_ps(scale, _mm_sqrt_ps(sq)), div));
+		for (int l = 0; l < 4; l++) {
+			total += mag[l];
+			prefix[j - lo + l + 1] = total;
+		}
+	}
+#elif defined(__ARM_NEON)
+	const float32x4_t scale = vdupq_n_f32(2.0f / n);
+	for (; j + 4 <= hi; j += 4) {
+		float32x4x2_t c = vld2q_f32(re + 2 * j);   // Deinterleaves into re and im
+		float32x4_t sq = vaddq_f32(vmulq_f32(c.val[0], c.val[0]), vmulq_f32(c.val[1], c.val[1]));
+#if defined(__aarch64__)
+		float32x4_t abs = vsqrtq_f32(sq);
+#else
+		float32x4_t r = vrsqrteq_f32(sq);   // ~8 bits, two Newton steps reach float precision
+		r = vmulq_f32(r, vrsqrtsq_f32(vmulq_f32(sq, r), r));
+		r = vmulq_f32(r, vrsqrtsq_f32(vmulq_f32(sq, r), r));
+		float32x4_t abs = vbslq_f32(vcgtq_f32(sq, vdupq_n_f32(0)), vmulq_f32(sq, r), vdupq_n_f32(0));   // 0 * inf
+#endif
+		vst1q_f32(mag, vmulq_f32(scale, abs));
+		for (int l = 0; l < 4; l++) {
+			total += mag[l];
+			prefix[j - lo + l + 1] = total;
+		}
+	}
+#endif
+	for (; j < hi; j++) {
+		total += 2 * sqrtf(out[j][0] * out[j][0] + out[j][1] * out[j][1]) / n;
+		prefix[j - lo + 1] = total;
+	}
+}
+
+/* Employs the multi-thresholding scheme on a prefix-summed spectrum, every
+ * range an O(1) difference
+ * \param[in] *prefix The prefix sums from MagnitudePrefix
+ * \param[in] lo The first bin the prefix starts at, from BinRange
+ * \param[in] mtIndeces The multithresholding variables
+ * \return The FFT-analysis in the form of multithresholding average band values
+*/
+fft_analysis PrefixAnalysis(const double *prefix, const int &lo, const multi_thresh_indeces &mtIndeces)
+{
+	fft_analysis fftAnal;
+	const double *p = prefix - lo;   // Indexed by bin
+
+	double totalNoise = (p[mtIndeces.noiseIndexLowMax] - p[mtIndeces.noiseIndexLowMin]) +
+		(p[mtIndeces.noiseIndexHighMax] - p[mtIndeces.noiseIndexHighMin]);
+	fftAnal.noiseThresh = totalNoise / ((mtIndeces.noiseIndexLowMax - mtIndeces.noiseIndexLowMin) + 
+		(mtIndeces.noiseIndexHighMax - mtIndeces.noiseIndexHighMin));
+
+	for (int j = 0; j < BANDS; j++) {
+		double totalVol = p[mtIndeces.bandIndeces[j + 1]] - p[mtIndeces.bandIndeces[j]];
+		fftAnal.bandAvgs[j] = totalVol / mtIndeces.bandLength / fftAnal.noiseThresh;
+	}
+
+	return fftAnal;
+}
+
+/* As PrefixAnalysis, every bin range a constant of Config
+ * \param[in] *prefix The prefix sums from MagnitudePrefix over [Config::lo, Config::hi)
+ * \tparam Config A detector_config, e.g. parent_config
+*/
+template<typename Config>
+fft_analysis PrefixAnalysisFixed(const double *prefix)
+{
+	fft_analysis fftAnal;
+	fftAnal.noiseThresh = PrefixBands<Config>(prefix, fftAnal.bandAvgs) / Config::noiseBins;
+	for (int j = 0; j < BANDS; j++) {
+		fftAnal.bandAvgs[j] /= fftAnal.noiseThresh;
+	}
+
+	return fftAnal;
+}
+
+template fft_analysis PrefixAnalysisFixed<parent_config>(const double *prefix);
+template fft_analysis PrefixAnalysisFixed<sub_config>(const double *prefix);
@@ -0,0 +1,28 @@
+#ifndef BANDSUM_H
+#define BANDSUM_H
+
+#include <fftw3.h>
+#include "detection.h"
+
+const double BANDSUM_TOLERANCE = 1e-9;   // Max relative deviation of fused band averages from the reference
+
+/* Fused magnitude + prefix-sum kernel. Magnitudes are only computed for bins
+ * [lo, hi), and prefix[k - lo] holds the sum of the magnitudes of bins
+ * [lo, k), so any band or noise range inside is averaged in O(1).
+ * Sums are always kept in double, whatever precision the FFT ran in.
+*/
+void BinRange(const multi_thresh_indeces &mtIndeces, int &lo, int &hi);
+
+void MagnitudePrefix(const fftw_complex *out, const int &n, const int &lo, const int &hi, double *prefix);
+
+void MagnitudePrefix(const fftwf_complex *out, const int &n, const int &lo, const int &hi, double *prefix);
+
+template<typename T>
+void MagnitudePrefixScalar(const T (*out)[2], const int &n, const int &lo, const int &hi, double *prefix);
+
+fft_analysis PrefixAnalysis(const double *prefix, const int &lo, const multi_thresh_indeces &mtIndeces);
+
+template<typename Config>
+fft_analysis PrefixAnalysisFixed(const double *prefix);
+
+#endif
@@ -0,0 +1,1617 @@
+// Build: g++ -O2 -march=native -o benchmark benchmark.cpp adcsource.cpp adcspi.cpp arena.cpp bandsum.cpp capture.cpp decimator.cpp detection.cpp display.cpp frames.cpp halfcache.cpp fusion.cpp log.cpp metrics.cpp micarray.cpp netproto.cpp plans.cpp sampleclock.cpp simadc.cpp sirengen.cpp sparse.cpp spectrum.cpp stft.cpp workers.cpp -lfftw3 -lfftw3f -lsndfile -lbcm2835 -lpthread
+// Benchmarks the detection path on simulated ADC data, without a Pi attached
+//   ./benchmark stft [seconds]   Per-hop CPU cost of streaming analysis for a range of hops
+//   ./benchmark batch [seconds]  Per-channel copy and plan vs one batched plan over the history, single thread
+//   ./benchmark sparse           Goertzel and sliding DFT vs FFTW for the mainpi and Main.cpp window sizes
+//   ./benchmark plans [wisdom]   Planning time cold and from wisdom, and execute time, per planner rigor
+//   ./benchmark pool [seconds]   Wall time per window of parallel channel analysis for 1..N_CH workers
+//   ./benchmark scaling [seconds]  Wall time per window of 4/8/16 channels in stolen channel groups, and channels per core
+//   ./benchmark fused [seconds]  Reference vs scalar vs SIMD magnitude + band-sum, fails beyond BANDSUM_TOLERANCE
+//   ./benchmark ingest [seconds] Sampling-side stores and history ingest, double rows vs raw interleaved frames
+//   ./benchmark clock [seconds]  Deadline sample clock on mock SPI: achieved rate and jitter per target rate
+//   ./benchmark adc [seconds] [hw]  Unpaced samples/s per channel of every ADC backend, mock SPI unless hw
+//   ./benchmark stages [samples] [json]  ns/op percentiles of every detection stage on siren and noise, JSON for regressions
+//   ./benchmark precision [wav]  Double vs float analysis of a recording (or 60s simulated), fails if any verdict differs
+//   ./benchmark halves [seconds] Parent, split and sub-window analyses from FFTs vs the half-window cache, fails beyond BANDSUM_TOLERANCE
+//   ./benchmark metrics [samples]  Latency histogram percentiles vs exact, fails beyond the bucket error, and cost per record
+//   ./benchmark net [seconds] [nodes]  Detection datagrams over localhost: round trip and fusion checks, flooded
+//                                throughput and paced end-to-end latency of simulated nodes into the aggregator
+//   ./benchmark decimate [seconds]  Scalar vs SIMD decimation to fs, passband gain and alias rejection, and cost per window vs an FFT at the file rate
+//   ./benchmark configs [samples]  Runtime vs compile-time detector configs, parent with doppler and N/2 sub-window, fails unless identical
+
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <time.h>
+#include <string>
+#include <vector>
+#include <algorithm>
+#include <chrono>
+#include <math.h>
+#include <sndfile.h>
+#include <bcm2835.h>
+#include "adcsource.h"
+#include "bandsum.h"
+#include "decimator.h"
+#include "detection.h"
+#include "display.h"
+#include "frames.h"
+#include "halfcache.h"
+#include "fusion.h"
+#include "metrics.h"
+#include "netproto.h"
+#include "plans.h"
+#include "sampleclock.h"
+#include "simadc.h"
+#include "sparse.h"
+#include "spectrum.h"
+#include "stft.h"
+#include "workers.h"
+
+
+const double HOPS_MS[] = {64, 128, 256, 512, 1029, 2058};   // 1029 and 2058 are the split and full window
+const double STAGE_MIN_NS = 2000;   // Shortest timed sample, below this ops are batched
+const double CLOCK_RATES[] = {4000, 8000, 10000, 16000, 44100};   // 4 channels of mock SPI top out near 8kHz
+const int FILE_RATES[] = {16000, 44100, 48000};   // Recordings Main.cpp decimates to fs
+const int SCALING_CHANNELS[] = {4, 8, 16};   // One MCP3008 half used, one full, two on CS0 and CS1
+const double PASS_TONE = 1000;   // Hz, in the bands of interest
+const double ALIAS_TONE = 7000;   // Hz, would alias to 1kHz at 8kHz
+const double DECIM_GAIN_DB = 0.01;   // Passband gain error allowed
+const int NET_NODES = 16;   // Simulated nodes, unless given
+const double NET_PACED = 2000;   // Records per second of all nodes for the latency run
+const double NET_FUSE_ERROR = 1;   // m, how far the fused position may be from the siren
+
+/* CPU time consumed by the calling thread, in ms
+*/
+double ThreadCpuMs()
+{
+	struct timespec ts;
+	clock_gettime(CLOCK_THREAD_CPUTIME_ID, &ts);
+	return ts.tv_sec * 1000.0 + ts.tv_nsec / 1e6;
+}
+
+/* Streams simulated audio through the sliding history and analyses every
+ * channel each hop, as AnalysisThread does.
+ * \param[in] seconds Simulated audio to stream per hop size
+*/
+void BenchStft(const double &seconds)
+{
+	multi_thresh_indeces mtIndeces = SetupMultiThresholding(N, DOPPLER);
+	fft_vars<double> fftV = SetupFFT();
+	int detectedBands[BANDS];
+
+	fprintf(stderr, "%10s %10s %12s %12s %12s %10s %14s\n", "hop [ms]", "hops", "mean [ms]", "p99 [ms]", "max [ms]", "load [%]", "latency [ms]");
+	for (double hopMs : HOPS_MS) {
+		int hop = std::min((int)(hopMs * fs / 1000), N);
+		sim_adc adc;
+		SetupSimAdc(adc, fs, hop, N_CH);
+		adc.realtime = false;
+		stft_history<double> hist;
+		SetupStftHistory(hist, N, hop, N_CH);
+
+		double *block[N_CH];
+		for (int ch = 0; ch < N_CH; ch++) {
+			block[ch] = (double*)malloc(sizeof(double) * hop);
+		}
+
+		std::vector<double> costs;
+		int hops = (int)(seconds * fs / hop);
+		for (int h = 0; h < hops; h++) {
+			SimSampling(adc, block);
+			AppendHop(hist, block);
+			if (!WindowReady(hist, 0)) { continue; }
+
+			double begin = ThreadCpuMs();
+			for (int ch = 0; ch < N_CH; ch++) {
+				CopyWindow(hist, ch, 0, fftV.window);
+				Detect(AnalyseWindow(fftV, mtIndeces), detectedBands);
+			}
+			costs.push_back(ThreadCpuMs() - begin);
+		}
+
+		std::sort(costs.begin(), costs.end());
+		double mean = 0;
+		for (double c : costs) { mean += c; }
+		mean /= std::max((int)costs.size(), 1);
+		double p99 = costs.empty() ? 0 : costs[(size_t)(0.99 * (costs.size() - 1))];
+		double max = costs.empty() ? 0 : costs.back();
+		double hopDur = 1000.0 * hop / fs;
+
+		// Worst case a siren onset waits a full hop, then one analysis
+		fprintf(stderr, "%10.0f %10zu %12.3f %12.3f %12.3f %10.1f %14.0f\n", hopDur, costs.size(), mean, p99, max,
+			100 * mean / hopDur, hopDur + max);
+
+		for (int ch = 0; ch < N_CH; ch++) {
+			free(block[ch]);
+		}
+		FreeStftHistory(hist);
+	}
+	fprintf(stderr, "load is of a single core; the sampling thread occupies a second one\n");
+
+	FreeFFT(fftV);
+}
+
+/* Compares analysing every channel through its own copy and plan against one
+ * batched plan reading the history in place, on a single thread.
+ * \param[in] seconds Simulated audio to analyse per method
+*/
+void BenchBatch(const double &seconds)
+{
+	multi_thresh_indeces mtIndeces = SetupMultiThresholding(N, DOPPLER);
+	sim_adc adc;
+	SetupSimAdc(adc, fs, N, N_CH);
+	adc.realtime = false;
+	stft_history<double> hist;
+	SetupStftHistory(hist, N, N, N_CH);
+	double *window[N_CH];
+	for (int ch = 0; ch < N_CH; ch++) {
+		window[ch] = (double*)malloc(sizeof(double) * N);
+	}
+	SimSampling(adc, window);
+	AppendHop(hist, window);
+	int windows = std::max((int)(seconds / st), 1);
+	fft_analysis single[N_CH];
+	fft_analysis batched[N_CH];
+
+	fft_vars<double> fftV = SetupFFT();
+	auto begin = std::chrono::steady_clock::now();
+	for (int w = 0; w < windows; w++) {
+		for (int ch = 0; ch < N_CH; ch++) {
+			CopyWindow(hist, ch, 0, fftV.window);
+			single[ch] = AnalyseWindow(fftV, mtIndeces);
+		}
+	}
+	double singleMs = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - begin).count() / windows;
+	FreeFFT(fftV);
+
+	multi_fft_vars<double> spectrum = SetupMultiFFT(hist, 0, N_CH, mtIndeces);
+	begin = std::chrono::steady_clock::now();
+	for (int w = 0; w < windows; w++) {
+		MultiFFT(spectrum, hist, 0);
+		for (int ch = 0; ch < N_CH; ch++) {
+			batched[ch] = SpectrumAnalysis(spectrum, ch, mtIndeces);
+		}
+	}
+	double batchMs = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - begin).count() / windows;
+	FreeMultiFFT(spectrum);
+
+	double maxDiff = 0;
+	for (int ch = 0; ch < N_CH; ch++) {
+		for (int j = 0; j < BANDS; j++) {
+			maxDiff = std::max(maxDiff, fabs(single[ch].bandAvgs[j] - batched[ch].bandAvgs[j]));
+		}
+	}
+	fprintf(stderr, "%12s %12s %10s %16s\n", "single [ms]", "batched [ms]", "speedup", "max band diff");
+	fprintf(stderr, "%12.3f %12.3f %10.2f %16.3g\n", singleMs, batchMs, singleMs / batchMs, maxDiff);
+
+	for (int ch = 0; ch < N_CH; ch++) {
+		free(window[ch]);
+	}
+	FreeStftHistory(hist);
+}
+
+/* Times the full FFTW path against evaluating only the multithresholding bins,
+ * per window with Goertzel and per sample with the sliding DFT, and reports
+ * the hop below which sliding beats an FFT every hop.
+*/
+void BenchSparse()
+{
+	const double rates[3] = {fs, 44100, 44100};   // mainpi window, Main.cpp parent and sub-window
+	const double spans[3] = {st, st, st / 2};
+	const int reps = 5;
+	const int sdftHop = 256;
+
+	fprintf(stderr, "%8s %8s %6s %10s %14s %14s %16s %14s\n", "n", "fs", "bins", "fft [ms]", "goertzel [ms]",
+		"sdft [us/smp]", "crossover [smp]", "max band diff");
+	for (int i = 0; i < 3; i++) {
+		int n = (int)(spans[i] * rates[i]) & ~1;
+		multi_thresh_indeces mtIndeces = SetupMultiThresholding((int)(n * fs / rates[i]), DOPPLER);   // Same df as n at rates[i]
+		sim_adc adc;
+		SetupSimAdc(adc, rates[i], sdftHop, 1);
+		adc.realtime = false;
+		stft_history<double> hist;
+		SetupStftHistory(hist, n, sdftHop, 1);
+		double block[sdftHop];
+		double *blocks[1] = {block};
+		while (!WindowReady(hist, 0)) {
+			SimSampling(adc, blocks);
+			AppendHop(hist, blocks);
+		}
+		sparse_bank bank;
+		SetupSparseBank(bank, mtIndeces, n, 1);
+
+		// Full FFT
+		double *window = (double*)fftw_malloc(sizeof(double) * n);
+		fftw_complex *out = (fftw_complex*)fftw_malloc(sizeof(fftw_complex) * (n / 2 + 1));
+		double *absFFT = (double*)malloc(sizeof(double) * (n / 2 + 1));
+		fftw_plan p = fftw_plan_dft_r2c_1d(n, window, out, FFTW_ESTIMATE);
+		fft_analysis full;
+		auto begin = std::chrono::steady_clock::now();
+		for (int r = 0; r < reps; r++) {
+			CopyWindow(hist, 0, 0, window);
+			fftw_execute(p);
+			Magnitudes(out, absFFT, n);
+			full = AnalyseSpectrum(absFFT, mtIndeces);
+		}
+		double fftMs = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - begin).count() / reps;
+
+		// Goertzel over the same window
+		fft_analysis goertzel;
+		begin = std::chrono::steady_clock::now();
+		for (int r = 0; r < reps; r++) {
+			GoertzelBins(bank, 0, WindowPtr(hist, 0, 0));
+			goertzel = AnalyseSpectrum(SparseRow(bank, 0), mtIndeces);
+		}
+		double goertzelMs = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - begin).count() / reps;
+
+		// Slide on from the Goertzel seed, then check against a fresh FFT
+		int hops = 0;
+		double slideMs = 0;
+		for (; hops < 8; hops++) {
+			SimSampling(adc, blocks);
+			AppendHop(hist, blocks);
+			begin = std::chrono::steady_clock::now();
+			SlideHop(bank, hist, 0, 1);
+			slideMs += std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - begin).count();
+		}
+		double usPerSample = 1000 * slideMs / (hops * sdftHop);
+		fft_analysis slid = AnalyseSpectrum(SparseRow(bank, 0), mtIndeces);
+		CopyWindow(hist, 0, 0, window);
+		fftw_execute(p);
+		Magnitudes(out, absFFT, n);
+		fft_analysis after = AnalyseSpectrum(absFFT, mtIndeces);
+
+		double maxDiff = 0;
+		for (int j = 0; j < BANDS; j++) {
+			maxDiff = std::max(maxDiff, fabs(full.bandAvgs[j] - goertzel.bandAvgs[j]));
+			maxDiff = std::max(maxDiff, fabs(after.bandAvgs[j] - slid.bandAvgs[j]));
+		}
+		fprintf(stderr, "%8d %8.0f %6d %10.3f %14.3f %14.3f %16.0f %14.3g\n", n, rates[i], bank.count, fftMs, goertzelMs,
+			usPerSample, 1000 * fftMs / usPerSample, maxDiff);
+
+		fftw_destroy_plan(p);
+		fftw_free(window);
+		fftw_free(out);
+		free(absFFT);
+		FreeSparseBank(bank);
+		FreeStftHistory(hist);
+	}
+	fprintf(stderr, "sliding DFT beats an FFT every hop for hops below the crossover\n");
+}
+
+/* For each planner rigor, times making the window plans from scratch, making
+ * them again from the wisdom that produced, and executing them.
+ * \param[in] wisdomFile Scratch wisdom file, overwritten
+*/
+void BenchPlans(const char *wisdomFile)
+{
+	const char *modes[3] = {"estimate", "measure", "patient"};
+	const int reps = 200;
+	stft_history<double> hist;
+	SetupStftHistory(hist, N, N, N_CH);
+	fftw_complex *out = (fftw_complex*)fftw_malloc(sizeof(fftw_complex) * (N / 2 + 1) * N_CH);
+	double *window = (double*)fftw_malloc(sizeof(double) * N);
+	for (int j = 0; j < N; j++) {
+		window[j] = 512 + 100 * sin(0.3 * j);
+	}
+
+	fprintf(stderr, "%10s %16s %16s %14s %14s\n", "planner", "cold plan [ms]", "wisdom plan [ms]", "single [us]", "batched [us]");
+	for (const char *mode : modes) {
+		double planMs[2];
+		fftw_plan single = NULL;
+		fftw_plan batched = NULL;
+		for (int pass = 0; pass < 2; pass++) {   // From scratch, then from the saved wisdom
+			FreePlanRegistry();
+			fftw_forget_wisdom();
+			if (pass == 0) { remove(wisdomFile); }
+			SetupPlanRegistry(PlannerFlags(mode), wisdomFile);
+			auto begin = std::chrono::steady_clock::now();
+			single = GetPlan(N, false);
+			batched = GetPlan(N, false, N_CH, hist.stride, 0);
+			planMs[pass] = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - begin).count();
+			SavePlanRegistry();
+		}
+
+		auto begin = std::chrono::steady_clock::now();
+		for (int r = 0; r < reps; r++) {
+			fftw_execute_dft_r2c(single, window, out);
+		}
+		double singleUs = std::chrono::duration<double, std::micro>(std::chrono::steady_clock::now() - begin).count() / reps;
+		begin = std::chrono::steady_clock::now();
+		for (int r = 0; r < reps; r++) {
+			fftw_execute_dft_r2c(batched, hist.block, out);
+		}
+		double batchedUs = std::chrono::duration<double, std::micro>(std::chrono::steady_clock::now() - begin).count() / reps;
+
+		fprintf(stderr, "%10s %16.1f %16.1f %14.1f %14.1f\n", mode, planMs[0], planMs[1], singleUs, batchedUs);
+	}
+	FreePlanRegistry();
+	remove(wisdomFile);
+
+	fftw_free(out);
+	fftw_free(window);
+	FreeStftHistory(hist);
+}
+
+/* Analyses whole windows of every channel on pools of increasing size, as
+ * AnalysisThread does, and reports the wall time per window.
+ * \param[in] seconds Simulated audio to analyse per pool size
+*/
+void BenchPool(const double &seconds)
+{
+	multi_thresh_indeces mtIndeces = SetupMultiThresholding(N, DOPPLER);
+	sim_adc adc;
+	SetupSimAdc(adc, fs, N, N_CH);
+	adc.realtime = false;
+	double *window[N_CH];
+	for (int ch = 0; ch < N_CH; ch++) {
+		window[ch] = (double*)malloc(sizeof(double) * N);
+	}
+	SimSampling(adc, window);
+	int windows = std::max((int)(seconds / st), 1);
+	double single = 0;
+
+	fprintf(stderr, "%10s %10s %12s %10s\n", "workers", "windows", "mean [ms]", "speedup");
+	for (int workers = 1; workers <= N_CH; workers++) {
+		worker_pool pool;
+		SetupWorkerPool(pool, workers);
+		std::vector<fft_vars<double>> fftV(workers);
+		for (int k = 0; k < workers; k++) {
+			fftV[k] = SetupFFT();
+		}
+		fft_analysis chAnals[N_CH];
+		int detectedBands[N_CH][BANDS];
+
+		auto begin = std::chrono::steady_clock::now();
+		for (int w = 0; w < windows; w++) {
+			RunOnPool(pool, N_CH, [&](const int &k, const int &ch) {
+				std::copy(window[ch], window[ch] + N, fftV[k].window);
+				chAnals[ch] = AnalyseWindow(fftV[k], mtIndeces);
+				Detect(chAnals[ch], detectedBands[ch]);
+			});
+		}
+		auto end = std::chrono::steady_clock::now();
+		double mean = std::chrono::duration<double, std::milli>(end - begin).count() / windows;
+		if (workers == 1) { single = mean; }
+		fprintf(stderr, "%10d %10d %12.3f %10.2f\n", workers, windows, mean, single / mean);
+
+		FreeWorkerPool(pool);
+		for (int k = 0; k < workers; k++) {
+			FreeFFT(fftV[k]);
+		}
+	}
+	fprintf(stderr, "%u hardware threads available\n", std::thread::hardware_concurrency());
+
+	for (int ch = 0; ch < N_CH; ch++) {
+		free(window[ch]);
+	}
+}
+
+/* Analyses whole windows of 4, 8 and 16 channels as AnalysisThread does, in
+ * tasks of channel groups on a work-stealing pool of increasing size, and
+ * reports the wall time per window against the window period, and how many
+ * channels each core could keep up with.
+ * \param[in] seconds Simulated audio to analyse per configuration
+*/
+void BenchScaling(const double &seconds)
+{
+	multi_thresh_indeces mtIndeces = SetupMultiThresholding(N, DOPPLER);
+	int windows = std::max((int)(seconds / st), 1);
+	int cores = std::max((int)std::thread::hardware_concurrency(), 1);
+
+	fprintf(stderr, "%10s %10s %10s %10s %12s %10s %16s\n", "channels", "workers", "group", "windows", "mean [ms]", "load [%]", "channels/core");
+	for (int channels : SCALING_CHANNELS) {
+		sim_adc adc;
+		SetupSimAdc(adc, fs, N, channels);
+		adc.realtime = false;
+		stft_history<double> hist;
+		SetupStftHistory(hist, N, N, channels);
+		double *block[MAX_CH];
+		for (int ch = 0; ch < channels; ch++) {
+			block[ch] = (double*)malloc(sizeof(double) * N);
+		}
+		SimSampling(adc, block);
+		AppendHop(hist, block);
+
+		for (int workers = 1; workers <= std::min(cores, channels); workers++) {
+			int group = std::max(channels / (2 * workers), 1);   // mainpi's default
+			int tasks = (channels + group - 1) / group;
+			worker_pool pool;
+			SetupWorkerPool(pool, workers);
+			std::vector<multi_fft_vars<double>> spectra(tasks);
+			for (int t = 0; t < tasks; t++) {
+				spectra[t] = SetupMultiFFT(hist, t * group, std::min(group, channels - t * group), mtIndeces);
+			}
+			fft_analysis chAnals[MAX_CH];
+			int detectedBands[MAX_CH][BANDS];
+			worker_job analyse = [&](const int &, const int &t) {
+				MultiFFT(spectra[t], hist, 0);
+				for (int ch = spectra[t].first; ch < spectra[t].first + spectra[t].count; ch++) {
+					chAnals[ch] = SpectrumAnalysis(spectra[t], ch, mtIndeces);
+					Detect(chAnals[ch], detectedBands[ch]);
+				}
+			};
+
+			auto begin = std::chrono::steady_clock::now();
+			for (int w = 0; w < windows; w++) {
+				RunOnPoolStealing(pool, tasks, analyse);
+			}
+			auto end = std::chrono::steady_clock::now();
+			double mean = std::chrono::duration<double, std::milli>(end - begin).count() / windows;
+			double load = mean / (1000 * st);
+			fprintf(stderr, "%10d %10d %10d %10d %12.3f %10.2f %16.0f\n", channels, workers, group, windows, mean, 100 * load,
+				channels / (load * workers));
+
+			FreeWorkerPool(pool);
+			for (int t = 0; t < tasks; t++) {
+				FreeMultiFFT(spectra[t]);
+			}
+		}
+
+		for (int ch = 0; ch < channels; ch++) {
+			free(block[ch]);
+		}
+		FreeStftHistory(hist);
+	}
+	fprintf(stderr, "load is of one %.3fs window period, %d hardware threads available\n", st, cores);
+}
+
+/* Times the reference magnitude spectrum + per-band loops against the fused
+ * prefix-sum kernel, scalar and SIMD, for the parent (doppler) and split
+ * (non-doppler) configurations, and checks the band averages agree.
+ * \param[in] seconds Simulated audio to analyse per method
+ * \return The # of configurations outside BANDSUM_TOLERANCE
+*/
+int BenchFused(const double &seconds)
+{
+	const int sizes[3] = {N, N, N / 2};
+	const bool doppler[3] = {true, false, false};
+	int failed = 0;
+
+	fprintf(stderr, "%6s %8s %6s %14s %14s %14s %10s %14s\n", "n", "doppler", "bins", "reference [us]", "scalar [us]",
+		"simd [us]", "speedup", "max rel diff");
+	for (int i = 0; i < 3; i++) {
+		int n = sizes[i];
+		multi_thresh_indeces mtIndeces = SetupMultiThresholding(n, doppler[i]);
+		int lo, hi;
+		BinRange(mtIndeces, lo, hi);
+		sim_adc adc;
+		SetupSimAdc(adc, fs, n, 1);
+		adc.realtime = false;
+		double *window = (double*)fftw_malloc(sizeof(double) * n);
+		fftw_complex *out = (fftw_complex*)fftw_malloc(sizeof(fftw_complex) * (n / 2 + 1));
+		double *absFFT = (double*)malloc(sizeof(double) * (n / 2 + 1));
+		double *prefix = (double*)malloc(sizeof(double) * (n / 2 + 1));
+		fftw_plan p = GetPlan(n, false);
+		int windows = std::max((int)(seconds * fs / n), 1);
+		double ms[3] = {0, 0, 0};
+		double maxRel = 0;
+
+		for (int w = 0; w < windows; w++) {
+			SimSampling(adc, &window);
+			fftw_execute_dft_r2c(p, window, out);
+			fft_analysis anal[3];
+
+			auto begin = std::chrono::steady_clock::now();
+			Magnitudes(out, absFFT, n);
+			anal[0] = AnalyseSpectrum(absFFT, mtIndeces);
+			auto mid = std::chrono::steady_clock::now();
+			MagnitudePrefixScalar(out, n, lo, hi, prefix);
+			anal[1] = PrefixAnalysis(prefix, lo, mtIndeces);
+			auto mid2 = std::chrono::steady_clock::now();
+			MagnitudePrefix(out, n, lo, hi, prefix);
+			anal[2] = PrefixAnalysis(prefix, lo, mtIndeces);
+			auto end = std::chrono::steady_clock::now();
+			ms[0] += std::chrono::duration<double, std::milli>(mid - begin).count();
+			ms[1] += std::chrono::duration<double, std::milli>(mid2 - mid).count();
+			ms[2] += std::chrono::duration<double, std::milli>(end - mid2).count();
+
+			for (int k = 1; k < 3; k++) {
+				for (int j = 0; j < BANDS; j++) {
+					double ref = anal[0].bandAvgs[j];
+					maxRel = std::max(maxRel, fabs(anal[k].bandAvgs[j] - ref) / std::max(fabs(ref), 1e-12));
+				}
+				double ref = anal[0].noiseThresh;
+				maxRel = std::max(maxRel, fabs(anal[k].noiseThresh - ref) / std::max(fabs(ref), 1e-12));
+			}
+		}
+		bool pass = maxRel <= BANDSUM_TOLERANCE;
+		failed += !pass;
+		fprintf(stderr, "%6d %8s %6d %14.2f %14.2f %14.2f %10.2f %14.3g %s\n", n, doppler[i] ? "yes" : "no", hi - lo,
+			1000 * ms[0] / windows, 1000 * ms[1] / windows, 1000 * ms[2] / windows, ms[0] / ms[2], maxRel,
+			pass ? "ok" : "FAIL");
+
+		fftw_free(window);
+		fftw_free(out);
+		free(absFFT);
+		free(prefix);
+	}
+
+	return failed;
+}
+
+/* Times one way of storing sampled codes and appending them to the history
+ * \param[in] hist The history to append to, reset first
+ * \param[in] *codes The codes to store, [hops][hop][N_CH] as they come off SPI
+ * \param[in] hops The # of blocks
+ * \param[in] raw Whether to store interleaved uint16_t frames instead of double rows
+ * \param[out] storeMs Time per block spent storing, on the sampling thread
+ * \return Time per block spent appending, on the analysis thread
+*/
+template<typename T>
+double IngestMs(stft_history<T> &hist, const uint16_t *codes, const int &hops, const bool &raw, double &storeMs)
+{
+	int hop = hist.hop;
+	uint16_t *frames = (uint16_t*)malloc(sizeof(uint16_t) * hop * N_CH);
+	double *rows[N_CH];
+	for (int ch = 0; ch < N_CH; ch++) {
+		rows[ch] = (double*)malloc(sizeof(double) * hop);
+	}
+	ResetStftHistory(hist);
+
+	double store = 0, append = 0;
+	for (int h = 0; h < hops; h++) {
+		const uint16_t *block = codes + (long)h * hop * N_CH;
+		auto begin = std::chrono::steady_clock::now();
+		for (int i = 0; i < hop; i++) {
+			for (int j = 0; j < N_CH; j++) {
+				if (raw) {
+					frames[i * N_CH + j] = block[i * N_CH + j];
+				} else {
+					rows[j][i] = block[i * N_CH + j];
+				}
+			}
+		}
+		auto mid = std::chrono::steady_clock::now();
+		if (raw) {
+			AppendHop(hist, frames);
+		} else {
+			AppendHop(hist, rows);
+		}
+		auto end = std::chrono::steady_clock::now();
+		store += std::chrono::duration<double, std::milli>(mid - begin).count();
+		append += std::chrono::duration<double, std::milli>(end - mid).count();
+	}
+
+	free(frames);
+	for (int ch = 0; ch < N_CH; ch++) {
+		free(rows[ch]);
+	}
+	storeMs = store / hops;
+	return append / hops;
+}
+
+/* Compares the old double-row acquisition against raw interleaved frames
+ * converted on the analysis side, per hop of 128ms, and checks both fill
+ * the history identically.
+ * \param[in] seconds Simulated audio to ingest per method
+*/
+void BenchIngest(const double &seconds)
+{
+	const int hop = (int)(0.128 * fs);
+	int hops = std::max((int)(seconds * fs / hop), 1);
+	sim_adc adc;
+	SetupSimAdc(adc, fs, hop * hops, N_CH);
+	adc.realtime = false;
+	uint16_t *codes = (uint16_t*)malloc(sizeof(uint16_t) * hop * hops * N_CH);
+	SimSampling(adc, codes);
+
+	stft_history<double> histD, histRef;
+	stft_history<float> histF;
+	SetupStftHistory(histD, N, hop, N_CH);
+	SetupStftHistory(histRef, N, hop, N_CH);
+	SetupStftHistory(histF, N, hop, N_CH);
+
+	fprintf(stderr, "%10s %10s %14s %14s %14s\n", "storage", "history", "bytes/sample", "store [us]", "append [us]");
+	double storeMs, appendMs;
+	appendMs = IngestMs(histRef, codes, hops, false, storeMs);
+	fprintf(stderr, "%10s %10s %14zu %14.1f %14.1f\n", "double", "double", sizeof(double), 1000 * storeMs, 1000 * appendMs);
+	appendMs = IngestMs(histD, codes, hops, true, storeMs);
+	fprintf(stderr, "%10s %10s %14zu %14.1f %14.1f\n", "uint16", "double", sizeof(uint16_t), 1000 * storeMs, 1000 * appendMs);
+	appendMs = IngestMs(histF, codes, hops, true, storeMs);
+	fprintf(stderr, "%10s %10s %14zu %14.1f %14.1f\n", "uint16", "float", sizeof(uint16_t), 1000 * storeMs, 1000 * appendMs);
+
+	long mismatches = 0;
+	for (long i = 0; i < (long)histRef.stride * N_CH; i++) {
+		mismatches += (histRef.block[i] != histD.block[i]) + (histRef.block[i] != histF.block[i]);
+	}
+	fprintf(stderr, "%ld history samples differ from the double-row path\n", mismatches);
+
+	free(codes);
+	FreeStftHistory(histD);
+	FreeStftHistory(histRef);
+	FreeStftHistory(histF);
+}
+
+/* Runs the real sampling loop against the mock MCP3008 at a range of target
+ * rates and reports the rate achieved, the jitter of the sample deadlines,
+ * and where the first band index lands with the measured instead of the
+ * target rate. Rates beyond what the SPI transfers allow show up as late samples.
+ * \param[in] seconds Time to sample per rate
+*/
+void BenchClock(const double &seconds)
+{
+	fprintf(stderr, "%10s %12s %10s %10s %10s %10s %10s %12s\n", "target", "achieved", "mean [us]", "p50 [us]",
+		"p99 [us]", "max [us]", "late", "band0 bin");
+	for (double rate : CLOCK_RATES) {
+		int n = (int)(seconds * rate);
+		uint16_t *frames = (uint16_t*)malloc(sizeof(uint16_t) * n * N_CH);
+		adc_source src;
+		SetupAdcSource(src, ADC_BCM2835, true, rate, n, DefaultMicArray(N_CH));
+
+		StartSampleClock(src.clock);
+		double timeSpan = AdcSample(src, frames, n);
+		double achieved = n / timeSpan;
+		const jitter_stats &jitter = src.clock.jitter;
+		int band0 = SetupMultiThresholding(N, DOPPLER, rate).bandIndeces[0];
+		int band0Measured = SetupMultiThresholding(N, DOPPLER, achieved).bandIndeces[0];
+		fprintf(stderr, "%10.0f %12.1f %10.1f %10.0f %10.0f %10.1f %10ld %6d->%-5d\n", rate, achieved,
+			jitter.sum / std::max(jitter.count, 1L), JitterPercentile(jitter, 0.5), JitterPercentile(jitter, 0.99),
+			jitter.max, jitter.late, band0, band0Measured);
+
+		FreeAdcSource(src);
+		free(frames);
+	}
+	fprintf(stderr, "mock SPI takes %.1fus per 3-byte transfer, %d per frame\n", (MOCK_SPI_CALL_NS + 3 * 8 / SPI_CLOCK_HZ * 1e9) / 1000, N_CH);
+}
+
+/* Samples as fast as each backend allows, the sample clock set far beyond
+ * reach so it never sleeps, and reports samples/s per channel
+ * \param[in] seconds Roughly how long to sample per backend
+ * \param[in] hardware Whether to use the MCP3008 instead of the mock, on a Pi
+*/
+void BenchAdc(const double &seconds, const bool &hardware)
+{
+	const adc_backend backends[3] = {ADC_SIM, ADC_BCM2835, ADC_SPIDEV};
+	const double unpaced = 1e7;
+
+	if (hardware && !bcm2835_init()) {
+		fprintf(stderr, "bcm2835 initialisation failed, run as root on a Pi\n");
+		return;
+	}
+	fprintf(stderr, "%10s %8s %10s %16s %14s\n", "backend", "spi", "frames", "samples/s/ch", "us/frame");
+	for (adc_backend backend : backends) {
+		int n = (int)(seconds * fs);
+		uint16_t *frames = (uint16_t*)malloc(sizeof(uint16_t) * n * N_CH);
+		adc_source src;
+		SetupAdcSource(src, backend, !hardware, unpaced, n, DefaultMicArray(N_CH));
+		src.sim.realtime = false;
+
+		StartSampleClock(src.clock);
+		auto begin = std::chrono::steady_clock::now();
+		AdcSample(src, frames, n);
+		double timeSpan = std::chrono::duration<double>(std::chrono::steady_clock::now() - begin).count();   // Sim reports its nominal time
+		fprintf(stderr, "%10s %8s %10d %16.0f %14.2f\n", AdcBackendName(backend), (backend == ADC_SIM) ? "-" : (hardware ? "hw" : "mock"),
+			n, n / timeSpan, 1e6 * timeSpan / n);
+
+		FreeAdcSource(src);
+		free(frames);
+	}
+	if (!hardware) {
+		fprintf(stderr, "mock charges %.1fus per call plus %.1fus per 3-byte conversion\n", MOCK_SPI_CALL_NS / 1000.0,
+			3 * 8 / SPI_CLOCK_HZ * 1e6);
+	}
+	if (hardware) { bcm2835_close(); }
+}
+
+/* Reads a recording and resamples it linearly to fs, mic ch taking file
+ * channel ch modulo the # of file channels. Scaled to the 10-bit ADC range.
+ * \param[in] fileName The sound file
+ * \param[in] *samples The N_CH arrays to allocate and fill
+ * \return The # of samples per channel
+*/
+long LoadRecording(const char *fileName, double *samples[N_CH])
+{
+	SF_INFO sfinfo;
+	SNDFILE *file = sf_open(fileName, SFM_READ, &sfinfo);
+	if (file == NULL) {
+		fprintf(stderr, "Not able to open sound file %s \n", fileName);
+		exit(1);
+	}
+	double *frames = (double*)malloc(sizeof(double) * sfinfo.frames * sfinfo.channels);
+	sf_count_t count = sf_readf_double(file, frames, sfinfo.frames);
+	sf_close(file);
+
+	long n = (long)((count - 1) * fs / sfinfo.samplerate);
+	for (int ch = 0; ch < N_CH; ch++) {
+		samples[ch] = (double*)malloc(sizeof(double) * std::max(n, 1L));
+		int c = ch % sfinfo.channels;
+		for (long j = 0; j < n; j++) {
+			double t = j * sfinfo.samplerate / fs;
+			long k = (long)t;
+			double x = frames[k * sfinfo.channels + c] + (t - k) * (frames[(k + 1) * sfinfo.channels + c] - frames[k * sfinfo.channels + c]);
+			samples[ch][j] = 512 + 511 * x;
+		}
+	}
+	free(frames);
+
+	return n;
+}
+
+/* Streams a recording through the history and batched FFT in double and in
+ * float, half a window apart, and compares the band averages and verdicts
+ * \param[in] fileName The recording, or NULL for 60s of the simulated ADC
+ * \return The # of windows whose verdict differs
+*/
+int BenchPrecision(const char *fileName)
+{
+	multi_thresh_indeces mtIndeces = SetupMultiThresholding(N, DOPPLER);
+	const int hop = N / 2;
+	double *samples[N_CH];
+	long n;
+	if (fileName != NULL) {
+		n = LoadRecording(fileName, samples);
+	} else {
+		sim_adc adc;
+		n = (long)(60 * fs);
+		SetupSimAdc(adc, fs, n, N_CH);
+		adc.realtime = false;
+		for (int ch = 0; ch < N_CH; ch++) {
+			samples[ch] = (double*)malloc(sizeof(double) * n);
+		}
+		SimSampling(adc, samples);
+	}
+
+	stft_history<double> histD;
+	stft_history<float> histF;
+	SetupStftHistory(histD, N, hop, N_CH);
+	SetupStftHistory(histF, N, hop, N_CH);
+	multi_fft_vars<double> specD = SetupMultiFFT(histD, 0, N_CH, mtIndeces);
+	multi_fft_vars<float> specF = SetupMultiFFT(histF, 0, N_CH, mtIndeces);
+
+	int windows = 0;
+	int bandFlips = 0;   // Band verdicts that differ
+	int windowFlips = 0;   // Siren verdicts (> BANDS/2 bands) that differ
+	double maxRel = 0;
+	double minMargin = 1e9;   // Closest a band average came to its threshold
+	double msD = 0, msF = 0;
+	double *block[N_CH];
+	for (long pos = 0; pos + hop <= n; pos += hop) {
+		for (int ch = 0; ch < N_CH; ch++) {
+			block[ch] = samples[ch] + pos;
+		}
+		AppendHop(histD, block);
+		AppendHop(histF, block);
+		if (!WindowReady(histD, 0)) { continue; }
+
+		fft_analysis anal[2][N_CH];
+		auto begin = std::chrono::steady_clock::now();
+		MultiFFT(specD, histD, 0);
+		for (int ch = 0; ch < N_CH; ch++) { anal[0][ch] = SpectrumAnalysis(specD, ch, mtIndeces); }
+		auto mid = std::chrono::steady_clock::now();
+		MultiFFT(specF, histF, 0);
+		for (int ch = 0; ch < N_CH; ch++) { anal[1][ch] = SpectrumAnalysis(specF, ch, mtIndeces); }
+		auto end = std::chrono::steady_clock::now();
+		msD += std::chrono::duration<double, std::milli>(mid - begin).count();
+		msF += std::chrono::duration<double, std::milli>(end - mid).count();
+
+		for (int ch = 0; ch < N_CH; ch++) {
+			int bandsD[BANDS], bandsF[BANDS];
+			int detD = Detect(anal[0][ch], bandsD);
+			int detF = Detect(anal[1][ch], bandsF);
+			windowFlips += ((detD > BANDS / 2) != (detF > BANDS / 2));
+			for (int j = 0; j < BANDS; j++) {
+				double ref = anal[0][ch].bandAvgs[j];
+				bandFlips += (bandsD[j] != bandsF[j]);
+				maxRel = std::max(maxRel, fabs(anal[1][ch].bandAvgs[j] - ref) / std::max(fabs(ref), 1e-12));
+				minMargin = std::min(minMargin, fabs(ref - NOISE_COEFF[j]) / NOISE_COEFF[j]);
+			}
+		}
+		windows++;
+	}
+
+	fprintf(stderr, "%s: %d windows x %d channels\n", fileName ? fileName : "simulated", windows, N_CH);
+	fprintf(stderr, "%14s %14s %10s %14s %16s %12s %14s\n", "double [ms]", "float [ms]", "speedup", "max rel diff",
+		"closest to thr", "band flips", "verdict flips");
+	fprintf(stderr, "%14.3f %14.3f %10.2f %14.3g %16.3g %12d %14d\n", msD / std::max(windows, 1), msF / std::max(windows, 1),
+		msD / msF, maxRel, minMargin, bandFlips, windowFlips);
+
+	FreeMultiFFT(specD);
+	FreeMultiFFT(specF);
+	FreeStftHistory(histD);
+	FreeStftHistory(histF);
+	for (int ch = 0; ch < N_CH; ch++) {
+		free(samples[ch]);
+	}
+
+	return windowFlips;
+}
+
+/* Per-op timings of one stage on one input. Ops too short to time singly are
+ * timed in batches spanning at least STAGE_MIN_NS, one sample per batch.
+*/
+struct stage_timing {
+	std::string stage;
+	std::string input;
+	int batch;   // # of ops per sample
+	std::vector<double> ns;   // ns/op of every sample, sorted
+};
+
+template<typename F>
+stage_timing TimeStage(const char *stage, const char *input, const int &samples, F op)
+{
+	stage_timing timing = {stage, input, 0, {}};
+
+	op();   // Warm up caches and lazily made plans
+	auto begin = std::chrono::steady_clock::now();
+	do {
+		op();
+		timing.batch++;
+	} while (std::chrono::duration<double, std::nano>(std::chrono::steady_clock::now() - begin).count() < STAGE_MIN_NS);
+
+	for (int i = 0; i < samples; i++) {
+		begin = std::chrono::steady_clock::now();
+		for (int k = 0; k < timing.batch; k++) {
+			op();
+		}
+		timing.ns.push_back(std::chrono::duration<double, std::nano>(std::chrono::steady_clock::now() - begin).count() / timing.batch);
+	}
+	std::sort(timing.ns.begin(), timing.ns.end());
+	return timing;
+}
+
+double Percentile(const std::vector<double> &sorted, const double &p)
+{
+	return sorted[(size_t)(p * (sorted.size() - 1))];
+}
+
+double Mean(const std::vector<double> &values)
+{
+	double sum = 0;
+	for (double v : values) { sum += v; }
+	return sum / std::max(values.size(), (size_t)1);
+}
+
+/* Fills a history with two windows of simulated audio, starting at time start
+ * of the simulation, so the parent and the split window are both available
+*/
+void SyntheticHistory(stft_history<double> &hist, const double &start)
+{
+	sim_adc adc;
+	SetupSimAdc(adc, fs, N, N_CH);
+	adc.realtime = false;
+	adc.t = start;
+	SetupStftHistory(hist, N, N, N_CH);
+
+	double *block[N_CH];
+	for (int ch = 0; ch < N_CH; ch++) {
+		block[ch] = (double*)malloc(sizeof(double) * N);
+	}
+	for (int w = 0; w < 2; w++) {
+		SimSampling(adc, block);
+		AppendHop(hist, block);
+	}
+	for (int ch = 0; ch < N_CH; ch++) {
+		free(block[ch]);
+	}
+}
+
+/* Times every stage of the detection path on a simulated siren and on
+ * background noise, and writes the results as JSON for comparison across commits
+ * \param[in] samples The # of timing samples per stage and input
+ * \param[in] jsonFile Where to write the results
+*/
+void BenchStages(const int &samples, const char *jsonFile)
+{
+	multi_thresh_indeces mtIndeces = SetupMultiThresholding(N, DOPPLER);
+	multi_thresh_indeces mtHalf = SetupMultiThresholding(N / 2, false);
+	fft_vars<double> fftV = SetupFFT();
+	std::vector<stage_timing> timings;
+	volatile int sink = 0;
+
+	timings.push_back(TimeStage("SetupFFT", "-", samples, [&]() {
+		fft_vars<double> vars = SetupFFT();
+		FreeFFT(vars);
+	}));
+
+	// Sub-window sized transform, as Main.cpp's direction windows
+	double *half = (double*)fftw_malloc(sizeof(double) * (N / 2));
+	fftw_complex *halfOut = (fftw_complex*)fftw_malloc(sizeof(fftw_complex) * (N / 4 + 1));
+	double *halfPrefix = (double*)malloc(sizeof(double) * (N / 4 + 1));
+	fftw_plan halfPlan = GetPlan(N / 2, false);
+	int halfLo, halfHi;
+	BinRange(mtHalf, halfLo, halfHi);
+
+	const char *inputs[2] = {"siren", "noise"};
+	const double starts[2] = {0, SIM_SIREN_ON + 1};
+	for (int in = 0; in < 2; in++) {
+		stft_history<double> hist;
+		SyntheticHistory(hist, starts[in]);
+		double *window = (double*)malloc(sizeof(double) * N);
+		CopyWindow(hist, 0, 0, window);
+
+		timings.push_back(TimeStage("DoFFT", inputs[in], samples, [&]() {
+			DoFFT(fftV, window, mtIndeces, false, 0);
+		}));
+		timings.push_back(TimeStage("DoFFT N/2", inputs[in], samples, [&]() {
+			std::copy(window, window + N / 2, half);
+			fftw_execute_dft_r2c(halfPlan, half, halfOut);
+			MagnitudePrefix(halfOut, N / 2, halfLo, halfHi, halfPrefix);
+			sink = PrefixAnalysis(halfPrefix, halfLo, mtHalf).noiseThresh > 0;
+		}));
+
+		// Analyses of every channel, twice, as kept for direction
+		arena mem;
+		SetupArena(mem, AnalysisRingBytes(S, N_CH));
+		analysis_ring anals;
+		SetupAnalysisRing(anals, S, N_CH, mem);
+		mic_array array = DefaultMicArray(N_CH);
+		int detectedBands[MAX_CH][2][BANDS];
+		fft_analysis chAnals[N_CH];
+		for (int ch = 0; ch < N_CH; ch++) {
+			CopyWindow(hist, ch, 0, fftV.window);
+			chAnals[ch] = AnalyseWindow(fftV, mtIndeces);
+			for (int s = 0; s < S; s++) {
+				Detect(chAnals[ch], detectedBands[ch][s]);
+			}
+		}
+		for (int s = 0; s < S; s++) {
+			PushAnalyses(anals, chAnals);
+		}
+
+		timings.push_back(TimeStage("Detect", inputs[in], samples, [&]() {
+			int bands[BANDS];
+			sink = Detect(chAnals[0], bands);
+		}));
+		timings.push_back(TimeStage("SplitWindowDetection", inputs[in], samples, [&]() {
+			int detections = BANDS / 2;   // Inconclusive, as when mainpi retries
+			fft_analysis fftAnal = chAnals[0];
+			SplitWindowDetection(mtIndeces, detections, hist, 0, fftAnal, fftV);
+			sink = detections;
+		}));
+		int loc = -1;
+		timings.push_back(TimeStage("Location", inputs[in], samples, [&]() {
+			loc = Location(anals, array);
+		}));
+		timings.push_back(TimeStage("Direction", inputs[in], samples, [&]() {
+			sink = Direction(anals, S - 1, loc);
+		}));
+
+		free(window);
+		FreeStftHistory(hist);
+		FreeArena(mem);
+	}
+
+	// Every location and direction, and the blank display, on the mock GPIO
+	UseMockGpio(true);
+	int state = 0;
+	timings.push_back(TimeStage("update_display", "mock gpio", samples, [&]() {
+		int cycles = ((state % 6) == 5) ? MAX_CYCLES + 1 : 0;
+		update_display(cycles, (location)(state % 5), (direction)(state % 3));
+		state++;
+	}));
+	UseMockGpio(false);
+
+	fprintf(stderr, "%-22s %-10s %8s %12s %12s %12s %12s %12s\n", "stage", "input", "batch", "mean [ns]", "p50 [ns]", "p90 [ns]", "p99 [ns]", "max [ns]");
+	for (const stage_timing &t : timings) {
+		fprintf(stderr, "%-22s %-10s %8d %12.0f %12.0f %12.0f %12.0f %12.0f\n", t.stage.c_str(), t.input.c_str(), t.batch,
+			Mean(t.ns), Percentile(t.ns, 0.5), Percentile(t.ns, 0.9), Percentile(t.ns, 0.99), t.ns.back());
+	}
+
+	FILE *json = fopen(jsonFile, "w");
+	if (json == NULL) {
+		fprintf(stderr, "Not able to write %s \n", jsonFile);
+		exit(1);
+	}
+	fprintf(json, "{\n\t\"benchmark\": \"stages\",\n\t\"N\": %d,\n\t\"fs\": %.0f,\n\t\"channels\": %d,\n\t\"samples\": %d,\n\t\"stages\": [\n", N, fs, N_CH, samples);
+	for (size_t i = 0; i < timings.size(); i++) {
+		const stage_timing &t = timings[i];
+		fprintf(json, "\t\t{\"stage\": \"%s\", \"input\": \"%s\", \"batch\": %d, \"mean_ns\": %.1f, \"p50_ns\": %.1f, \"p90_ns\": %.1f, \"p99_ns\": %.1f, \"max_ns\": %.1f}%s\n",
+			t.stage.c_str(), t.input.c_str(), t.batch, Mean(t.ns), Percentile(t.ns, 0.5), Percentile(t.ns, 0.9), Percentile(t.ns, 0.99), t.ns.back(),
+			(i + 1 < timings.size()) ? "," : "");
+	}
+	fprintf(json, "\t]\n}\n");
+	fclose(json);
+	fprintf(stderr, "written to %s\n", jsonFile);
+
+	fftw_free(half);
+	fftw_free(halfOut);
+	free(halfPrefix);
+	FreeFFT(fftV);
+}
+
+// Largest relative difference between two analyses' band averages
+static double MaxRelDiff(const fft_analysis &a, const fft_analysis &ref)
+{
+	double maxRel = 0;
+	for (int j = 0; j < BANDS; j++) {
+		maxRel = std::max(maxRel, fabs(a.bandAvgs[j] - ref.bandAvgs[j]) / std::max(fabs(ref.bandAvgs[j]), 1e-12));
+	}
+	return maxRel;
+}
+
+/* Analyses every window of simulated audio three ways deep: the parent
+ * window, plus the split window straddling the previous one, plus both
+ * sub-windows as Main.cpp's direction does. Once with a transform per
+ * analysis, as mainpi and Main.cpp do, once combined from the half-window
+ * cache, and checks both agree.
+ * \param[in] seconds Simulated audio to analyse
+ * \return The # of analyses outside BANDSUM_TOLERANCE
+*/
+int BenchHalves(const double &seconds)
+{
+	multi_thresh_indeces mtIndeces = SetupMultiThresholding(N, DOPPLER);
+	multi_thresh_indeces mtHalf = SetupMultiThresholding(N / 2, false);
+	sim_adc adc;
+	SetupSimAdc(adc, fs, N, N_CH);
+	adc.realtime = false;
+	stft_history<double> hist;
+	SetupStftHistory(hist, N, N, N_CH);
+	double *block[N_CH];
+	for (int ch = 0; ch < N_CH; ch++) {
+		block[ch] = (double*)malloc(sizeof(double) * N);
+	}
+	int windows = std::max((int)(seconds / st), 2);
+
+	multi_fft_vars<double> spectrum = SetupMultiFFT(hist, 0, N_CH, mtIndeces);
+	fft_vars<double> fftV = SetupFFT();
+	double *half = (double*)fftw_malloc(sizeof(double) * (N / 2));
+	fftw_complex *halfOut = (fftw_complex*)fftw_malloc(sizeof(fftw_complex) * (N / 4 + 1));
+	double *halfPrefix = (double*)malloc(sizeof(double) * (N / 4 + 1));
+	fftw_plan halfPlan = GetPlan(N / 2, false);
+	int halfLo, halfHi;
+	BinRange(mtHalf, halfLo, halfHi);
+	half_cache<double> cache = SetupHalfCache(hist, 0, N_CH);
+
+	const char *depths[3] = {"parent", "+ split", "+ sub-windows"};
+	double ms[3][2] = {{0}};   // [depth][fft, cache]
+	double maxRel[3] = {0};
+	int analysed = 0;
+	for (int w = 0; w < windows; w++) {
+		SimSampling(adc, block);
+		AppendHop(hist, block);
+		if (!WindowReady(hist, N / 2)) {
+			CacheHalves(cache, hist);
+			continue;
+		}
+		analysed++;
+
+		fft_analysis ref[4][N_CH];   // Parent, split and sub-windows per channel
+		fft_analysis got[4][N_CH];
+		for (int depth = 0; depth < 3; depth++) {
+			auto begin = std::chrono::steady_clock::now();
+			MultiFFT(spectrum, hist, 0);
+			for (int ch = 0; ch < N_CH; ch++) {
+				ref[0][ch] = SpectrumAnalysis(spectrum, ch, mtIndeces);
+				if (depth < 1) { continue; }
+				CopyWindow(hist, ch, N / 2, fftV.window);
+				ref[1][ch] = AnalyseWindow(fftV, mtIndeces);
+				if (depth < 2) { continue; }
+				for (int sub = 0; sub < 2; sub++) {
+					std::copy(WindowPtr(hist, ch, 0) + sub * N / 2, WindowPtr(hist, ch, 0) + (sub + 1) * N / 2, half);
+					fftw_execute_dft_r2c(halfPlan, half, halfOut);
+					MagnitudePrefix(halfOut, N / 2, halfLo, halfHi, halfPrefix);
+					ref[2 + sub][ch] = PrefixAnalysis(halfPrefix, halfLo, mtHalf);
+				}
+			}
+			ms[depth][0] += std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - begin).count();
+
+			long cached = cache.halves;   // Each depth transforms the same two halves
+			begin = std::chrono::steady_clock::now();
+			CacheHalves(cache, hist);
+			for (int ch = 0; ch < N_CH; ch++) {
+				got[0][ch] = HalfWindowAnalysis(cache, ch, 0, mtIndeces);
+				if (depth < 1) { continue; }
+				got[1][ch] = HalfWindowAnalysis(cache, ch, 1, mtIndeces);
+				if (depth < 2) { continue; }
+				got[2][ch] = SubWindowAnalysis(cache, ch, 1, mtHalf);
+				got[3][ch] = SubWindowAnalysis(cache, ch, 0, mtHalf);
+			}
+			ms[depth][1] += std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - begin).count();
+			if (depth < 2) { cache.halves = cached; }
+		}
+
+		for (int ch = 0; ch < N_CH; ch++) {
+			maxRel[0] = std::max(maxRel[0], MaxRelDiff(got[0][ch], ref[0][ch]));
+			maxRel[1] = std::max(maxRel[1], MaxRelDiff(got[1][ch], ref[1][ch]));
+			maxRel[2] = std::max({maxRel[2], MaxRelDiff(got[2][ch], ref[2][ch]), MaxRelDiff(got[3][ch], ref[3][ch])});
+		}
+	}
+
+	const int ffts[3][2] = {{1, 2}, {2, 2}, {4, 2}};   // Transforms per channel per window
+	int failed = 0;
+	fprintf(stderr, "%14s %10s %10s %12s %12s %10s %14s\n", "analyses", "ffts", "cached", "fft [ms]", "cache [ms]", "speedup", "max rel diff");
+	for (int depth = 0; depth < 3; depth++) {
+		bool pass = maxRel[depth] <= BANDSUM_TOLERANCE;
+		failed += !pass;
+		fprintf(stderr, "%14s %10d %10d %12.3f %12.3f %10.2f %14.3g %s\n", depths[depth], ffts[depth][0], ffts[depth][1],
+			ms[depth][0] / analysed, ms[depth][1] / analysed, ms[depth][0] / ms[depth][1], maxRel[depth], pass ? "ok" : "FAIL");
+	}
+
+	FreeHalfCache(cache);
+	FreeMultiFFT(spectrum);
+	FreeFFT(fftV);
+	fftw_free(half);
+	fftw_free(halfOut);
+	free(halfPrefix);
+	for (int ch = 0; ch < N_CH; ch++) {
+		free(block[ch]);
+	}
+	FreeStftHistory(hist);
+	return failed;
+}
+
+/* Records log-uniform durations from 100ns to 10s into a latency histogram and
+ * checks its percentiles against the exact ones and its power-of-2 counts,
+ * then times recording from one thread and from N_CH threads at once
+ * \param[in] samples The # of durations to record
+ * \return The # of checks outside the bucket error
+*/
+int BenchMetrics(const int &samples)
+{
+	SetupMetrics(NULL, N / fs);
+	latency_histogram &hist = metrics.stages[STAGE_WINDOW];
+	std::vector<uint64_t> ns(samples);
+	uint64_t rng = 1;
+	for (int i = 0; i < samples; i++) {
+		rng ^= rng << 13;
+		rng ^= rng >> 7;
+		rng ^= rng << 17;
+		ns[i] = (uint64_t)(100 * pow(1e8, (rng >> 11) * (1.0 / 9007199254740992.0)));
+		RecordLatency(hist, ns[i]);
+	}
+	std::vector<uint64_t> sorted = ns;
+	std::sort(sorted.begin(), sorted.end());
+	int failed = 0;
+
+	fprintf(stderr, "%10s %16s %16s %10s\n", "percentile", "exact [ns]", "histogram [ns]", "rel diff");
+	const double ps[5] = {0, 50, 90, 99, 99.9};
+	for (double p : ps) {
+		double exact = sorted[(size_t)(p / 100 * (samples - 1))];
+		double approx = HistogramPercentile(hist, p);
+		double rel = fabs(approx - exact) / exact;
+		bool pass = rel <= 1.0 / HIST_SUB;
+		failed += !pass;
+		fprintf(stderr, "%10.1f %16.0f %16.0f %10.4f %s\n", p, exact, approx, rel, pass ? "ok" : "FAIL");
+	}
+	for (int le = HIST_LE_MIN; le <= HIST_LE_MAX; le += 2) {
+		uint64_t exact = std::lower_bound(sorted.begin(), sorted.end(), (uint64_t)1 << le) - sorted.begin();
+		failed += (HistogramBelow(hist, (uint64_t)1 << le) != exact);
+	}
+	failed += (hist.max != sorted.back()) || (hist.count != (uint64_t)samples);
+	fprintf(stderr, "Bucket counts, count and max %s \n", failed ? "FAIL" : "ok");
+
+	for (int threads = 1; threads <= N_CH; threads *= N_CH) {
+		auto begin = std::chrono::steady_clock::now();
+		std::vector<std::thread> recorders;
+		for (int t = 0; t < threads; t++) {
+			recorders.push_back(std::thread([&, t]() {
+				for (int i = t; i < samples; i += threads) { RecordLatency(metrics.stages[STAGE_DETECT], ns[i]); }
+			}));
+		}
+		for (std::thread &r : recorders) { r.join(); }
+		double elapsed = std::chrono::duration<double, std::nano>(std::chrono::steady_clock::now() - begin).count();
+		fprintf(stderr, "RecordLatency from %d thread(s): %.1f ns/op \n", threads, elapsed / samples);
+	}
+
+	auto begin = std::chrono::steady_clock::now();
+	std::string text = MetricsText();
+	double elapsed = std::chrono::duration<double, std::micro>(std::chrono::steady_clock::now() - begin).count();
+	fprintf(stderr, "MetricsText: %zu bytes in %.1f us \n", text.size(), elapsed);
+	CloseMetrics();
+	return failed;
+}
+
+// RMS of one channel of interleaved frames
+static double ChannelRms(const double *frames, const long &n, const int &channels, const int &ch)
+{
+	double sum = 0;
+	for (long j = 0; j < n; j++) {
+		sum += frames[j * channels + ch] * frames[j * channels + ch];
+	}
+	return sqrt(sum / std::max(n, 1L));
+}
+
+/* Decimates a stereo pair of tones from each of FILE_RATES to fs: a passband
+ * tone on channel 0, one that would alias onto it on channel 1. Fails if the
+ * SIMD path differs from the scalar one, if streaming a window at a time
+ * differs from one call, if the passband gain is off by DECIM_GAIN_DB or if the
+ * alias is rejected by less than DECIM_ATTEN. Then compares the cost of a
+ * window decimated and transformed at fs with one transformed at the file rate.
+ * \param[in] seconds Audio per rate
+*/
+int BenchDecimate(const double &seconds)
+{
+	int failed = 0;
+	fprintf(stderr, "%8s %6s %12s %12s %12s %12s %14s %14s %14s\n", "rate", "taps", "scalar [ms]", "SIMD [ms]", "gain [dB]", "alias [dB]",
+		"FFT@rate [ms]", "decimate [ms]", "FFT@fs [ms]");
+
+	for (int rate : FILE_RATES) {
+		long n = (long)(seconds * rate);
+		int nRate = (int)(st * rate);   // One window at the file rate
+		long frames = std::max(n, (long)nRate);   // Generated, enough for the window even if seconds < st
+		double *in = (double*)malloc(sizeof(double) * 2 * frames);
+		for (long j = 0; j < frames; j++) {
+			in[2 * j] = sin(2 * M_PI * PASS_TONE * j / rate);
+			in[2 * j + 1] = sin(2 * M_PI * ALIAS_TONE * j / rate);
+		}
+
+		decimator dec = SetupDecimator(rate, (int)fs, 2);
+		long capacity = n * dec.up / dec.down + 1;
+		double *out = (double*)malloc(sizeof(double) * 2 * capacity);
+		double *ref = (double*)malloc(sizeof(double) * 2 * capacity);
+		double *windowed = (double*)malloc(sizeof(double) * 2 * capacity);
+
+		double begin = ThreadCpuMs();
+		long produced = DecimateScalar(dec, in, n, ref);
+		double scalarMs = ThreadCpuMs() - begin;
+		ResetDecimator(dec);
+		begin = ThreadCpuMs();
+		Decimate(dec, in, n, out);
+		double simdMs = ThreadCpuMs() - begin;
+
+		// A window at a time, as Main.cpp streams
+		ResetDecimator(dec);
+		long done = 0, taken = 0;
+		for (long need = DecimatorInput(dec, N); taken + need <= n; need = DecimatorInput(dec, N)) {
+			done += Decimate(dec, in + 2 * taken, need, windowed + 2 * done);
+			taken += need;
+		}
+
+		double diff = 0;
+		for (long i = 0; i < 2 * produced; i++) {
+			diff = std::max(diff, fabs(out[i] - ref[i]));
+		}
+		long mismatches = (done != (produced / N) * N);
+		for (long i = 0; (i < 2 * done) && !mismatches; i++) {
+			mismatches += (windowed[i] != out[i]);
+		}
+
+		// Past the filter's start-up, the level of each tone
+		long settled = dec.taps * dec.up / dec.down + 1;
+		double gain = 20 * log10(ChannelRms(out + 2 * settled, produced - settled, 2, 0) * sqrt(2));
+		double alias = 20 * log10(ChannelRms(out + 2 * settled, produced - settled, 2, 1) * sqrt(2));
+		bool ok = (diff < 1e-12) && (mismatches == 0) && (fabs(gain) < DECIM_GAIN_DB) && (alias < -DECIM_ATTEN);
+		failed += !ok;
+
+		// One window: the transform at the file rate vs decimation then the transform at fs
+		int reps = 20;
+		double *real = (double*)fftw_malloc(sizeof(double) * nRate);
+		double *decimated = (double*)fftw_malloc(sizeof(double) * N);
+		fftw_complex *spec = (fftw_complex*)fftw_malloc(sizeof(fftw_complex) * (nRate / 2 + 1));
+		for (int j = 0; j < nRate; j++) { real[j] = in[2 * j]; }
+		fftw_plan pRate = GetPlan(nRate, false);
+		fftw_plan pFs = GetPlan(N, false);
+		begin = ThreadCpuMs();
+		for (int r = 0; r < reps; r++) { fftw_execute_dft_r2c(pRate, real, spec); }
+		double fftRateMs = (ThreadCpuMs() - begin) / reps;
+		decimator mono = SetupDecimator(rate, (int)fs, 1);
+		begin = ThreadCpuMs();
+		for (int r = 0; r < reps; r++) {
+			ResetDecimator(mono);
+			long need = DecimatorInput(mono, N);
+			Decimate(mono, real, std::min(need, (long)nRate), decimated);
+		}
+		double decimateMs = (ThreadCpuMs() - begin) / reps;
+		begin = ThreadCpuMs();
+		for (int r = 0; r < reps; r++) { fftw_execute_dft_r2c(pFs, decimated, spec); }
+		double fftFsMs = (ThreadCpuMs() - begin) / reps;
+
+		fprintf(stderr, "%8d %6d %12.1f %12.1f %12.4f %12.1f %14.2f %14.2f %14.2f %s\n", rate, dec.taps, scalarMs, simdMs, gain, alias,
+			fftRateMs, decimateMs, fftFsMs, ok ? "ok" : "FAIL");
+
+		FreeDecimator(mono);
+		FreeDecimator(dec);
+		fftw_free(real);
+		fftw_free(decimated);
+		fftw_free(spec);
+		free(in);
+		free(out);
+		free(ref);
+		free(windowed);
+	}
+	return failed;
+}
+
+// A window of a simulated node, its siren level set by the first band
+static net_window SimNetWindow(const uint32_t &node, const uint32_t &window, const int &channels, const double &level)
+{
+	net_window win;
+	win.node = node;
+	win.window = window;
+	win.endNs = NetNowNs();
+	win.channels = channels;
+	win.detected = false;
+	win.dir = no_dir;
+	win.loc = -1;
+	win.bearing = 0;
+	win.detecting = 0;
+	for (int ch = 0; ch < channels; ch++) {
+		for (int b = 0; b < BANDS; b++) {
+			win.chAnals[ch].bandAvgs[b] = level * (b + 1) / (ch + 1);
+		}
+		win.chAnals[ch].noiseThresh = 1 + ch;
+	}
+	return win;
+}
+
+/* Runs simulated nodes against an aggregator on localhost, each on its own
+ * thread sending windows as fast as it can, or at a fixed rate flushing
+ * every window as a detection would be
+ * \param[in] paced Records per second of each node, 0 to flood
+ * \return The aggregator's state once every datagram sent was drained
+*/
+static fusion *RunNetNodes(const double &seconds, const int &nodes, const double &paced, unsigned long &sentRecords, double &elapsed)
+{
+	fusion *fu = new fusion;
+	SetupFusion(*fu);
+	net_receiver rx;
+	OpenNetReceiver(rx, 0);
+	std::atomic<bool> sending(true), receiving(true);
+	std::thread aggregator([&]() {
+		while (receiving) {
+			int count = ReceiveDatagrams(rx, 10);
+			uint64_t now = NetNowNs();
+			for (int d = 0; d < count; d++) {
+				IngestDatagram(*fu, rx.buffers[d], rx.msgs[d].msg_len, now);
+			}
+		}
+	});
+
+	std::string address = "127.0.0.1:" + std::to_string(rx.port);
+	std::vector<unsigned long> counts(nodes, 0);
+	std::vector<std::thread> senders;
+	auto begin = std::chrono::steady_clock::now();
+	for (int n = 0; n < nodes; n++) {
+		senders.push_back(std::thread([&, n]() {
+			net_sender net;
+			OpenNetSender(net, address.c_str(), n, paced ? 0 : NET_FLUSH);
+			net_window win = SimNetWindow(n, 0, N_CH, 100);
+			win.detected = (paced > 0);
+			auto next = std::chrono::steady_clock::now();
+			for (uint32_t w = 0; sending; w++) {
+				win.window = w;
+				win.endNs = NetNowNs();
+				SendWindow(net, win);
+				counts[n]++;
+				if (paced) {
+					next += std::chrono::nanoseconds((long)(1e9 / paced));
+					std::this_thread::sleep_until(next);
+				}
+			}
+			CloseNetSender(net);
+		}));
+	}
+	std::this_thread::sleep_for(std::chrono::duration<double>(seconds));
+	sending = false;
+	for (std::thread &t : senders) {
+		t.join();
+	}
+	elapsed = std::chrono::duration<double>(std::chrono::steady_clock::now() - begin).count();
+	std::this_thread::sleep_for(std::chrono::milliseconds(100));   // Drain the socket
+	receiving = false;
+	aggregator.join();
+	CloseNetReceiver(rx);
+
+	sentRecords = 0;
+	for (unsigned long c : counts) {
+		sentRecords += c;
+	}
+	return fu;
+}
+
+/* Checks a window survives a datagram and that bearings from three nodes
+ * fuse to the siren, then measures the aggregator on localhost: records per
+ * second ingested from flooding nodes, and latency from the end of a window
+ * to its ingest with the nodes paced to NET_PACED records per second
+ * \param[in] seconds How long each run sends for
+ * \param[in] nodes The # of simulated nodes
+ * \return The # of checks failed
+*/
+int BenchNet(const double &seconds, const int &nodes)
+{
+	int failed = 0;
+
+	// Round trip, levels to within the 0.01dB step
+	net_window sent = SimNetWindow(7, 1234, MAX_CH, 12345.6);
+	sent.detected = true;
+	sent.dir = receding;
+	sent.loc = 5;
+	sent.bearing = 112.5;
+	sent.detecting = 0xa5a5;
+	char datagram[NET_DATAGRAM];
+	net_header header = {NET_MAGIC, NET_VERSION, 1, sent.node, 42, sent.endNs + 1500000};
+	memcpy(datagram, &header, sizeof(header));
+	int bytes = sizeof(header) + EncodeWindow(datagram + sizeof(header), NET_DATAGRAM - sizeof(header), sent, header.sentNs);
+	net_window got[NET_MAX_RECORDS];
+	bool same = (DecodeDatagram(datagram, bytes, header, got) == 1) && (got[0].node == sent.node) && (got[0].window == sent.window) &&
+		(got[0].endNs == sent.endNs) && (got[0].channels == sent.channels) && got[0].detected && (got[0].dir == sent.dir) &&
+		(got[0].loc == sent.loc) && (got[0].bearing == sent.bearing) && (got[0].detecting == sent.detecting);
+	double worst = 0;
+	for (int ch = 0; ch < MAX_CH; ch++) {
+		for (int b = 0; b < BANDS; b++) {
+			worst = std::max(worst, fabs(20 * log10(got[0].chAnals[ch].bandAvgs[b] / sent.chAnals[ch].bandAvgs[b])));
+		}
+		worst = std::max(worst, fabs(20 * log10(got[0].chAnals[ch].noiseThresh / sent.chAnals[ch].noiseThresh)));
+	}
+	same = same && (worst <= 0.5 / NET_DB_SCALE) && (DecodeDatagram(datagram, bytes - 1, header, got) < 0);
+	failed += !same;
+	fprintf(stderr, "%d-channel record: %d bytes, worst level error %.4fdB, truncated datagram rejected %s\n", MAX_CH,
+		NetRecordBytes(MAX_CH), worst, same ? "ok" : "FAIL");
+
+	// Three nodes around a siren at (30, 40)m, two facing east, one turned to face north
+	fusion *fu = new fusion;
+	SetupFusion(*fu);
+	const node_site sites[3] = {{1, 0, 0, 0}, {2, 60, 0, 0}, {3, 0, 80, 90}};
+	for (int n = 0; n < 3; n++) {
+		int entry = fu->count++;
+		fu->nodes[entry].site = sites[n];
+		fu->nodes[entry].placed = true;
+		fu->index[sites[n].node] = entry;
+
+		net_window win = SimNetWindow(sites[n].node, 0, N_CH, 10 * (n + 1));
+		win.detected = true;
+		win.dir = (n == 0) ? receding : approaching;
+		win.loc = n;
+		win.bearing = atan2(40 - sites[n].y, 30 - sites[n].x) * 180 / M_PI - sites[n].heading;
+		net_header one = {NET_MAGIC, NET_VERSION, 1, sites[n].node, 0, win.endNs};
+		memcpy(datagram, &one, sizeof(one));
+		bytes = sizeof(one) + EncodeWindow(datagram + sizeof(one), NET_DATAGRAM - sizeof(one), win, one.sentNs);
+		IngestDatagram(*fu, datagram, bytes, NetNowNs());
+	}
+	fused_estimate est = FuseDetections(*fu);
+	double error = hypot(est.x - 30, est.y - 40);
+	bool fused = est.intersected && (est.nodes == 3) && (est.bearings == 3) && (error < NET_FUSE_ERROR) && (est.loudest == 3) && (est.dir == approaching);
+	failed += !fused;
+	fprintf(stderr, "fused 3 bearings at (%.2f, %.2f)m, %.2fm from the siren, loudest node %u, %s %s\n", est.x, est.y, error, est.loudest,
+		(est.dir == approaching) ? "approaching" : "not approaching", fused ? "ok" : "FAIL");
+	FreeFusion(*fu);
+	delete fu;
+
+	fprintf(stderr, "%8s %8s %10s %12s %12s %10s %10s %10s %10s\n", "run", "nodes", "records", "sent [/s]", "ingested [/s]", "lost [%]",
+		"p50 [ms]", "p99 [ms]", "max [ms]");
+	const char *runs[2] = {"flood", "paced"};
+	for (int r = 0; r < 2; r++) {
+		unsigned long sentRecords;
+		double elapsed;
+		fu = RunNetNodes(seconds, nodes, r ? NET_PACED / nodes : 0, sentRecords, elapsed);
+		unsigned long lost = 0, datagrams = 0;
+		for (int n = 0; n < fu->count; n++) {
+			lost += fu->nodes[n].lost;
+			datagrams += fu->nodes[n].datagrams;
+		}
+		fprintf(stderr, "%8s %8d %10lu %12.0f %12.0f %10.2f %10.3f %10.3f %10.3f\n", runs[r], nodes, fu->records, sentRecords / elapsed,
+			fu->records / elapsed, 100.0 * lost / std::max(lost + datagrams, 1UL), HistogramPercentile(fu->latency, 50) / 1e6,
+			HistogramPercentile(fu->latency, 99) / 1e6, fu->latency.max / 1e6);
+		failed += (fu->malformed > 0);
+		FreeFusion(*fu);
+		delete fu;
+	}
+	fprintf(stderr, "flood batches %d records a datagram and measures throughput, paced flushes every record as a detection\n",
+		(NET_DATAGRAM - (int)sizeof(net_header)) / NetRecordBytes(N_CH));
+	return failed;
+}
+
+/* Runtime vs compile-time analysis of one window of Config's length: the
+ * tables must match, and the analyses from the spectrum and from the prefix
+ * sums must be the same to the bit
+ * \param[in] name The configuration, for the table
+ * \param[in] window At least Config::n samples
+ * \return The # of checks failed
+*/
+template<typename Config>
+int BenchConfig(const char *name, const double *window, const int &samples)
+{
+	const int n = Config::n;
+	multi_thresh_indeces mtIndeces = SetupMultiThresholding(n, Config::doppler);
+	int lo, hi;
+	BinRange(mtIndeces, lo, hi);
+	bool table = !memcmp(&mtIndeces, &Config::table, sizeof(mtIndeces)) && (lo == Config::lo) && (hi == Config::hi);
+
+	double *in = (double*)fftw_malloc(sizeof(double) * n);
+	fftw_complex *out = (fftw_complex*)fftw_malloc(sizeof(fftw_complex) * (n / 2 + 1));
+	double *absFFT = (double*)malloc(sizeof(double) * (n / 2 + 1));
+	double *prefix = (double*)malloc(sizeof(double) * (n / 2 + 1));
+	fftw_plan plan = GetPlan(n, false);
+	std::copy(window, window + n, in);
+	fftw_execute_dft_r2c(plan, in, out);
+	Magnitudes(out, absFFT, n);
+	MagnitudePrefix(out, n, lo, hi, prefix);
+
+	volatile double sink = 0;
+	const char *paths[3] = {"spectrum", "prefix", "window"};
+	stage_timing runtime[3], fixed[3];
+	fft_analysis anals[3][2];
+	runtime[0] = TimeStage(paths[0], "runtime", samples, [&]() { anals[0][0] = AnalyseSpectrum(absFFT, mtIndeces); sink = anals[0][0].noiseThresh; });
+	fixed[0] = TimeStage(paths[0], "fixed", samples, [&]() { anals[0][1] = AnalyseSpectrumFixed<Config>(absFFT); sink = anals[0][1].noiseThresh; });
+	runtime[1] = TimeStage(paths[1], "runtime", samples, [&]() { anals[1][0] = PrefixAnalysis(prefix, lo, mtIndeces); sink = anals[1][0].noiseThresh; });
+	fixed[1] = TimeStage(paths[1], "fixed", samples, [&]() { anals[1][1] = PrefixAnalysisFixed<Config>(prefix); sink = anals[1][1].noiseThresh; });
+	runtime[2] = TimeStage(paths[2], "runtime", samples, [&]() {
+		fftw_execute_dft_r2c(plan, in, out);
+		MagnitudePrefix(out, n, lo, hi, prefix);
+		anals[2][0] = PrefixAnalysis(prefix, lo, mtIndeces);
+		sink = anals[2][0].noiseThresh;
+	});
+	fixed[2] = TimeStage(paths[2], "fixed", samples, [&]() {
+		fftw_execute_dft_r2c(plan, in, out);
+		MagnitudePrefix(out, n, Config::lo, Config::hi, prefix);
+		anals[2][1] = PrefixAnalysisFixed<Config>(prefix);
+		sink = anals[2][1].noiseThresh;
+	});
+
+	int failed = !table;
+	for (int p = 0; p < 3; p++) {
+		bool same = !memcmp(&anals[p][0], &anals[p][1], sizeof(fft_analysis));
+		failed += !same;
+		fprintf(stderr, "%-8s %6d %8s %-9s %14.1f %14.1f %8.2fx %s\n", name, n, Config::doppler ? "yes" : "no", paths[p], Percentile(runtime[p].ns, 0.5),
+			Percentile(fixed[p].ns, 0.5), Percentile(runtime[p].ns, 0.5) / Percentile(fixed[p].ns, 0.5), (same && table) ? "ok" : "FAIL");
+	}
+
+	fftw_free(in);
+	fftw_free(out);
+	free(absFFT);
+	free(prefix);
+	return failed;
+}
+
+/* The compile-time detector configurations against the runtime tables they
+ * replace, on a simulated siren: the parent window with doppler, and the
+ * N/2-point sub-window without
+ * \param[in] samples The # of timing samples per path
+ * \return The # of checks failed
+*/
+int BenchConfigs(const int &samples)
+{
+	stft_history<double> hist;
+	SyntheticHistory(hist, 0);
+	double *window = (double*)malloc(sizeof(double) * N);
+	CopyWindow(hist, 0, 0, window);
+
+	fprintf(stderr, "%-8s %6s %8s %-9s %14s %14s %9s\n", "config", "n", "doppler", "path", "runtime [ns]", "fixed [ns]", "speedup");
+	int failed = BenchConfig<parent_config>("parent", window, samples);
+	failed += BenchConfig<sub_config>("sub", window, samples);
+	fprintf(stderr, "p50 of each path, window is the transform, fused magnitude + prefix and the analysis\n");
+
+	free(window);
+	FreeStftHistory(hist);
+	return failed;
+}
+
+int main(int argc, char *argv[])
+{
+	std::string mode = (argc > 1) ? argv[1] : "stft";
+	double seconds = (argc > 2) ? atof(argv[2]) : 60;
+
+	freopen("/dev/null", "w", stdout);   // Silence the per-window analysis prints, results go to stderr
+
+	if (mode == "stft") {
+		BenchStft(seconds);
+	} else if (mode == "batch") {
+		BenchBatch(seconds);
+	} else if (mode == "sparse") {
+		BenchSparse();
+	} else if (mode == "plans") {
+		BenchPlans((argc > 2) ? argv[2] : "benchmark.wisdom");
+	} else if (mode == "pool") {
+		BenchPool(seconds);
+	} else if (mode == "scaling") {
+		BenchScaling(seconds);
+	} else if (mode == "fused") {
+		return BenchFused(seconds) ? 1 : 0;
+	} else if (mode == "ingest") {
+		BenchIngest(seconds);
+	} else if (mode == "clock") {
+		BenchClock((argc > 2) ? seconds : 2);
+	} else if (mode == "adc") {
+		BenchAdc((argc > 2) ? seconds : 2, (argc > 3) && (std::string(argv[3]) == "hw"));
+	} else if (mode == "stages") {
+		BenchStages((argc > 2) ? atoi(argv[2]) : 2000, (argc > 3) ? argv[3] : "stages.json");
+	} else if (mode == "precision") {
+		return BenchPrecision((argc > 2) ? argv[2] : NULL) ? 1 : 0;
+	} else if (mode == "halves") {
+		return BenchHalves(seconds) ? 1 : 0;
+	} else if (mode == "metrics") {
+		return BenchMetrics((argc > 2) ? atoi(argv[2]) : 1000000) ? 1 : 0;
+	} else if (mode == "net") {
+		return BenchNet((argc > 2) ? seconds : 2, (argc > 3) ? atoi(argv[3]) : NET_NODES) ? 1 : 0;
+	} else if (mode == "decimate") {
+		return BenchDecimate((argc > 2) ? seconds : 20) ? 1 : 0;
+	} else if (mode == "configs") {
+		return BenchConfigs((argc > 2) ? atoi(argv[2]) : 2000) ? 1 : 0;
+	} else {
+		fprintf(stderr, "Unknown benchmark %s \n", mode.c_str());
+		return 1;
+	}
+
+	return 0;
+}
@@ -0,0 +1,182 @@
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <algorithm>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include "capture.h"
+
+
+/* Writer thread. Writes queued blocks in order until the capture is closed,
+ * then drains whatever is still queued.
+*/
+static void WriteCapture(capture_writer &cap)
+{
+	while (1) {
+		unsigned long tail = SpscTail(cap.queue);
+		if (!SpscReady(cap.queue, tail)) {
+			if (!cap.running) { break; }
+			std::this_thread::sleep_for(std::chrono::milliseconds(1));   // One block arrives per hop and the queue holds CAPTURE_QUEUE, a late write loses nothing
+			continue;
+		}
+
+		int q = tail % CAPTURE_QUEUE;
+		fwrite(&cap.blocks[q], sizeof(capture_block), 1, cap.file);
+		fwrite(cap.frames[q], sizeof(uint16_t), (size_t)cap.n * cap.channels, cap.file);
+		SpscRelease(cap.queue, tail + 1);
+	}
+	fflush(cap.file);
+}
+
+/* Creates a capture file and starts its writer thread
+ * \param[in] fs The target sampling rate
+ * \param[in] n The # of frames per block, the ring's block size
+ * \param[in] channels The # of channels per frame
+*/
+void OpenCapture(capture_writer &cap, const char *fileName, const double &fs, const int &n, const int &channels)
+{
+	if (!(cap.file = fopen(fileName, "wb"))) {
+		printf("Not able to create capture %s \n", fileName);
+		exit(1);
+	}
+
+	capture_header header;
+	memset(&header, 0, sizeof(header));
+	memcpy(header.magic, CAPTURE_MAGIC, sizeof(header.magic));
+	header.version = CAPTURE_VERSION;
+	header.channels = channels;
+	header.n = n;
+	header.fs = fs;
+	fwrite(&header, sizeof(header), 1, cap.file);
+
+	cap.n = n;
+	cap.channels = channels;
+	cap.frames = (uint16_t**)malloc(sizeof(uint16_t*) * CAPTURE_QUEUE);
+	for (int q = 0; q < CAPTURE_QUEUE; q++) {
+		cap.frames[q] = (uint16_t*)malloc(sizeof(uint16_t) * n * channels);
+	}
+	cap.blocks = (capture_block*)malloc(sizeof(capture_block) * CAPTURE_QUEUE);
+	ResetSpsc(cap.queue);
+	cap.dropped = 0;
+	cap.running = true;
+	cap.writer = std::thread(WriteCapture, std::ref(cap));
+}
+
+/* Queues one sampled block for writing. Called from a single thread, and
+ * never blocks: if the writer still holds the whole queue the block is dropped.
+*/
+void CaptureBlock(capture_writer &cap, const window_slot &slot)
+{
+	if (!SpscRoom(cap.queue, CAPTURE_QUEUE)) {
+		cap.dropped.fetch_add(1, std::memory_order_relaxed);
+		return;
+	}
+
+	int q = SpscHead(cap.queue) % CAPTURE_QUEUE;
+	memcpy(cap.frames[q], slot.frames, sizeof(uint16_t) * cap.n * cap.channels);
+	cap.blocks[q].timeSpan = slot.timeSpan;
+	cap.blocks[q].seq = slot.seq;
+	SpscPublish(cap.queue);
+}
+
+// Writes out the rest of the queue and closes the file
+void CloseCapture(capture_writer &cap)
+{
+	cap.running = false;
+	cap.writer.join();
+	fclose(cap.file);
+	if (cap.dropped > 0) {
+		printf("Capture dropped %lu blocks, the disk could not keep up \n", cap.dropped.load());
+	}
+
+	for (int q = 0; q < CAPTURE_QUEUE; q++) {
+		free(cap.frames[q]);
+	}
+	free(cap.frames);
+	free(cap.blocks);
+}
+
+static size_t BlockBytes(const capture_header &header)
+{
+	return sizeof(capture_block) + sizeof(uint16_t) * header.n * header.channels;
+}
+
+/* Maps a capture file for replay
+ * \param[in] speed Multiple of real time to replay at, 0 to replay as fast as it is consumed
+*/
+void OpenReplay(capture_replay &rep, const char *fileName, const double &speed)
+{
+	struct stat st;
+	if (((rep.fd = open(fileName, O_RDONLY)) < 0) || (fstat(rep.fd, &st) != 0) || (st.st_size < (off_t)sizeof(capture_header))) {
+		printf("Not able to open capture %s \n", fileName);
+		exit(1);
+	}
+	rep.size = st.st_size;
+	rep.map = (const char*)mmap(NULL, rep.size, PROT_READ, MAP_PRIVATE, rep.fd, 0);
+	if (rep.map == MAP_FAILED) {
+		printf("Not able to map capture %s \n", fileName);
+		exit(1);
+	}
+	madvise((void*)rep.map, rep.size, MADV_SEQUENTIAL);
+
+	memcpy(&rep.header, rep.map, sizeof(capture_header));
+	if ((memcmp(rep.header.magic, CAPTURE_MAGIC, sizeof(CAPTURE_MAGIC)) != 0) || (rep.header.version != CAPTURE_VERSION)) {
+		printf("%s is not a version %u capture \n", fileName, CAPTURE_VERSION);
+		exit(1);
+	}
+	rep.blocks = (rep.size - sizeof(capture_header)) / BlockBytes(rep.header);
+	rep.block = 0;
+	rep.frame = 0;
+	rep.speed = speed;
+	rep.played = 0;
+	rep.deadline = std::chrono::steady_clock::now();
+
+	printf("Replaying %ld blocks of %u frames, %u channels at %.0fHz from %s \n", rep.blocks, rep.header.n, rep.header.channels, rep.header.fs, fileName);
+}
+
+/* Copies the next n frames of the capture, whatever its block size, and
+ * sleeps until they would have been sampled at the replay speed
+ * \param[in] *frames The array that will hold the frames, [n][channels]
+ * \return The recorded sampling time of the frames, or -1 at the end of the capture
+*/
+double ReplaySample(capture_replay &rep, uint16_t *frames, const int &n)
+{
+	auto begin = std::chrono::steady_clock::now();
+	size_t frameBytes = sizeof(uint16_t) * rep.header.channels;
+	double timeSpan = 0;
+	long done = 0;
+
+	while (done < n) {
+		if (rep.block >= rep.blocks) {
+			return -1;
+		}
+		const char *block = rep.map + sizeof(capture_header) + rep.block * BlockBytes(rep.header);
+		capture_block info;
+		memcpy(&info, block, sizeof(info));
+
+		long take = std::min((long)n - done, (long)rep.header.n - rep.frame);
+		memcpy(frames + done * rep.header.channels, block + sizeof(capture_block) + rep.frame * frameBytes, take * frameBytes);
+		timeSpan += info.timeSpan * take / rep.header.n;
+		done += take;
+		rep.frame += take;
+		if (rep.frame == rep.header.n) {
+			rep.block++;
+			rep.frame = 0;
+		}
+	}
+	rep.played += timeSpan;
+
+	if (rep.speed > 0) {
+		rep.deadline = std::max(rep.deadline, begin) + std::chrono::duration_cast<std::chrono::steady_clock::duration>(std::chrono::duration<double>(timeSpan / rep.speed));
+		std::this_thread::sleep_until(rep.deadline);
+	}
+	return timeSpan;
+}
+
+void CloseReplay(capture_replay &rep)
+{
+	munmap((void*)rep.map, rep.size);
+	close(rep.fd);
+}
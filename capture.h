@@ -0,0 +1,79 @@
+#ifndef CAPTURE_H
+#define CAPTURE_H
+
+#include <atomic>
+#include <chrono>
+#include <thread>
+#include <stdio.h>
+#include <stdint.h>
+#include "pipeline.h"
+#include "spsc.h"
+
+const char CAPTURE_MAGIC[8] = {'S', 'I', 'R', 'E', 'N', 'C', 'A', 'P'};
+const uint32_t CAPTURE_VERSION = 1;
+const int CAPTURE_QUEUE = 32;   // # of blocks buffered between the analysis thread and the writer
+
+/* Capture file layout, all little endian as written by the Pi:
+ * a capture_header, then per block a capture_block followed by its
+ * n * channels raw 10-bit codes, interleaved [n][channels] as sampled.
+ * Gaps in seq are blocks the pipeline dropped while recording.
+*/
+struct capture_header {
+	char magic[8];
+	uint32_t version;
+	uint32_t channels;
+	uint32_t n;   // # of frames per block
+	uint32_t reserved;
+	double fs;   // Target sampling rate, the measured one follows from timeSpan
+};
+
+struct capture_block {
+	double timeSpan;   // Measured sampling time of the block
+	uint64_t seq;
+};
+
+/* Appends blocks to a capture file on its own thread. Blocks are copied into
+ * a preallocated queue and CaptureBlock never waits on the disk; if the
+ * writer falls a whole queue behind, blocks are dropped and counted instead.
+*/
+struct capture_writer {
+	FILE *file;
+	int n;
+	int channels;
+	uint16_t **frames;   // [CAPTURE_QUEUE][n * channels]
+	capture_block *blocks;   // [CAPTURE_QUEUE]
+	spsc_index queue;   // Blocks queued and written
+	std::atomic<unsigned long> dropped;
+	std::atomic<bool> running;
+	std::thread writer;
+};
+
+/* Memory-mapped capture fed back through the pipeline in place of the ADC,
+ * at the recorded pace scaled by speed, or as fast as analysis allows.
+*/
+struct capture_replay {
+	int fd;
+	const char *map;
+	size_t size;
+	capture_header header;
+	long blocks;   // # of whole blocks in the file
+	long block;   // Read position, block and frame within it
+	long frame;
+	double speed;   // Multiple of real time to replay at, 0 for unpaced
+	double played;   // Seconds of recorded audio replayed so far
+	std::chrono::steady_clock::time_point deadline;
+};
+
+void OpenCapture(capture_writer &cap, const char *fileName, const double &fs, const int &n, const int &channels);
+
+void CaptureBlock(capture_writer &cap, const window_slot &slot);
+
+void CloseCapture(capture_writer &cap);
+
+void OpenReplay(capture_replay &rep, const char *fileName, const double &speed);
+
+double ReplaySample(capture_replay &rep, uint16_t *frames, const int &n);
+
+void CloseReplay(capture_replay &rep);
+
+#endif
@@ -0,0 +1,210 @@
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <math.h>
+#include <algorithm>
+#include "decimator.h"
+
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#elif defined(__ARM_NEON) && defined(__aarch64__)
+#include <arm_neon.h>
+#endif
+
+
+// Zeroth order modified Bessel function of the first kind, for the Kaiser window
+static double BesselI0(const double &x)
+{
+	double sum = 1, term = 1;
+	for (int k = 1; term > 1e-12 * sum; k++) {
+		term *= (x / (2 * k)) * (x / (2 * k));
+		sum += term;
+	}
+	return sum;
+}
+
+static long Gcd(long a, long b)
+{
+	while (b) {
+		long t = a % b;
+		a = b;
+		b = t;
+	}
+	return a;
+}
+
+/* Designs the filter and primes every channel's line with taps - 1 zeros, so
+ * output 0 is aligned with input 0
+ * \param[in] inRate The rate of the input, Hz
+ * \param[in] outRate The rate of the output, Hz, below inRate
+ * \param[in] channels The # of interleaved channels
+*/
+decimator SetupDecimator(const int &inRate, const int &outRate, const int &channels)
+{
+	if ((outRate <= 0) || (outRate >= inRate)) {
+		printf("Not able to decimate %dHz to %dHz \n", inRate, outRate);
+		exit(1);
+	}
+
+	decimator dec;
+	long g = Gcd(inRate, outRate);
+	dec.inRate = inRate;
+	dec.outRate = outRate;
+	dec.up = outRate / g;
+	dec.down = inRate / g;
+	dec.channels = channels;
+
+	// Kaiser design, its length at the input rate set by the transition width
+	double transition = (DECIM_STOP - DECIM_PASS) * outRate / inRate;
+	double beta = 0.1102 * (DECIM_ATTEN - 8.7);
+	dec.taps = (int)ceil((DECIM_ATTEN - 8) / (2.285 * 2 * M_PI * transition));
+	int length = dec.up * dec.taps;
+	double cutoff = (DECIM_PASS + DECIM_STOP) / 2 * outRate / ((double)inRate * dec.up);   // Cycles per sample at the upsampled rate
+	double centre = (length - 1) / 2.0;
+
+	double *h = (double*)malloc(sizeof(double) * length);
+	double sum = 0;
+	for (int i = 0; i < length; i++) {
+		double t = i - centre;
+		double r = (length > 1) ? 2 * t / (length - 1) : 0;
+		double sinc = (t == 0) ? 1 : sin(2 * M_PI * cutoff * t) / (2 * M_PI * cutoff * t);
+		h[i] = 2 * cutoff * sinc * BesselI0(beta * sqrt(std::max(1 - r * r, 0.0))) / BesselI0(beta);
+		sum += h[i];
+	}
+
+	// Branch p holds h[p + j * up], reversed, scaled so each output has unit gain at DC
+	dec.filter = (double*)malloc(sizeof(double) * length);
+	for (int p = 0; p < dec.up; p++) {
+		for (int j = 0; j < dec.taps; j++) {
+			dec.filter[(long)p * dec.taps + (dec.taps - 1 - j)] = h[p + (long)j * dec.up] * dec.up / sum;
+		}
+	}
+	free(h);
+
+	dec.line = (double*)malloc(sizeof(double) * (dec.taps - 1 + DECIM_BLOCK) * channels);
+	ResetDecimator(dec);
+
+	printf("Decimating %dHz to %dHz by %d/%d, %d taps per branch \n", inRate, outRate, dec.up, dec.down, dec.taps);
+	return dec;
+}
+
+void FreeDecimator(decimator &dec)
+{
+	free(dec.filter);
+	free(dec.line);
+}
+
+// Forgets all input, as if just set up, e.g. before the next file
+void ResetDecimator(decimator &dec)
+{
+	for (int c = 0; c < dec.channels; c++) {
+		memset(dec.line + c * (dec.taps - 1 + DECIM_BLOCK), 0, sizeof(double) * (dec.taps - 1));
+	}
+	dec.fill = dec.taps - 1;
+	dec.next = dec.taps - 1;
+	dec.phase = 0;
+}
+
+/* # of input frames to pass Decimate for exactly outFrames more output frames
+ * \param[in] outFrames The # of output frames wanted
+*/
+long DecimatorInput(const decimator &dec, const long &outFrames)
+{
+	if (outFrames <= 0) { return 0; }
+	long last = dec.next + (dec.phase + (outFrames - 1) * dec.down) / dec.up;   // Newest sample the last output needs
+	return std::max(last + 1 - dec.fill, 0L);
+}
+
+static double DotScalar(const double *a, const double *b, const int &n)
+{
+	double sum = 0;
+	for (int i = 0; i < n; i++) {
+		sum += a[i] * b[i];
+	}
+	return sum;
+}
+
+/* 4 products at a time in 2 accumulators, SSE2 on x86, NEON on 64-bit ARM
+ * (32-bit ARM has no double lanes and takes the scalar path)
+*/
+static double Dot(const double *a, const double *b, const int &n)
+{
+	int i = 0;
+	double sum = 0;
+#if defined(__SSE2__)
+	__m128d acc0 = _mm_setzero_pd(), acc1 = _mm_setzero_pd();
+	for (; i + 4 <= n; i += 4) {
+		acc0 = _mm_add_pd(acc0, _mm_mul_pd(_mm_loadu_pd(a + i), _mm_loadu_pd(b + i)));
+		acc1 = _mm_add_pd(acc1, _mm_mul_pd(_mm_loadu_pd(a + i + 2), _mm_loadu_pd(b + i + 2)));
+	}
+	double lanes[2];
+	_mm_storeu_pd(lanes, _mm_add_pd(acc0, acc1));
+	sum = lanes[0] + lanes[1];
+#elif defined(__ARM_NEON) && defined(__aarch64__)
+	float64x2_t acc0 = vdupq_n_f64(0), acc1 = vdupq_n_f64(0);
+	for (; i + 4 <= n; i += 4) {
+		acc0 = vfmaq_f64(acc0, vld1q_f64(a + i), vld1q_f64(b + i));
+		acc1 = vfmaq_f64(acc1, vld1q_f64(a + i + 2), vld1q_f64(b + i + 2));
+	}
+	sum = vaddvq_f64(vaddq_f64(acc0, acc1));
+#endif
+	return sum + DotScalar(a + i, b + i, n - i);
+}
+
+/* Appends input a block at a time, computing every output it completes
+ * \param[in] dot The dot product, vectorised or not
+*/
+template<double (*dot)(const double*, const double*, const int&)>
+static long DecimateWith(decimator &dec, const double *in, const long &frames, double *out)
+{
+	long stride = dec.taps - 1 + DECIM_BLOCK;   // # of samples between two channels' lines
+	long produced = 0;
+
+	for (long start = 0; start < frames; start += DECIM_BLOCK) {
+		long block = std::min((long)DECIM_BLOCK, frames - start);
+		for (int c = 0; c < dec.channels; c++) {
+			double *line = dec.line + c * stride + dec.fill;
+			const double *src = in + start * dec.channels + c;
+			for (long j = 0; j < block; j++) {
+				line[j] = src[j * dec.channels];
+			}
+		}
+		dec.fill += block;
+
+		for (; dec.next < dec.fill; produced++) {
+			const double *branch = dec.filter + (long)dec.phase * dec.taps;
+			for (int c = 0; c < dec.channels; c++) {
+				out[produced * dec.channels + c] = dot(branch, dec.line + c * stride + dec.next - (dec.taps - 1), dec.taps);
+			}
+			dec.phase += dec.down;
+			dec.next += dec.phase / dec.up;
+			dec.phase %= dec.up;
+		}
+
+		// Keep what later outputs still need, at most taps - 1 samples, as next >= fill
+		long drop = std::min(dec.next - (dec.taps - 1), dec.fill);
+		for (int c = 0; c < dec.channels; c++) {
+			memmove(dec.line + c * stride, dec.line + c * stride + drop, sizeof(double) * (dec.fill - drop));
+		}
+		dec.fill -= drop;
+		dec.next -= drop;
+	}
+	return produced;
+}
+
+/* Resamples the next frames of the stream
+ * \param[in] *in frames interleaved input frames
+ * \param[in] frames The # of input frames, any
+ * \param[in] *out Interleaved output frames, room for frames * up / down + 1
+ * \return The # of output frames written
+*/
+long Decimate(decimator &dec, const double *in, const long &frames, double *out)
+{
+	return DecimateWith<Dot>(dec, in, frames, out);
+}
+
+// Reference path, one product at a time
+long DecimateScalar(decimator &dec, const double *in, const long &frames, double *out)
+{
+	return DecimateWith<DotScalar>(dec, in, frames, out);
+}
@@ -0,0 +1,43 @@
+#ifndef DECIMATOR_H
+#define DECIMATOR_H
+
+const int DECIM_BLOCK = 16384;   // Input frames buffered per channel at a time
+const double DECIM_ATTEN = 80;   // Stopband attenuation, dB
+const double DECIM_PASS = 0.375;   // Passband edge as a fraction of the output rate, 3kHz at 8kHz
+const double DECIM_STOP = 0.625;   // Stopband edge, nothing above it can alias below the passband edge
+
+/* Streaming polyphase anti-alias resampler from a rate down to a lower one,
+ * by up / down with the ratio in lowest terms, e.g. 80 / 441 for 44.1kHz to
+ * 8kHz. Only the output samples are computed, each a dot product of one
+ * polyphase branch of a Kaiser-windowed sinc with the latest input. The
+ * bands analysed stay flat up to DECIM_PASS of the output rate, the band
+ * between it and the output Nyquist is a transition nothing is analysed in.
+ * Frames are interleaved, as read from a sound file, on both sides.
+*/
+struct decimator {
+	int inRate;
+	int outRate;
+	int up;
+	int down;
+	int taps;   // Taps per branch
+	int channels;
+	double *filter;   // [up][taps], each branch reversed, so it dots with the oldest input first
+	double *line;   // [channels][taps - 1 + DECIM_BLOCK], each channel's latest input
+	long fill;   // # of samples in each channel's line
+	long next;   // Line index of the newest sample the next output needs
+	int phase;   // Branch of the next output
+};
+
+decimator SetupDecimator(const int &inRate, const int &outRate, const int &channels);
+
+void FreeDecimator(decimator &dec);
+
+void ResetDecimator(decimator &dec);
+
+long DecimatorInput(const decimator &dec, const long &outFrames);
+
+long Decimate(decimator &dec, const double *in, const long &frames, double *out);
+
+long DecimateScalar(decimator &dec, const double *in, const long &frames, double *out);
+
+#endif
@@ -0,0 +1,120 @@
+#ifndef DETCONFIG_H
+#define DETCONFIG_H
+
+/* Multithresholding bin ranges of an n-point window: Bands equal bands of
+ * interest from bandIndeces[0] to bandIndeces[Bands], and two noise ranges,
+ * each [min, max) into the magnitude spectrum
+*/
+template<int Bands>
+struct band_table {
+	int bandIndeces[Bands + 1];
+	int bandLength;
+	int noiseIndexLowMin;
+	int noiseIndexLowMax;
+	int noiseIndexHighMin;
+	int noiseIndexHighMax;
+};
+
+/* A band layout is a type with the frequencies multithresholding reads, Hz:
+ *   static constexpr int bands;
+ *   static constexpr double bandMin, bandMax, dopplerMin, dopplerMax;
+ *   static constexpr double noiseLowMin, noiseLowMax, noiseHighMin, noiseHighMax;
+ * With doppler the bands of interest shrink to what a siren covers at any speed.
+*/
+template<typename Layout>
+constexpr double BandLow(const bool doppler)
+{
+	return Layout::bandMin * (1 + (doppler * (Layout::dopplerMax - 1)));
+}
+
+template<typename Layout>
+constexpr double BandHigh(const bool doppler)
+{
+	return Layout::bandMax * (1 + (doppler * (Layout::dopplerMin - 1)));
+}
+
+/* Band and noise indeces of a layout, at compile time for a detector_config
+ * or at startup for a rate only known then
+ * \param[in] n The window length
+ * \param[in] rate The sampling rate, Hz
+ * \param[in] doppler Whether to allow for the doppler effect
+*/
+template<typename Layout>
+constexpr band_table<Layout::bands> BandTable(const int n, const double rate, const bool doppler)
+{
+	band_table<Layout::bands> table = {};
+	double df = rate / (double)n;
+	table.bandIndeces[0] = (int)(BandLow<Layout>(doppler) / df);
+	table.bandIndeces[Layout::bands] = (int)(BandHigh<Layout>(doppler) / df);
+	table.bandLength = (table.bandIndeces[Layout::bands] - table.bandIndeces[0]) / Layout::bands;
+	for (int i = 1; i < Layout::bands; i++) {
+		table.bandIndeces[i] = table.bandIndeces[i - 1] + table.bandLength;
+	}
+
+	table.noiseIndexLowMin = (int)(Layout::noiseLowMin / df);
+	table.noiseIndexLowMax = (int)(Layout::noiseLowMax / df);
+	table.noiseIndexHighMin = (int)(Layout::noiseHighMin / df);
+	table.noiseIndexHighMax = (int)(Layout::noiseHighMax / df);
+	return table;
+}
+
+/* A detector whose window length, rate, band layout and doppler allowance
+ * are fixed at compile time. Its table is a constant, so analyses written
+ * against it loop over constant bounds the compiler unrolls and folds.
+*/
+template<typename Layout, int WindowN, int Rate, bool Doppler>
+struct detector_config {
+	static constexpr int bands = Layout::bands;
+	static constexpr int n = WindowN;
+	static constexpr int rate = Rate;
+	static constexpr bool doppler = Doppler;
+	static constexpr band_table<bands> table = BandTable<Layout>(WindowN, Rate, Doppler);
+	static constexpr int lo = (table.noiseIndexLowMin < table.bandIndeces[0]) ? table.noiseIndexLowMin : table.bandIndeces[0];
+	static constexpr int hi = (table.noiseIndexHighMax > table.bandIndeces[bands]) ? table.noiseIndexHighMax : table.bandIndeces[bands];
+	static constexpr int noiseBins = (table.noiseIndexLowMax - table.noiseIndexLowMin) + (table.noiseIndexHighMax - table.noiseIndexHighMin);
+
+	// Magnitude buffers hold bins [0, n/2 - 1), Nyquist and the one below it are never read
+	static_assert((table.bandLength > 0) && (lo > 0) && (hi <= WindowN / 2 - 1), "The bands must lie inside the window's magnitude buffers");
+};
+
+/* Sums a magnitude spectrum over Config's ranges, as the runtime loops do
+ * \param[in] *absFFT The magnitude spectrum, indexed by bin
+ * \param[out] bandAvgs The mean magnitude of each band of interest
+ * \return The total magnitude of the noise ranges, over Config::noiseBins bins
+*/
+template<typename Config, typename T>
+inline double SpectrumBands(const T *absFFT, double (&bandAvgs)[Config::bands])
+{
+	constexpr band_table<Config::bands> t = Config::table;
+	double totalNoise = 0;
+	for (int j = t.noiseIndexLowMin; j < t.noiseIndexLowMax; j++) {
+		totalNoise += absFFT[j];
+	}
+	for (int j = t.noiseIndexHighMin; j < t.noiseIndexHighMax; j++) {
+		totalNoise += absFFT[j];
+	}
+	for (int b = 0; b < Config::bands; b++) {
+		double totalVol = 0;
+		for (int k = t.bandIndeces[b]; k < t.bandIndeces[b + 1]; k++) {
+			totalVol += absFFT[k];
+		}
+		bandAvgs[b] = totalVol / t.bandLength;
+	}
+	return totalNoise;
+}
+
+/* As SpectrumBands, from prefix sums of the magnitudes of bins [Config::lo, Config::hi)
+ * \param[in] *prefix prefix[k - Config::lo] is the sum of bins [Config::lo, k)
+*/
+template<typename Config>
+inline double PrefixBands(const double *prefix, double (&bandAvgs)[Config::bands])
+{
+	constexpr band_table<Config::bands> t = Config::table;
+	const double *p = prefix - Config::lo;   // Indexed by bin
+	for (int b = 0; b < Config::bands; b++) {
+		bandAvgs[b] = (p[t.bandIndeces[b + 1]] - p[t.bandIndeces[b]]) / t.bandLength;
+	}
+	return (p[t.noiseIndexLowMax] - p[t.noiseIndexLowMin]) + (p[t.noiseIndexHighMax] - p[t.noiseIndexHighMin]);
+}
+
+#endif
@@ -0,0 +1,377 @@
+#include <cstdio>
+#include <cstdlib>
+#include <math.h>
+#include <algorithm>
+#include <fstream>
+#include "detection.h"
+#include "bandsum.h"
+#include "log.h"
+#include "plans.h"
+
+
+template<typename T>
+void FftPrint(const char* fileName, const T *data, const double df)
+{
+	std::ofstream myFile;
+	myFile.open(fileName);
+
+	for (int i = 0; i < N/2-1; i++) {
+
+		myFile << (double)i*df << ": " << data[i]*(N/2) << "\n";
+	}
+	myFile.close();
+}
+
+/* Creates a multi_thresh_indeces variable containing the array
+ * indeces representing relevant band frequcneis to be used in multithresholding
+ * \param[in] n The window length to setup for
+ * \param[in] doppler Whether doppler's effect will be accounted for
+ * \param[in] rate The sampling rate, as measured if known
+*/
+multi_thresh_indeces SetupMultiThresholding(const int &n, const bool &doppler, const double &rate)
+{
+	LOG(LOG_INFO, "The band minimum is %.1f and the maximum is %.1f \n", BandLow<pi_bands>(doppler), BandHigh<pi_bands>(doppler));
+	return BandTable<pi_bands>(n, rate, doppler);   // As parent_config and sub_config have it at compile time
+}
+
+/* Creates and allocates the variables needed to perform FFT repeatedly
+ * \tparam T The sample precision, double or float
+*/ 
+template<typename T>
+fft_vars<T> SetupFFT() {
+	fft_vars<T> vars;
+	
+	vars.window = (T*)fftw_malloc(sizeof(T) * N);   // Whole window is copied in before each execute
+	vars.out = (typename fftw_api<T>::complex*)fftw_malloc(sizeof(typename fftw_api<T>::complex) * (N / 2 + 1));
+	vars.p = GetPlan<T>(N, false); // Shared through the registry, rigor set there. Wisdom makes MEASURE free at startup.
+	vars.absFFT = (T*)malloc(sizeof(T) * (N / 2 - 1));	
+	vars.prefix = (double*)malloc(sizeof(double) * (N / 2 + 1));
+
+	return vars;
+}
+
+template<typename T>
+void FreeFFT(fft_vars<T> &vars)
+{
+	fftw_free(vars.out);   // Plan belongs to the registry
+	fftw_free(vars.window);
+	free(vars.absFFT);
+	free(vars.prefix);
+}
+
+/* Obtains the absolute, normalised FFT from the raw r2c output
+ * \param[in] *out The FFT output of an n-point window
+ * \param[in] *absFFT The array to hold the n/2-1 magnitudes
+ * \param[in] n The window length
+*/
+template<typename T>
+void Magnitudes(const T (*out)[2], T *absFFT, const int &n)
+{
+	absFFT[0] = out[0][0] / n;
+	for (int j = 1; j < (n/ 2 - 1); j++) {
+		absFFT[j] = 2 * sqrt(pow(out[j][0], 2) + pow(out[j][1], 2)) / n;
+	}
+}
+
+/* Employs the multi-thresholding scheme on one magnitude spectrum
+ * \param[in] *absFFT The absolute, normalised FFT
+ * \param[in] mtIndeces The multithresholding variables
+ * \return The FFT-analysis in the form of multithresholding average band values
+*/
+template<typename T>
+fft_analysis AnalyseSpectrum(const T *absFFT, const multi_thresh_indeces &mtIndeces)
+{
+	fft_analysis fftAnal;
+
+	// Obtain noise levels
+	double totalNoise = 0;
+	for (int j = mtIndeces.noiseIndexLowMin; j < mtIndeces.noiseIndexLowMax; j++) {
+		totalNoise += absFFT[j];
+	}
+	for (int j = mtIndeces.noiseIndexHighMin; j < mtIndeces.noiseIndexHighMax; j++) {
+		totalNoise += absFFT[j];
+	}
+	fftAnal.noiseThresh = totalNoise / ((mtIndeces.noiseIndexLowMax - mtIndeces.noiseIndexLowMin) + 
+		(mtIndeces.noiseIndexHighMax - mtIndeces.noiseIndexHighMin));
+
+	// Obtain BoI (Bands of Interest) levels
+	double totalVol[BANDS] = { 0 };
+
+	for (int j = 0; j < BANDS; j++) {
+		for (int k = mtIndeces.bandIndeces[j]; k < mtIndeces.bandIndeces[j + 1]; k++) {
+			totalVol[j] += absFFT[k];
+		}
+		fftAnal.bandAvgs[j] = totalVol[j] / mtIndeces.bandLength / fftAnal.noiseThresh;
+	}
+
+	return fftAnal;
+}
+
+/* Employs the multi-thresholding scheme and returns an array
+ * of average band volumes. Expects the window to already hold the samples.
+ * Doesn't print, so it can run on any thread.
+ * \param[in] vars The fft variables, window filled
+ * \param[in] mtIndeces The multithresholding variables
+ * \return The FFT-analysis in the form of multithresholding average band values
+*/
+template<typename T>
+fft_analysis AnalyseWindow(fft_vars<T> &vars, const multi_thresh_indeces &mtIndeces)
+{
+	int lo, hi;
+	BinRange(mtIndeces, lo, hi);
+
+	fftw_api<T>::execute_r2c(vars.p, vars.window, vars.out); // Repeatable, plan may be shared
+	MagnitudePrefix(vars.out, N, lo, hi, vars.prefix);   // Only the bins multithresholding reads
+
+	return PrefixAnalysis(vars.prefix, lo, mtIndeces);
+}
+
+/* As AnalyseSpectrum, for a detector fixed at compile time
+ * \tparam Config A detector_config, e.g. parent_config
+*/
+template<typename Config, typename T>
+fft_analysis AnalyseSpectrumFixed(const T *absFFT)
+{
+	fft_analysis fftAnal;
+	fftAnal.noiseThresh = SpectrumBands<Config>(absFFT, fftAnal.bandAvgs) / Config::noiseBins;
+	for (int j = 0; j < BANDS; j++) {
+		fftAnal.bandAvgs[j] /= fftAnal.noiseThresh;
+	}
+
+	return fftAnal;
+}
+
+/* As AnalyseWindow, through the full scalar magnitude spectrum in absFFT.
+ * Reference for the fused kernel, and for FftPrint.
+*/
+template<typename T>
+fft_analysis AnalyseWindowReference(fft_vars<T> &vars, const multi_thresh_indeces &mtIndeces)
+{
+	fftw_api<T>::execute_r2c(vars.p, vars.window, vars.out);
+	Magnitudes(vars.out, vars.absFFT, N);
+
+	return AnalyseSpectrum(vars.absFFT, mtIndeces);
+}
+
+// Print for testing, one record per window at LOG_DEBUG
+void PrintAnalysis(const fft_analysis &fftAnal, const int &i, const char *label)
+{
+	static_assert(BANDS == 6, "One argument per band below");
+	const double *b = fftAnal.bandAvgs;
+	LOG(LOG_DEBUG, "%s %d: The noise threshold is %f, and the band averages are %.2f  %.2f  %.2f  %.2f  %.2f  %.2f \n",
+		label, i, fftAnal.noiseThresh, b[0], b[1], b[2], b[3], b[4], b[5]);
+}
+
+/* Employs the multi-thresholding scheme and returns an array
+ * of average band volumes.
+ * \param[in] vars The fft variables
+ * \param[in] *samples The samples to be FFT'd
+ * \param[in] mtIndeces The multithresholding variables
+ * \param[in] split Whether the window to analyse is a subwindow
+ * \param[in] i The subwindow to FFT - 0 if parent window
+ * \return The FFT-analysis in the form of multithresholding average band values
+*/
+template<typename T>
+fft_analysis DoFFT(fft_vars<T> &vars, const double *samples, const multi_thresh_indeces &mtIndeces, const bool &split, const int &i)
+{
+	int n = N;
+	
+	// Fill plan input array
+
+	for (int j = 0; j < n; j++) {
+		vars.window[j] = samples[n*i+j];
+	}
+	
+	fft_analysis fftAnal = AnalyseWindow(vars, mtIndeces);
+	PrintAnalysis(fftAnal, i);
+
+	return fftAnal;
+}
+
+/* Runs the detection algorithm on the parameter fft-analysis
+ * \param[in] fftAnal The FFT-analysis
+ * \param[in] detectedBands[BANDS] The array to hold the detection results
+ * \return The number of bands that detected an EV.
+ */
+int Detect(const fft_analysis &fftAnal, int (&detectedBands)[BANDS]) 
+{
+	int detections = 0;
+
+	for (int i = 0; i < BANDS; i++) {
+		detectedBands[i] = (fftAnal.bandAvgs[i] >= NOISE_COEFF[i]);
+		detections += detectedBands[i];
+	}
+
+	return detections;
+}
+
+void PrintDetection(const int (&detectedBands)[BANDS])
+{
+	const int *d = detectedBands;
+	LOG(LOG_DEBUG, " %d  %d  %d  %d  %d  %d \n", d[0], d[1], d[2], d[3], d[4], d[5]);
+}
+
+// Replaces the results with those of the retried window if it detects more bands
+void KeepBetterDetection(int &detections, fft_analysis &fftAnal, const fft_analysis &fftAnalRev)
+{
+	int detectedBandsRev[BANDS];
+	int detectionsRev = Detect(fftAnalRev, detectedBandsRev);
+	if (detectionsRev > detections) {
+		detections = detectionsRev;
+		fftAnal = fftAnalRev; 
+	}
+}
+
+// Re-evaluate siren presence by merging consecutive half-windows when inconclusive
+// number of bands are detected
+template<typename T>
+void SplitWindowDetection(multi_thresh_indeces mtIndeces, int &detections, const stft_history<T> &hist, const int &ch, fft_analysis &fftAnal, fft_vars<T> &fftV) 
+{
+	// Window consisting of latter half of previous window and first half of current window
+	CopyWindow(hist, ch, N/2, fftV.window);
+	
+	// Analyse new window and replace results if better detection
+	KeepBetterDetection(detections, fftAnal, AnalyseWindow(fftV, mtIndeces));
+}
+
+// Bytes of arena an analysis ring of capacity windows of channels takes
+size_t AnalysisRingBytes(const int &capacity, const int &channels)
+{
+	return ArenaBytes(sizeof(double) * capacity * channels * BANDS) + ArenaBytes(sizeof(double) * capacity * channels);
+}
+
+/* \param[in] capacity The # of windows to keep, the oldest is compared for direction
+ * \param[in] channels The # of channels per window
+ * \param[in] mem The arena to take the rows from, AnalysisRingBytes(capacity, channels) of it
+*/
+void SetupAnalysisRing(analysis_ring &anals, const int &capacity, const int &channels, arena &mem)
+{
+	anals.capacity = capacity;
+	anals.channels = channels;
+	anals.bandAvgs = (double (*)[BANDS])ArenaAlloc(mem, sizeof(double) * capacity * channels * BANDS);
+	anals.noiseThresh = (double*)ArenaAlloc(mem, sizeof(double) * capacity * channels);
+	ClearAnalyses(anals);
+}
+
+// Forgets every window, e.g. after a gap in the audio
+void ClearAnalyses(analysis_ring &anals)
+{
+	anals.count = 0;
+	anals.latest = anals.capacity - 1;
+}
+
+/* Keeps one window's analyses of every channel, overwriting the oldest when full
+ * \param[in] chAnals The analysis of each of the ring's channels
+*/
+void PushAnalyses(analysis_ring &anals, const fft_analysis *chAnals)
+{
+	anals.latest = (anals.latest + 1) % anals.capacity;
+	anals.count = std::min(anals.count + 1, anals.capacity);
+	for (int ch = 0; ch < anals.channels; ch++) {
+		long row = (long)anals.latest * anals.channels + ch;
+		std::copy(chAnals[ch].bandAvgs, chAnals[ch].bandAvgs + BANDS, anals.bandAvgs[row]);
+		anals.noiseThresh[row] = chAnals[ch].noiseThresh;
+	}
+}
+
+/* Slot of a kept window
+ * \param[in] age The # of windows before the latest, less than count
+*/
+int AnalysisSlot(const analysis_ring &anals, const int &age)
+{
+	return (anals.latest - age + anals.capacity) % anals.capacity;
+}
+
+// Band averages of one channel in a slot
+const double *AnalysisBands(const analysis_ring &anals, const int &slot, const int &ch)
+{
+	return anals.bandAvgs[(long)slot * anals.channels + ch];
+}
+
+/* Runs the direction analysis, comparing the loudness at the located mic in
+ * an earlier window and in the latest one
+ * \param[in] anals The kept analyses
+ * \param[in] age The # of windows before the latest to compare against
+ * \param[in] loc The located channel, as Location returns it, channel 0 without one
+ */
+direction Direction(const analysis_ring &anals, const int &age, const int &loc) 
+{
+	int ch = std::max(loc, 0);
+	const int slots[2] = {AnalysisSlot(anals, age), AnalysisSlot(anals, 0)};
+	double windowAvgs[2] = { 0 };
+	for (int w = 0; w < 2; w++) {
+		const double *bandAvgs = AnalysisBands(anals, slots[w], ch);
+		for (int j = 0; j < BANDS; j++) {
+			windowAvgs[w] += bandAvgs[j] * (bandAvgs[j] >= NOISE_COEFF[j]);
+		}
+		windowAvgs[w] = windowAvgs[w] / BANDS;
+	}
+	
+	double relAvg = windowAvgs[1] / windowAvgs[0];
+	
+	if (relAvg > (1 + DIR_MARGIN)) {
+		LOG(LOG_INFO, "Detected EV is approaching at %f. \n", relAvg);
+		return approaching;
+	}
+	else if (relAvg < (1 - DIR_MARGIN)) {
+		LOG(LOG_INFO, "Detected EV is moving away at %f. \n", relAvg);
+		return receding;
+	}
+	else {
+		LOG(LOG_INFO, "Detected direction is inconclusive at %f. \n", relAvg);
+		return no_dir;
+	}
+} 
+
+/* Finds the loudest microphone in the latest window
+ * \param[in] array The geometry, which channel faces away from which
+ * \return The loudest channel, -1 if its opposite is about as loud
+*/
+int Location(const analysis_ring &anals, const mic_array &array)
+{
+	double windowAvgs[MAX_CH] = { 0 };
+	for (int ch = 0; ch < anals.channels; ch++) {
+		const double *bandAvgs = AnalysisBands(anals, anals.latest, ch);
+		for (int j = 0; j < BANDS; j++) {
+			windowAvgs[ch] += bandAvgs[j]; 
+		}
+		windowAvgs[ch] = windowAvgs[ch] / BANDS;
+	}
+	
+	int loc = 0;
+
+	double maxAvg = windowAvgs[0];
+	for (int ch = 1; ch < anals.channels; ch++) {
+		if (windowAvgs[ch] > maxAvg) {
+			maxAvg = windowAvgs[ch];
+			loc = ch;
+		} 		
+	}
+	
+	// If the indicated location and the opposite side are within LOC_MARGIN % of each other,
+	// a wall might be present. Conclude that location can't be determined confidently
+	if (maxAvg < (1+LOC_MARGIN) * windowAvgs[array.opposite[loc]]) {
+		loc = -1;
+	}
+		
+		
+	LOG(LOG_INFO, "The EV was detected in direction %d. \n", (int)MicLocation(array, loc));
+	
+	return loc;
+}
+
+#define INSTANTIATE_DETECTION(T) \
+	template void FftPrint(const char* fileName, const T *data, const double df); \
+	template fft_vars<T> SetupFFT<T>(); \
+	template void FreeFFT(fft_vars<T> &vars); \
+	template void Magnitudes(const T (*out)[2], T *absFFT, const int &n); \
+	template fft_analysis AnalyseSpectrum(const T *absFFT, const multi_thresh_indeces &mtIndeces); \
+	template fft_analysis AnalyseWindow(fft_vars<T> &vars, const multi_thresh_indeces &mtIndeces); \
+	template fft_analysis AnalyseWindowReference(fft_vars<T> &vars, const multi_thresh_indeces &mtIndeces); \
+	template fft_analysis DoFFT(fft_vars<T> &vars, const double *samples, const multi_thresh_indeces &mtIndeces, const bool &split, const int &i); \
+	template void SplitWindowDetection(multi_thresh_indeces mtIndeces, int &detections, const stft_history<T> &hist, const int &ch, fft_analysis &fftAnal, fft_vars<T> &fftV); \
+	template fft_analysis AnalyseSpectrumFixed<parent_config>(const T *absFFT); \
+	template fft_analysis AnalyseSpectrumFixed<sub_config>(const T *absFFT);
+
+INSTANTIATE_DETECTION(double)
+INSTANTIATE_DETECTION(float)
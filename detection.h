@@ -0,0 +1,145 @@
+#ifndef DETECTION_H
+#define DETECTION_H
+
+#include <fftw3.h>
+#include "arena.h"
+#include "detconfig.h"
+#include "display.h"
+#include "micarray.h"
+#include "precision.h"
+#include "stft.h"
+
+
+// Extreme doppler effect coefficients
+constexpr double DOPPLER_MIN = 0.9592;
+constexpr double DOPPLER_MAX = 1.1777;
+// Define frequency band of interest
+constexpr double BAND_FREQ_MIN  =700;
+constexpr double BAND_FREQ_MAX = 1600;
+// Frequencies for multithresholding
+constexpr double NOISE_LOWMIN = 250;
+constexpr double NOISE_LOWMAX = 500;
+constexpr double NOISE_HIGHMIN = 1885;
+constexpr double NOISE_HIGHMAX = 3000;
+// Number of bands for multithresholding
+const int BANDS = 6;
+constexpr double NOISE_COEFF[BANDS] = {3.2,3.0,3.2,2.8,2.8,3.2};  
+// Sampling constants (might need to check in program)
+constexpr double st = 2.058;   // Sampling time
+constexpr double fs = 8000;   // 8kHz sampling
+const int N = 16464;   // # of samples
+const int N_CH = 4;   // # of Mics unless an array is loaded, see micarray.h
+const int S = 2;   // # of fft_analysis to store (per channel)
+// FFT-variables
+const bool DOPPLER = true;
+// Direction, location constants
+const double DIR_MARGIN = 0.02;
+const double LOC_MARGIN = 0.1;  // Used to compare two opposite sides if wall echo is suspected 
+
+// The band layout above, see detconfig.h
+struct pi_bands {
+	static constexpr int bands = BANDS;
+	static constexpr double bandMin = BAND_FREQ_MIN;
+	static constexpr double bandMax = BAND_FREQ_MAX;
+	static constexpr double dopplerMin = DOPPLER_MIN;
+	static constexpr double dopplerMax = DOPPLER_MAX;
+	static constexpr double noiseLowMin = NOISE_LOWMIN;
+	static constexpr double noiseLowMax = NOISE_LOWMAX;
+	static constexpr double noiseHighMin = NOISE_HIGHMIN;
+	static constexpr double noiseHighMax = NOISE_HIGHMAX;
+};
+
+typedef band_table<BANDS> multi_thresh_indeces;
+
+// Parent windows at the nominal rate, bands narrowed for doppler
+typedef detector_config<pi_bands, N, (int)fs, DOPPLER> parent_config;
+// Sub-windows, N/2 samples as SubWindowAnalysis takes them, without doppler as
+// Main.cpp's direction windows. Split windows are N long and use the parent's table.
+typedef detector_config<pi_bands, N / 2, (int)fs, false> sub_config;
+
+// Per-window FFT state in sample precision T, double or float (fftwf)
+template<typename T>
+struct fft_vars {
+	T *window;
+	typename fftw_api<T>::complex *out;   
+	typename fftw_api<T>::plan p;
+	T *absFFT;   // Filled by the reference path only
+	double *prefix;   // Prefix-summed magnitudes, see bandsum.h
+};
+
+struct fft_analysis {
+	double bandAvgs[BANDS];
+	double noiseThresh;
+};
+
+/* The latest windows' analyses of every channel, the oldest overwritten
+ * first. Kept structure-of-arrays, band averages and noise thresholds in
+ * separate [window][channel] rows, in memory taken from an arena at setup,
+ * so keeping history never allocates and functions read it in place.
+*/
+struct analysis_ring {
+	int capacity;   // # of windows kept
+	int channels;
+	int count;   // # of windows held, at most capacity
+	int latest;   // Slot of the latest window
+	double (*bandAvgs)[BANDS];   // [capacity * channels], slot-major
+	double *noiseThresh;   // [capacity * channels]
+};
+
+template<typename T>
+void FftPrint(const char* fileName, const T *data, const double df);
+
+multi_thresh_indeces SetupMultiThresholding(const int &n, const bool &doppler, const double &rate = fs);
+
+template<typename T = double>
+fft_vars<T> SetupFFT();
+
+template<typename T>
+void FreeFFT(fft_vars<T> &vars);
+
+template<typename T>
+void Magnitudes(const T (*out)[2], T *absFFT, const int &n);
+
+template<typename T>
+fft_analysis AnalyseSpectrum(const T *absFFT, const multi_thresh_indeces &mtIndeces);
+
+template<typename T>
+fft_analysis AnalyseWindow(fft_vars<T> &vars, const multi_thresh_indeces &mtIndeces);
+
+template<typename Config, typename T>
+fft_analysis AnalyseSpectrumFixed(const T *absFFT);
+
+template<typename T>
+fft_analysis AnalyseWindowReference(fft_vars<T> &vars, const multi_thresh_indeces &mtIndeces);
+
+void PrintAnalysis(const fft_analysis &fftAnal, const int &i, const char *label = "Window");
+
+template<typename T>
+fft_analysis DoFFT(fft_vars<T> &vars, const double *samples, const multi_thresh_indeces &mtIndeces, const bool &split, const int &i);
+
+int Detect(const fft_analysis &fftAnal, int (&detectedBands)[BANDS]);
+
+void PrintDetection(const int (&detectedBands)[BANDS]);
+
+void KeepBetterDetection(int &detections, fft_analysis &fftAnal, const fft_analysis &fftAnalRev);
+
+template<typename T>
+void SplitWindowDetection(multi_thresh_indeces mtIndeces, int &detections, const stft_history<T> &hist, const int &ch, fft_analysis &fftAnal, fft_vars<T> &fftV);
+
+size_t AnalysisRingBytes(const int &capacity, const int &channels);
+
+void SetupAnalysisRing(analysis_ring &anals, const int &capacity, const int &channels, arena &mem);
+
+void ClearAnalyses(analysis_ring &anals);
+
+void PushAnalyses(analysis_ring &anals, const fft_analysis *chAnals);
+
+int AnalysisSlot(const analysis_ring &anals, const int &age);
+
+const double *AnalysisBands(const analysis_ring &anals, const int &slot, const int &ch);
+
+direction Direction(const analysis_ring &anals, const int &age, const int &loc);
+
+int Location(const analysis_ring &anals, const mic_array &array);
+
+#endif
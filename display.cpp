@@ -1,65 +1,92 @@
 #include "display.h"
 
 
+static uint8_t mockModes[MOCK_GPIO_PINS];
+static uint8_t mockLevels[MOCK_GPIO_PINS];
+
+static void MockFsel(uint8_t pin, uint8_t mode) { mockModes[pin] = mode; }
+static void MockSet(uint8_t pin) { mockLevels[pin] = HIGH; }
+static void MockClr(uint8_t pin) { mockLevels[pin] = LOW; }
+
+static display_gpio gpio = {bcm2835_gpio_fsel, bcm2835_gpio_set, bcm2835_gpio_clr};
+
+/* Routes the display to the mock GPIO, or back to the bcm2835 library
+ * \param[in] mock Whether to only record pin modes and levels
+*/
+void UseMockGpio(const bool &mock)
+{
+	if (mock) {
+		gpio = {MockFsel, MockSet, MockClr};
+	} else {
+		gpio = {bcm2835_gpio_fsel, bcm2835_gpio_set, bcm2835_gpio_clr};
+	}
+}
+
+// Level last written to a pin of the mock GPIO
+uint8_t MockGpioLevel(const uint8_t &pin)
+{
+	return mockLevels[pin];
+}
+
 void initialize_display_pins()
 {
 	/* pin 0 controls the middle led, connected to ground*/
-	bcm2835_gpio_fsel(PIN0, BCM2835_GPIO_FSEL_OUTP);
+	gpio.fsel(PIN0, BCM2835_GPIO_FSEL_OUTP);
 
 	/* pin 1 to 4 is charlieplexed*/
-	bcm2835_gpio_fsel(PIN1, BCM2835_GPIO_FSEL_INPT);
-	bcm2835_gpio_fsel(PIN2, BCM2835_GPIO_FSEL_INPT);
-	bcm2835_gpio_fsel(PIN3, BCM2835_GPIO_FSEL_INPT);
-	bcm2835_gpio_fsel(PIN4, BCM2835_GPIO_FSEL_INPT);	
+	gpio.fsel(PIN1, BCM2835_GPIO_FSEL_INPT);
+	gpio.fsel(PIN2, BCM2835_GPIO_FSEL_INPT);
+	gpio.fsel(PIN3, BCM2835_GPIO_FSEL_INPT);
+	gpio.fsel(PIN4, BCM2835_GPIO_FSEL_INPT);	
 }
 
 void update_display(const int &cycles, const location &loc, const direction &dir)
 {
 	if (cycles > MAX_CYCLES) {
 			// No EV
-			bcm2835_gpio_fsel(PIN1, BCM2835_GPIO_FSEL_INPT);
-			bcm2835_gpio_fsel(PIN2, BCM2835_GPIO_FSEL_INPT);
-			bcm2835_gpio_fsel(PIN3, BCM2835_GPIO_FSEL_INPT);
-			bcm2835_gpio_fsel(PIN4, BCM2835_GPIO_FSEL_INPT);
+			gpio.fsel(PIN1, BCM2835_GPIO_FSEL_INPT);
+			gpio.fsel(PIN2, BCM2835_GPIO_FSEL_INPT);
+			gpio.fsel(PIN3, BCM2835_GPIO_FSEL_INPT);
+			gpio.fsel(PIN4, BCM2835_GPIO_FSEL_INPT);
 
-			bcm2835_gpio_clr(PIN0);
+			gpio.clr(PIN0);
 	} else {
 		switch(loc) {
 			case north:
 				switch (dir) {
 					case no_dir:
 						// North
-						bcm2835_gpio_fsel(PIN1, BCM2835_GPIO_FSEL_OUTP);
-						bcm2835_gpio_fsel(PIN2, BCM2835_GPIO_FSEL_OUTP);
-						bcm2835_gpio_fsel(PIN3, BCM2835_GPIO_FSEL_INPT);
-						bcm2835_gpio_fsel(PIN4, BCM2835_GPIO_FSEL_OUTP);
+						gpio.fsel(PIN1, BCM2835_GPIO_FSEL_OUTP);
+						gpio.fsel(PIN2, BCM2835_GPIO_FSEL_OUTP);
+						gpio.fsel(PIN3, BCM2835_GPIO_FSEL_INPT);
+						gpio.fsel(PIN4, BCM2835_GPIO_FSEL_OUTP);
 						
-						bcm2835_gpio_set(PIN0);
-						bcm2835_gpio_clr(PIN1);
-						bcm2835_gpio_set(PIN2);
-						bcm2835_gpio_set(PIN4);
+						gpio.set(PIN0);
+						gpio.clr(PIN1);
+						gpio.set(PIN2);
+						gpio.set(PIN4);
 						break;
 					case receding:
 						// North out
-						bcm2835_gpio_fsel(PIN1, BCM2835_GPIO_FSEL_OUTP);
-						bcm2835_gpio_fsel(PIN2, BCM2835_GPIO_FSEL_INPT);
-						bcm2835_gpio_fsel(PIN3, BCM2835_GPIO_FSEL_INPT);
-						bcm2835_gpio_fsel(PIN4, BCM2835_GPIO_FSEL_OUTP);
+						gpio.fsel(PIN1, BCM2835_GPIO_FSEL_OUTP);
+						gpio.fsel(PIN2, BCM2835_GPIO_FSEL_INPT);
+						gpio.fsel(PIN3, BCM2835_GPIO_FSEL_INPT);
+						gpio.fsel(PIN4, BCM2835_GPIO_FSEL_OUTP);
 						
-						bcm2835_gpio_set(PIN0);
-						bcm2835_gpio_set(PIN4);
-						bcm2835_gpio_clr(PIN1);
+						gpio.set(PIN0);
+						gpio.set(PIN4);
+						gpio.clr(PIN1);
 						break;
 					case approaching:
 						// North in
-						bcm2835_gpio_fsel(PIN1, BCM2835_GPIO_FSEL_OUTP);
-						bcm2835_gpio_fsel(PIN2, BCM2835_GPIO_FSEL_OUTP);
-						bcm2835_gpio_fsel(PIN3, BCM2835_GPIO_FSEL_INPT);
-						bcm2835_gpio_fsel(PIN4, BCM2835_GPIO_FSEL_INPT);
+						gpio.fsel(PIN1, BCM2835_GPIO_FSEL_OUTP);
+						gpio.fsel(PIN2, BCM2835_GPIO_FSEL_OUTP);
+						gpio.fsel(PIN3, BCM2835_GPIO_FSEL_INPT);
+						gpio.fsel(PIN4, BCM2835_GPIO_FSEL_INPT);
 						
-						bcm2835_gpio_set(PIN0);
-						bcm2835_gpio_set(PIN2);
-						bcm2835_gpio_clr(PIN1);
+						gpio.set(PIN0);
+						gpio.set(PIN2);
+						gpio.clr(PIN1);
 						break;
 				}
 				break;
@@ -67,37 +94,37 @@ void update_display(const int &cycles, const location &loc, const direction &dir
 				switch (dir) {
 					case no_dir:
 						// South
-						bcm2835_gpio_fsel(PIN1, BCM2835_GPIO_FSEL_INPT);
-						bcm2835_gpio_fsel(PIN2, BCM2835_GPIO_FSEL_OUTP);
-						bcm2835_gpio_fsel(PIN3, BCM2835_GPIO_FSEL_OUTP);
-						bcm2835_gpio_fsel(PIN4, BCM2835_GPIO_FSEL_OUTP);
+						gpio.fsel(PIN1, BCM2835_GPIO_FSEL_INPT);
+						gpio.fsel(PIN2, BCM2835_GPIO_FSEL_OUTP);
+						gpio.fsel(PIN3, BCM2835_GPIO_FSEL_OUTP);
+						gpio.fsel(PIN4, BCM2835_GPIO_FSEL_OUTP);
 						
-						bcm2835_gpio_set(PIN0);
-						bcm2835_gpio_clr(PIN4);
-						bcm2835_gpio_set(PIN3);
-						bcm2835_gpio_set(PIN2);
+						gpio.set(PIN0);
+						gpio.clr(PIN4);
+						gpio.set(PIN3);
+						gpio.set(PIN2);
 						break;
 					case receding:
 						// South out
-						bcm2835_gpio_fsel(PIN1, BCM2835_GPIO_FSEL_INPT);
-						bcm2835_gpio_fsel(PIN2, BCM2835_GPIO_FSEL_OUTP);
-						bcm2835_gpio_fsel(PIN3, BCM2835_GPIO_FSEL_INPT);
-						bcm2835_gpio_fsel(PIN4, BCM2835_GPIO_FSEL_OUTP);
+						gpio.fsel(PIN1, BCM2835_GPIO_FSEL_INPT);
+						gpio.fsel(PIN2, BCM2835_GPIO_FSEL_OUTP);
+						gpio.fsel(PIN3, BCM2835_GPIO_FSEL_INPT);
+						gpio.fsel(PIN4, BCM2835_GPIO_FSEL_OUTP);
 						
-						bcm2835_gpio_set(PIN0);
-						bcm2835_gpio_set(PIN2);
-						bcm2835_gpio_clr(PIN4);
+						gpio.set(PIN0);
+						gpio.set(PIN2);
+						gpio.clr(PIN4);
 						break;
 					case approaching:
 						// South in
-						bcm2835_gpio_fsel(PIN1, BCM2835_GPIO_FSEL_INPT);
-						bcm2835_gpio_fsel(PIN2, BCM2835_GPIO_FSEL_INPT);
-						bcm2835_gpio_fsel(PIN3, BCM2835_GPIO_FSEL_OUTP);
-						bcm2835_gpio_fsel(PIN4, BCM2835_GPIO_FSEL_OUTP);
+						gpio.fsel(PIN1, BCM2835_GPIO_FSEL_INPT);
+						gpio.fsel(PIN2, BCM2835_GPIO_FSEL_INPT);
+						gpio.fsel(PIN3, BCM2835_GPIO_FSEL_OUTP);
+						gpio.fsel(PIN4, BCM2835_GPIO_FSEL_OUTP);
 						
-						bcm2835_gpio_set(PIN0);
-						bcm2835_gpio_set(PIN3);
-						bcm2835_gpio_clr(PIN4);
+						gpio.set(PIN0);
+						gpio.set(PIN3);
+						gpio.clr(PIN4);
 						break;
 				}
 				break;
@@ -105,37 +132,37 @@ void update_display(const int &cycles, const location &loc, const direction &dir
 				switch (dir) {
 					case no_dir:
 						// West
-						bcm2835_gpio_fsel(PIN1, BCM2835_GPIO_FSEL_OUTP);
-						bcm2835_gpio_fsel(PIN2, BCM2835_GPIO_FSEL_OUTP);
-						bcm2835_gpio_fsel(PIN3, BCM2835_GPIO_FSEL_OUTP);
-						bcm2835_gpio_fsel(PIN4, BCM2835_GPIO_FSEL_INPT);
+						gpio.fsel(PIN1, BCM2835_GPIO_FSEL_OUTP);
+						gpio.fsel(PIN2, BCM2835_GPIO_FSEL_OUTP);
+						gpio.fsel(PIN3, BCM2835_GPIO_FSEL_OUTP);
+						gpio.fsel(PIN4, BCM2835_GPIO_FSEL_INPT);
 						
-						bcm2835_gpio_set(PIN0);
-						bcm2835_gpio_clr(PIN3);
-						bcm2835_gpio_set(PIN1);
-						bcm2835_gpio_set(PIN2);
+						gpio.set(PIN0);
+						gpio.clr(PIN3);
+						gpio.set(PIN1);
+						gpio.set(PIN2);
 						break;
 					case receding:
 						// West out
-						bcm2835_gpio_fsel(PIN1, BCM2835_GPIO_FSEL_INPT);
-						bcm2835_gpio_fsel(PIN2, BCM2835_GPIO_FSEL_OUTP);
-						bcm2835_gpio_fsel(PIN3, BCM2835_GPIO_FSEL_OUTP);
-						bcm2835_gpio_fsel(PIN4, BCM2835_GPIO_FSEL_INPT);
+						gpio.fsel(PIN1, BCM2835_GPIO_FSEL_INPT);
+						gpio.fsel(PIN2, BCM2835_GPIO_FSEL_OUTP);
+						gpio.fsel(PIN3, BCM2835_GPIO_FSEL_OUTP);
+						gpio.fsel(PIN4, BCM2835_GPIO_FSEL_INPT);
 						
-						bcm2835_gpio_set(PIN0);
-						bcm2835_gpio_set(PIN2);
-						bcm2835_gpio_clr(PIN3);
+						gpio.set(PIN0);
+						gpio.set(PIN2);
+						gpio.clr(PIN3);
 						break;
 					case approaching:
 						// West in
-						bcm2835_gpio_fsel(PIN1, BCM2835_GPIO_FSEL_OUTP);
-						bcm2835_gpio_fsel(PIN2, BCM2835_GPIO_FSEL_INPT);
-						bcm2835_gpio_fsel(PIN3, BCM2835_GPIO_FSEL_OUTP);
-						bcm2835_gpio_fsel(PIN4, BCM2835_GPIO_FSEL_INPT);
+						gpio.fsel(PIN1, BCM2835_GPIO_FSEL_OUTP);
+						gpio.fsel(PIN2, BCM2835_GPIO_FSEL_INPT);
+						gpio.fsel(PIN3, BCM2835_GPIO_FSEL_OUTP);
+						gpio.fsel(PIN4, BCM2835_GPIO_FSEL_INPT);
 						
-						bcm2835_gpio_set(PIN0);
-						bcm2835_gpio_set(PIN1);
-						bcm2835_gpio_clr(PIN3);
+						gpio.set(PIN0);
+						gpio.set(PIN1);
+						gpio.clr(PIN3);
 						break;
 				}
 				break;
@@ -143,37 +170,37 @@ void update_display(const int &cycles, const location &loc, const direction &dir
 				switch (dir) {
 					case no_dir:
 						// East
-						bcm2835_gpio_fsel(PIN1, BCM2835_GPIO_FSEL_INPT);
-						bcm2835_gpio_fsel(PIN2, BCM2835_GPIO_FSEL_OUTP);
-						bcm2835_gpio_fsel(PIN3, BCM2835_GPIO_FSEL_OUTP);
-						bcm2835_gpio_fsel(PIN4, BCM2835_GPIO_FSEL_OUTP);
+						gpio.fsel(PIN1, BCM2835_GPIO_FSEL_INPT);
+						gpio.fsel(PIN2, BCM2835_GPIO_FSEL_OUTP);
+						gpio.fsel(PIN3, BCM2835_GPIO_FSEL_OUTP);
+						gpio.fsel(PIN4, BCM2835_GPIO_FSEL_OUTP);
 						
-						bcm2835_gpio_set(PIN0);
-						bcm2835_gpio_clr(PIN2);
-						bcm2835_gpio_set(PIN3);
-						bcm2835_gpio_set(PIN4);
+						gpio.set(PIN0);
+						gpio.clr(PIN2);
+						gpio.set(PIN3);
+						gpio.set(PIN4);
 						break;
 					case receding:
 						// East out
-						bcm2835_gpio_fsel(PIN1, BCM2835_GPIO_FSEL_INPT);
-						bcm2835_gpio_fsel(PIN2, BCM2835_GPIO_FSEL_OUTP);
-						bcm2835_gpio_fsel(PIN3, BCM2835_GPIO_FSEL_OUTP);
-						bcm2835_gpio_fsel(PIN4, BCM2835_GPIO_FSEL_INPT);
+						gpio.fsel(PIN1, BCM2835_GPIO_FSEL_INPT);
+						gpio.fsel(PIN2, BCM2835_GPIO_FSEL_OUTP);
+						gpio.fsel(PIN3, BCM2835_GPIO_FSEL_OUTP);
+						gpio.fsel(PIN4, BCM2835_GPIO_FSEL_INPT);
 						
-						bcm2835_gpio_set(PIN0);
-						bcm2835_gpio_set(PIN3);
-						bcm2835_gpio_clr(PIN2);
+						gpio.set(PIN0);
+						gpio.set(PIN3);
+						gpio.clr(PIN2);
 						break;
 					case approaching:
 						// East in
-						bcm2835_gpio_fsel(PIN1, BCM2835_GPIO_FSEL_INPT);
-						bcm2835_gpio_fsel(PIN2, BCM2835_GPIO_FSEL_OUTP);
-						bcm2835_gpio_fsel(PIN3, BCM2835_GPIO_FSEL_INPT);
-						bcm2835_gpio_fsel(PIN4, BCM2835_GPIO_FSEL_OUTP);
+						gpio.fsel(PIN1, BCM2835_GPIO_FSEL_INPT);
+						gpio.fsel(PIN2, BCM2835_GPIO_FSEL_OUTP);
+						gpio.fsel(PIN3, BCM2835_GPIO_FSEL_INPT);
+						gpio.fsel(PIN4, BCM2835_GPIO_FSEL_OUTP);
 						
-						bcm2835_gpio_set(PIN0);
-						bcm2835_gpio_set(PIN4);
-						bcm2835_gpio_clr(PIN2);
+						gpio.set(PIN0);
+						gpio.set(PIN4);
+						gpio.clr(PIN2);
 						break;
 				}
 				break;
@@ -1,3 +1,6 @@
+#ifndef DISPLAY_H
+#define DISPLAY_H
+
 #include <bcm2835.h>
 
 #define PIN0 RPI_BPLUS_GPIO_J8_11
@@ -7,6 +10,17 @@
 #define PIN4 RPI_BPLUS_GPIO_J8_16
 
 const int MAX_CYCLES = 2;
+const int MOCK_GPIO_PINS = 64;
+
+/* The GPIO calls the display makes, the bcm2835 library's unless
+ * UseMockGpio routes them to a mock that only records pin modes and levels,
+ * so update_display can be timed without a Pi.
+*/
+struct display_gpio {
+	void (*fsel)(uint8_t pin, uint8_t mode);
+	void (*set)(uint8_t pin);
+	void (*clr)(uint8_t pin);
+};
 
 enum direction {
 	approaching,
@@ -22,7 +36,12 @@ enum location {
 	no_loc
 };
 
+void UseMockGpio(const bool &mock);
+
+uint8_t MockGpioLevel(const uint8_t &pin);
+
 void initialize_display_pins();
 
 void update_display(const int &cycles, const location &loc, const direction &dir);
-	
+
+#endif
@@ -0,0 +1,86 @@
+#include "frames.h"
+
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#include <xmmintrin.h>
+#elif defined(__ARM_NEON)
+#include <arm_neon.h>
+#endif
+
+
+/* Reference path, one sample at a time
+ * \param[in] *frames n frames of channels codes each
+ * \param[in] n The # of frames
+ * \param[in] channels The # of codes per frame
+ * \param[in] *dst Channel ch sample j goes to dst[ch * stride + j]
+ * \param[in] stride The # of samples between two channels' rows
+*/
+template<typename T>
+void DeinterleaveFramesScalar(const uint16_t *frames, const int &n, const int &channels, T *dst, const long &stride)
+{
+	for (int j = 0; j < n; j++) {
+		for (int ch = 0; ch < channels; ch++) {
+			dst[ch * stride + j] = frames[(long)j * channels + ch];
+		}
+	}
+}
+
+/* 4 frames x 4 codes at a time for the usual 4 microphones: SSE2 widens and
+ * transposes on x86, NEON deinterleaves on load (vld4). Other channel counts,
+ * and the tail, take the scalar path.
+*/
+template<typename T>
+void DeinterleaveFrames(const uint16_t *frames, const int &n, const int &channels, T *dst, const long &stride)
+{
+	int j = 0;
+
+	if (channels == 4) {
+		T *row[4] = {dst, dst + stride, dst + 2 * stride, dst + 3 * stride};
+#if defined(__SSE2__)
+		const __m128i zero = _mm_setzero_si128();
+		for (; j + 4 <= n; j += 4) {
+			__m128i a = _mm_loadu_si128((const __m128i*)(frames + 4 * j));   // Frames j, j+1
+			__m128i b = _mm_loadu_si128((const __m128i*)(frames + 4 * j + 8));   // Frames j+2, j+3
+			__m128i f0 = _mm_unpacklo_epi16(a, zero);   // Codes are 10-bit, zero extension is exact
+			__m128i f1 = _mm_unpackhi_epi16(a, zero);
+			__m128i f2 = _mm_unpacklo_epi16(b, zero);
+			__m128i f3 = _mm_unpackhi_epi16(b, zero);
+			// Transpose frames into channels
+			__m128i t0 = _mm_unpacklo_epi32(f0, f1);   // c0 c0 c1 c1
+			__m128i t1 = _mm_unpackhi_epi32(f0, f1);   // c2 c2 c3 c3
+			__m128i t2 = _mm_unpacklo_epi32(f2, f3);
+			__m128i t3 = _mm_unpackhi_epi32(f2, f3);
+			__m128i c[4] = {_mm_unpacklo_epi64(t0, t2), _mm_unpackhi_epi64(t0, t2),
+				_mm_unpacklo_epi64(t1, t3), _mm_unpackhi_epi64(t1, t3)};
+			for (int ch = 0; ch < 4; ch++) {
+				if (sizeof(T) == sizeof(float)) {
+					_mm_storeu_ps((float*)(row[ch] + j), _mm_cvtepi32_ps(c[ch]));
+				} else {
+					_mm_storeu_pd((double*)(row[ch] + j), _mm_cvtepi32_pd(c[ch]));
+					_mm_storeu_pd((double*)(row[ch] + j + 2), _mm_cvtepi32_pd(_mm_srli_si128(c[ch], 8)));
+				}
+			}
+		}
+#elif defined(__ARM_NEON)
+		for (; j + 4 <= n; j += 4) {
+			uint16x4x4_t c = vld4_u16(frames + 4 * j);   // Deinterleaves into the 4 channels
+			for (int ch = 0; ch < 4; ch++) {
+				float32x4_t v = vcvtq_f32_u32(vmovl_u16(c.val[ch]));
+				if (sizeof(T) == sizeof(float)) {
+					vst1q_f32((float*)(row[ch] + j), v);
+				} else {
+					float s[4];   // 32-bit ARM has no double lanes, 10-bit codes are exact in float
+					vst1q_f32(s, v);
+					for (int l = 0; l < 4; l++) { row[ch][j + l] = s[l]; }
+				}
+			}
+		}
+#endif
+	}
+	DeinterleaveFramesScalar(frames + (long)j * channels, n - j, channels, dst + j, stride);
+}
+
+template void DeinterleaveFrames(const uint16_t *frames, const int &n, const int &channels, double *dst, const long &stride);
+template void DeinterleaveFrames(const uint16_t *frames, const int &n, const int &channels, float *dst, const long &stride);
+template void DeinterleaveFramesScalar(const uint16_t *frames, const int &n, const int &channels, double *dst, const long &stride);
+template void DeinterleaveFramesScalar(const uint16_t *frames, const int &n, const int &channels, float *dst, const long &stride);
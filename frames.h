@@ -0,0 +1,17 @@
+#ifndef FRAMES_H
+#define FRAMES_H
+
+#include <stdint.h>
+
+/* Raw acquisition stores each sampling instant as one frame of channels
+ * 16-bit ADC codes, channel-interleaved in the order they come off SPI.
+ * Conversion to floating point and splitting into per-channel rows happens
+ * once, off the sampling thread, as the block enters the FFT input stage.
+*/
+template<typename T>
+void DeinterleaveFrames(const uint16_t *frames, const int &n, const int &channels, T *dst, const long &stride);
+
+template<typename T>
+void DeinterleaveFramesScalar(const uint16_t *frames, const int &n, const int &channels, T *dst, const long &stride);
+
+#endif
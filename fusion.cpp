@@ -0,0 +1,209 @@
+#include <cstdio>
+#include <cstdlib>
+#include <math.h>
+#include <algorithm>
+#include "fusion.h"
+
+
+void SetupFusion(fusion &fu)
+{
+	fu.count = 0;
+	fu.nodes = (node_state*)calloc(FUSE_MAX_NODES, sizeof(node_state));
+	fu.index.clear();
+	fu.index.reserve(FUSE_MAX_NODES);   // Ingest never rehashes
+	fu.datagrams = 0;
+	fu.records = 0;
+	fu.malformed = 0;
+	fu.ignored = 0;
+	ClearHistogram(fu.latency);
+}
+
+void FreeFusion(fusion &fu)
+{
+	free(fu.nodes);
+	fu.index.clear();
+}
+
+// The entry of a node, added at the origin the first time it is heard from, or -1 if there is no room
+static int NodeEntry(fusion &fu, const uint32_t &node)
+{
+	auto found = fu.index.find(node);
+	if (found != fu.index.end()) { return found->second; }
+	if (fu.count == FUSE_MAX_NODES) { return -1; }
+
+	node_state &state = fu.nodes[fu.count];
+	state.site = {node, 0, 0, 0};
+	fu.index[node] = fu.count;
+	return fu.count++;
+}
+
+/* Reads where nodes are mounted from a file of one "node x y heading" line
+ * per node. Lines starting with '#' are comments. Only nodes with a site
+ * take part in intersecting bearings.
+ * \param[in] fileName The site file
+*/
+void LoadNodeSites(fusion &fu, const char *fileName)
+{
+	FILE *file = fopen(fileName, "r");
+	if (!file) {
+		printf("Not able to open node sites %s \n", fileName);
+		exit(1);
+	}
+
+	char line[256];
+	for (int l = 1; fgets(line, sizeof(line), file); l++) {
+		node_site site;
+		char first[2];
+		if ((sscanf(line, " %1s", first) != 1) || (first[0] == '#')) { continue; }
+		if (sscanf(line, "%u %lf %lf %lf", &site.node, &site.x, &site.y, &site.heading) != 4) {
+			printf("%s:%d: expected \"node x y heading\" \n", fileName, l);
+			exit(1);
+		}
+		int entry = NodeEntry(fu, site.node);
+		if ((entry < 0) || fu.nodes[entry].placed) {
+			printf("%s:%d: node %u is listed twice, or more than %d nodes \n", fileName, l, site.node, FUSE_MAX_NODES);
+			exit(1);
+		}
+		fu.nodes[entry].site = site;
+		fu.nodes[entry].placed = true;
+	}
+	fclose(file);
+	printf("Loaded the sites of %d nodes \n", fu.count);
+}
+
+/* Decodes a datagram, accounts for its seq and keeps each node's latest window
+ * \param[in] nowNs CLOCK_REALTIME when it was received, for the latency
+*/
+void IngestDatagram(fusion &fu, const char *data, const int &length, const uint64_t &nowNs)
+{
+	net_header header;
+	int records = DecodeDatagram(data, length, header, fu.decoded);
+	if (records < 0) {
+		fu.malformed++;
+		return;
+	}
+	int entry = NodeEntry(fu, header.node);
+	if (entry < 0) {
+		fu.ignored++;
+		return;
+	}
+	fu.datagrams++;
+	fu.records += records;
+
+	node_state &state = fu.nodes[entry];
+	int32_t ahead = (int32_t)(header.seq - state.nextSeq);   // Wraps, as seq does
+	if (!state.seen || (ahead >= 0)) {
+		if (state.seen) { state.lost += ahead; }
+		state.nextSeq = header.seq + 1;
+		state.seen = true;
+	} else {
+		state.late++;   // Counted lost when the later one arrived
+		if (state.lost > 0) { state.lost--; }
+	}
+	state.datagrams++;
+
+	for (int r = 0; r < records; r++) {
+		const net_window &win = fu.decoded[r];
+		RecordLatency(fu.latency, (nowNs > win.endNs) ? nowNs - win.endNs : 0);
+		if ((state.records == 0) || ((int32_t)(win.window - state.latest.window) >= 0)) {
+			state.latest = win;
+		}
+		state.records++;
+	}
+}
+
+// How far a window's siren stands out: the mean band average over the noise threshold, of its loudest channel
+static double WindowLevel(const net_window &win)
+{
+	double level = 0;
+	for (int ch = 0; ch < win.channels; ch++) {
+		double sum = 0;
+		for (int b = 0; b < BANDS; b++) {
+			sum += win.chAnals[ch].bandAvgs[b];
+		}
+		level = std::max(level, sum / BANDS / std::max(win.chAnals[ch].noiseThresh, 1e-12));
+	}
+	return level;
+}
+
+/* Combines the nodes' latest detections that ended within span of the
+ * newest. Every located detection from a node with a site is a line from
+ * the site along its bearing; the point closest to all of them, weighted by
+ * level, is where the siren is, if the lines aren't near parallel and it
+ * lies ahead of every node. Otherwise the loudest node is taken as nearest.
+ * \param[in] span How far apart detections may be, s
+*/
+fused_estimate FuseDetections(const fusion &fu, const double &span)
+{
+	fused_estimate est = {0, 0, false, 0, 0, 0, no_dir, 0};
+	for (int n = 0; n < fu.count; n++) {
+		const node_state &state = fu.nodes[n];
+		if ((state.records > 0) && state.latest.detected) { est.endNs = std::max(est.endNs, state.latest.endNs); }
+	}
+	if (est.endNs == 0) { return est; }
+
+	double a[3] = {0, 0, 0};   // Weighted sum of I - d d^T, symmetric [xx, xy, yy]
+	double b[2] = {0, 0};
+	double votes[2] = {0, 0};   // approaching, receding
+	double loudest = -1;
+	uint64_t window = (uint64_t)(span * 1e9);
+	for (int n = 0; n < fu.count; n++) {
+		const node_state &state = fu.nodes[n];
+		const net_window &win = state.latest;
+		if ((state.records == 0) || !win.detected || (win.endNs + window < est.endNs)) { continue; }
+
+		double w = WindowLevel(win);
+		est.nodes++;
+		if (w > loudest) {
+			loudest = w;
+			est.loudest = state.site.node;
+			est.x = state.site.x;
+			est.y = state.site.y;
+		}
+		if (win.dir != no_dir) { votes[win.dir] += w; }
+		if (!state.placed || (win.loc < 0)) { continue; }
+
+		double theta = (state.site.heading + win.bearing) * M_PI / 180;
+		double dx = cos(theta), dy = sin(theta);
+		double m[3] = {1 - dx * dx, -dx * dy, 1 - dy * dy};
+		a[0] += w * m[0];
+		a[1] += w * m[1];
+		a[2] += w * m[2];
+		b[0] += w * (m[0] * state.site.x + m[1] * state.site.y);
+		b[1] += w * (m[1] * state.site.x + m[2] * state.site.y);
+		est.bearings++;
+	}
+	if ((votes[approaching] > 0) || (votes[receding] > 0)) {
+		est.dir = (votes[approaching] >= votes[receding]) ? approaching : receding;
+	}
+
+	double det = a[0] * a[2] - a[1] * a[1];
+	double trace = a[0] + a[2];
+	if ((est.bearings < 2) || (det <= FUSE_PARALLEL * trace * trace)) { return est; }
+	double x = (a[2] * b[0] - a[1] * b[1]) / det;
+	double y = (a[0] * b[1] - a[1] * b[0]) / det;
+
+	for (int n = 0; n < fu.count; n++) {   // A crossing behind a node is the lines', not the bearings'
+		const node_state &state = fu.nodes[n];
+		const net_window &win = state.latest;
+		if ((state.records == 0) || !win.detected || (win.endNs + window < est.endNs) || !state.placed || (win.loc < 0)) { continue; }
+		double theta = (state.site.heading + win.bearing) * M_PI / 180;
+		if ((x - state.site.x) * cos(theta) + (y - state.site.y) * sin(theta) <= 0) { return est; }
+	}
+	est.intersected = true;
+	est.x = x;
+	est.y = y;
+	return est;
+}
+
+void PrintFusion(const fused_estimate &est)
+{
+	if (est.nodes == 0) { return; }
+	const char *dirs[3] = {"approaching", "moving away", "direction unknown"};
+	if (est.intersected) {
+		printf("EV heard by %d nodes, %d bearings cross at (%.1f, %.1f)m, loudest at node %u, %s \n", est.nodes, est.bearings,
+			est.x, est.y, est.loudest, dirs[est.dir]);
+	} else {
+		printf("EV heard by %d nodes, nearest node %u at (%.1f, %.1f)m, %s \n", est.nodes, est.loudest, est.x, est.y, dirs[est.dir]);
+	}
+}
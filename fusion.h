@@ -0,0 +1,75 @@
+#ifndef FUSION_H
+#define FUSION_H
+
+#include <unordered_map>
+#include "metrics.h"
+#include "netproto.h"
+
+const int FUSE_MAX_NODES = 256;   // Nodes one aggregator tracks, datagrams from more are counted and ignored
+const double FUSE_SPAN = 2 * st;   // Detections fused if their windows ended within this of the latest, s
+const double FUSE_PARALLEL = 1e-3;   // Bearings closer to parallel than this can't be intersected
+
+/* Where a node is mounted in the cluster, metres east and north of a common
+ * origin, and how far its array is turned, degrees counterclockwise, so
+ * its east points along that bearing of the cluster
+*/
+struct node_site {
+	uint32_t node;
+	double x;
+	double y;
+	double heading;
+};
+
+struct node_state {
+	node_site site;
+	bool placed;   // The site was loaded rather than assumed at the origin
+	bool seen;
+	uint32_t nextSeq;   // Expected datagram seq
+	unsigned long datagrams;
+	unsigned long lost;   // Datagrams missing from seq, less those that turned up late
+	unsigned long late;   // Datagrams received out of order
+	unsigned long records;
+	net_window latest;   // The node's latest window by window #
+};
+
+/* Every node's latest verdict, and counts of what arrived. Ingested on one
+ * thread, the latency histogram may be read from any.
+*/
+struct fusion {
+	int count;
+	node_state *nodes;   // [FUSE_MAX_NODES]
+	std::unordered_map<uint32_t, int> index;   // Node id to its nodes entry
+	unsigned long datagrams;
+	unsigned long records;
+	unsigned long malformed;
+	unsigned long ignored;   // From nodes beyond FUSE_MAX_NODES
+	latency_histogram latency;   // End of window on the node to ingest here, ns
+	net_window decoded[NET_MAX_RECORDS];
+};
+
+/* The cluster's combined verdict on its latest detections
+*/
+struct fused_estimate {
+	int nodes;   // # of nodes with a recent detection, 0 if none
+	int bearings;   // # of those that located it
+	bool intersected;   // x, y is where their bearings cross, else the loudest node's site
+	double x;
+	double y;
+	uint32_t loudest;
+	direction dir;   // Level-weighted vote of the detecting nodes
+	uint64_t endNs;   // End of the latest detecting window
+};
+
+void SetupFusion(fusion &fu);
+
+void FreeFusion(fusion &fu);
+
+void LoadNodeSites(fusion &fu, const char *fileName);
+
+void IngestDatagram(fusion &fu, const char *data, const int &length, const uint64_t &nowNs);
+
+fused_estimate FuseDetections(const fusion &fu, const double &span = FUSE_SPAN);
+
+void PrintFusion(const fused_estimate &est);
+
+#endif
@@ -0,0 +1,152 @@
+#include <cstring>
+#include <algorithm>
+#include "halfcache.h"
+#include "bandsum.h"
+#include "plans.h"
+
+
+/* Plans one zero-padded transform covering channels [first, first + count)
+ * \param[in] hist The history the halves will be read from, its hop a multiple of n/2
+ * \param[in] first The first channel
+ * \param[in] count The # of consecutive channels
+*/
+template<typename T>
+half_cache<T> SetupHalfCache(stft_history<T> &hist, const int &first, const int &count)
+{
+	half_cache<T> cache;
+	cache.first = first;
+	cache.count = count;
+	cache.n = hist.n;
+	cache.bins = hist.n / 2 + 1;
+	cache.padded = (T*)fftw_malloc(sizeof(T) * hist.n * count);
+	memset(cache.padded, 0, sizeof(T) * hist.n * count);   // Upper halves stay zero, r2c preserves its input
+	for (int s = 0; s < HALF_SLOTS; s++) {
+		cache.slots[s] = (typename fftw_api<T>::complex*)fftw_malloc(sizeof(typename fftw_api<T>::complex) * cache.bins * count);
+	}
+	cache.out = (typename fftw_api<T>::complex*)fftw_malloc(sizeof(typename fftw_api<T>::complex) * cache.bins);
+	cache.prefix = (double*)fftw_malloc(sizeof(double) * cache.bins);
+	cache.p = GetPlan<T>(hist.n, false, count, hist.n, 0);
+	cache.halves = 0;
+
+	return cache;
+}
+
+template<typename T>
+void FreeHalfCache(half_cache<T> &cache)
+{
+	fftw_free(cache.padded);
+	for (int s = 0; s < HALF_SLOTS; s++) {
+		fftw_free(cache.slots[s]);
+	}
+	fftw_free(cache.out);
+	fftw_free(cache.prefix);
+}
+
+// Forgets every half, as ResetStftHistory
+template<typename T>
+void ResetHalfCache(half_cache<T> &cache)
+{
+	cache.halves = 0;
+}
+
+/* Transforms every half window completed in the history since the last call,
+ * one batched transform per half for all cached channels. Nothing is cached
+ * before a whole window is in.
+ * \param[in] hist The history, appended to since the last call
+ * \return The # of halves transformed
+*/
+template<typename T>
+int CacheHalves(half_cache<T> &cache, const stft_history<T> &hist)
+{
+	int half = cache.n / 2;
+	long complete = hist.pos / half;
+	if (!WindowReady(hist, 0)) { return 0; }
+	if (complete < cache.halves) { cache.halves = 0; }   // The history was reset
+	cache.halves = std::max(cache.halves, complete - 2);   // Older halves have left the history
+
+	int transformed = 0;
+	for (; cache.halves < complete; cache.halves++, transformed++) {
+		int lag = (int)(hist.pos - (cache.halves + 1) * half);   // Samples after the half's end, 0 or n/2
+		for (int c = 0; c < cache.count; c++) {
+			memcpy(cache.padded + (long)c * cache.n, WindowPtr(hist, cache.first + c, 0) + half - lag, sizeof(T) * half);
+		}
+		fftw_api<T>::execute_r2c(cache.p, cache.padded, cache.slots[cache.halves % HALF_SLOTS]);
+	}
+	return transformed;
+}
+
+/* Whether the window of the two halves age halves back is cached
+ * \param[in] age 0 for the latest window, 1 for the split window straddling the previous one
+*/
+template<typename T>
+bool HalfWindowReady(const half_cache<T> &cache, const int &age)
+{
+	return (cache.halves >= age + 2) && (age + 2 <= HALF_SLOTS);
+}
+
+/* Multithresholding of the full window made of two cached halves, combined
+ * as X[m] = Z_a[m] + (-1)^m Z_b[m], over the analysed bins only
+ * \param[in] ch The channel, within [first, first + count)
+ * \param[in] age The # of halves between the window's end and the latest half
+ * \param[in] mtIndeces The multithresholding variables, for n-point windows
+*/
+template<typename T>
+fft_analysis HalfWindowAnalysis(half_cache<T> &cache, const int &ch, const int &age, const multi_thresh_indeces &mtIndeces)
+{
+	const T (*a)[2] = cache.slots[(cache.halves - 2 - age) % HALF_SLOTS] + (long)(ch - cache.first) * cache.bins;
+	const T (*b)[2] = cache.slots[(cache.halves - 1 - age) % HALF_SLOTS] + (long)(ch - cache.first) * cache.bins;
+	int lo, hi;
+	BinRange(mtIndeces, lo, hi);
+
+	for (int m = lo; m < hi; m++) {
+		T sign = (m & 1) ? -1 : 1;
+		cache.out[m][0] = a[m][0] + sign * b[m][0];
+		cache.out[m][1] = a[m][1] + sign * b[m][1];
+	}
+	MagnitudePrefix(cache.out, cache.n, lo, hi, cache.prefix);
+	return PrefixAnalysis(cache.prefix, lo, mtIndeces);
+}
+
+/* Multithresholding of one cached half on its own, an n/2-point window,
+ * whose spectrum is every other bin of the half's padded one
+ * \param[in] ch The channel, within [first, first + count)
+ * \param[in] age The # of halves before the latest, 0 for the latest
+ * \param[in] mtHalf The multithresholding variables, for n/2-point windows
+*/
+template<typename T>
+fft_analysis SubWindowAnalysis(half_cache<T> &cache, const int &ch, const int &age, const multi_thresh_indeces &mtHalf)
+{
+	const T (*z)[2] = cache.slots[(cache.halves - 1 - age) % HALF_SLOTS] + (long)(ch - cache.first) * cache.bins;
+	int lo, hi;
+	BinRange(mtHalf, lo, hi);
+
+	for (int k = lo; k < hi; k++) {
+		cache.out[k][0] = z[2 * k][0];
+		cache.out[k][1] = z[2 * k][1];
+	}
+	MagnitudePrefix(cache.out, cache.n / 2, lo, hi, cache.prefix);
+	return PrefixAnalysis(cache.prefix, lo, mtHalf);
+}
+
+/* As SplitWindowDetection on the history, but the split window is combined
+ * from cached halves, so the retry costs no transform
+*/
+template<typename T>
+void SplitWindowDetection(multi_thresh_indeces mtIndeces, int &detections, half_cache<T> &cache, const int &ch, fft_analysis &fftAnal)
+{
+	if (!HalfWindowReady(cache, 1)) { return; }
+	KeepBetterDetection(detections, fftAnal, HalfWindowAnalysis(cache, ch, 1, mtIndeces));
+}
+
+#define INSTANTIATE_HALFCACHE(T) \
+	template half_cache<T> SetupHalfCache(stft_history<T> &hist, const int &first, const int &count); \
+	template void FreeHalfCache(half_cache<T> &cache); \
+	template void ResetHalfCache(half_cache<T> &cache); \
+	template int CacheHalves(half_cache<T> &cache, const stft_history<T> &hist); \
+	template bool HalfWindowReady(const half_cache<T> &cache, const int &age); \
+	template fft_analysis HalfWindowAnalysis(half_cache<T> &cache, const int &ch, const int &age, const multi_thresh_indeces &mtIndeces); \
+	template fft_analysis SubWindowAnalysis(half_cache<T> &cache, const int &ch, const int &age, const multi_thresh_indeces &mtHalf); \
+	template void SplitWindowDetection(multi_thresh_indeces mtIndeces, int &detections, half_cache<T> &cache, const int &ch, fft_analysis &fftAnal);
+
+INSTANTIATE_HALFCACHE(double)
+INSTANTIATE_HALFCACHE(float)
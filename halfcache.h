@@ -0,0 +1,57 @@
+#ifndef HALFCACHE_H
+#define HALFCACHE_H
+
+#include <fftw3.h>
+#include "detection.h"
+#include "precision.h"
+#include "stft.h"
+
+const int HALF_SLOTS = 3;   // Halves cached, enough for the split window and the current one
+
+/* Spectra of the latest half windows, each transformed once as it completes.
+ * A half h is kept as the n-point transform of h followed by n/2 zeros, Z_h.
+ * Then the window of two consecutive halves (a, b) has the spectrum
+ * X[m] = Z_a[m] + (-1)^m Z_b[m], and half a on its own, as an n/2-point
+ * window, has Z_a[2k]. So the parent window, the split window straddling the
+ * previous one and both sub-windows are all sums of cached spectra, and need
+ * no transforms of their own. Covers a run of channels, as multi_fft_vars.
+*/
+template<typename T>
+struct half_cache {
+	int first;   // First channel cached
+	int count;   // # of channels cached
+	int n;   // Full window length
+	int bins;   // # of r2c output bins per channel, n/2+1
+	T *padded;   // [count][n], one half then zeros, the plan's input
+	typename fftw_api<T>::plan p;
+	typename fftw_api<T>::complex *slots[HALF_SLOTS];   // [count][bins] each, Z of every channel's half
+	long halves;   // # of halves cached since the last reset, the latest in slot (halves - 1) % HALF_SLOTS
+	typename fftw_api<T>::complex *out;   // [bins], a combined spectrum
+	double *prefix;   // [bins]
+};
+
+template<typename T>
+half_cache<T> SetupHalfCache(stft_history<T> &hist, const int &first, const int &count);
+
+template<typename T>
+void FreeHalfCache(half_cache<T> &cache);
+
+template<typename T>
+void ResetHalfCache(half_cache<T> &cache);
+
+template<typename T>
+int CacheHalves(half_cache<T> &cache, const stft_history<T> &hist);
+
+template<typename T>
+bool HalfWindowReady(const half_cache<T> &cache, const int &age);
+
+template<typename T>
+fft_analysis HalfWindowAnalysis(half_cache<T> &cache, const int &ch, const int &age, const multi_thresh_indeces &mtIndeces);
+
+template<typename T>
+fft_analysis SubWindowAnalysis(half_cache<T> &cache, const int &ch, const int &age, const multi_thresh_indeces &mtHalf);
+
+template<typename T>
+void SplitWindowDetection(multi_thresh_indeces mtIndeces, int &detections, half_cache<T> &cache, const int &ch, fft_analysis &fftAnal);
+
+#endif
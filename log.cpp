@@ -0,0 +1,198 @@
+#include <cstdlib>
+#include <cstring>
+#include <algorithm>
+#include <chrono>
+#include <thread>
+#include <time.h>
+#include "log.h"
+#include "spsc.h"
+
+
+std::atomic<int> logLevel(LOG_DEBUG);
+
+// Ring of one logging thread, the sink its consumer
+struct log_ring {
+	log_record records[LOG_RING];
+	spsc_index queue;   // Records queued and written out
+};
+
+static log_ring *rings = NULL;   // [LOG_PRODUCERS], allocated by SetupLog
+static std::atomic<int> producers(0);   // # of rings handed out
+static std::atomic<unsigned long> dropped(0);
+static std::atomic<bool> running(false);
+static std::thread sink;
+static FILE *logOut = stdout;
+static thread_local int ringIndex = -1;   // This thread's ring, claimed on its first record
+
+/* Formats a record as printf would have, one conversion at a time
+ * \param[in] *line The buffer to hold the line
+ * \param[in] size The size of line
+*/
+static void FormatRecord(const log_record &rec, char *line, const size_t &size)
+{
+	size_t len = 0;
+	int k = 0;
+	const char *p = rec.fmt;
+
+	while (*p && (len < size - 1)) {
+		if (*p != '%') {
+			line[len++] = *p++;
+			continue;
+		}
+		if (p[1] == '%') {
+			line[len++] = '%';
+			p += 2;
+			continue;
+		}
+		const char *end = p + 1;
+		while (*end && !strchr("diouxXeEfFgGaAcsp", *end)) { end++; }
+		if (!*end || (k >= rec.nargs)) { break; }
+
+		char spec[32];
+		size_t n = std::min((size_t)(end - p + 1), sizeof(spec) - 1);
+		memcpy(spec, p, n);
+		spec[n] = '\0';
+
+		const log_arg &a = rec.args[k++];
+		char *out = line + len;
+		size_t room = size - len;
+		int w = 0;
+		switch (a.type) {
+			case 'i': w = snprintf(out, room, spec, a.i); break;
+			case 'u': w = snprintf(out, room, spec, a.u); break;
+			case 'l': w = snprintf(out, room, spec, a.l); break;
+			case 'L': w = snprintf(out, room, spec, a.ul); break;
+			case 'q': w = snprintf(out, room, spec, a.ll); break;
+			case 'Q': w = snprintf(out, room, spec, a.ull); break;
+			case 'd': w = snprintf(out, room, spec, a.d); break;
+			case 's': w = snprintf(out, room, spec, a.s); break;
+		}
+		len += std::min((size_t)std::max(w, 0), room - 1);
+		p = end + 1;
+	}
+	line[len] = '\0';
+}
+
+/* Sink thread. Writes queued records oldest first across all producers,
+ * flushing whenever it runs out, until the log is closed and drained.
+*/
+static void LogSink()
+{
+	char line[LOG_LINE];
+
+	while (1) {
+		int oldest = -1;
+		uint64_t ns = UINT64_MAX;
+		int count = std::min(producers.load(std::memory_order_acquire), LOG_PRODUCERS);
+		for (int r = 0; r < count; r++) {
+			unsigned long tail = SpscTail(rings[r].queue);
+			if (SpscReady(rings[r].queue, tail) && (rings[r].records[tail % LOG_RING].ns < ns)) {
+				ns = rings[r].records[tail % LOG_RING].ns;
+				oldest = r;
+			}
+		}
+
+		if (oldest < 0) {
+			unsigned long lost = dropped.exchange(0);
+			if (lost > 0) {
+				fprintf(logOut, "%lu log records dropped \n", lost);
+			}
+			fflush(logOut);
+			if (!running.load(std::memory_order_acquire)) { break; }
+			std::this_thread::sleep_for(std::chrono::milliseconds(1));   // Records wait at most this long, writers never do
+			continue;
+		}
+
+		log_ring &ring = rings[oldest];
+		unsigned long tail = SpscTail(ring.queue);
+		FormatRecord(ring.records[tail % LOG_RING], line, sizeof(line));
+		SpscRelease(ring.queue, tail + 1);
+		fputs(line, logOut);
+	}
+}
+
+/* Queues a record on the calling thread's ring. Never blocks: if the ring is
+ * full, or more threads log than there are rings, the record is counted as
+ * dropped. Before SetupLog and after CloseLog records are written directly.
+*/
+void LogPush(const log_level &level, const char *fmt, const log_arg *args, const int &nargs)
+{
+	log_record direct;
+	log_record *rec = &direct;
+	log_ring *ring = NULL;
+
+	if (running.load(std::memory_order_acquire)) {
+		if (ringIndex < 0) { ringIndex = producers.fetch_add(1); }
+		if (ringIndex >= LOG_PRODUCERS) {
+			dropped.fetch_add(1, std::memory_order_relaxed);
+			return;
+		}
+		ring = &rings[ringIndex];
+		if (!SpscRoom(ring->queue, LOG_RING)) {
+			dropped.fetch_add(1, std::memory_order_relaxed);
+			return;
+		}
+		rec = &ring->records[SpscHead(ring->queue) % LOG_RING];
+	}
+
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	rec->ns = ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+	rec->level = level;
+	rec->fmt = fmt;
+	rec->nargs = nargs;
+	std::copy(args, args + nargs, rec->args);
+
+	if (ring) {
+		SpscPublish(ring->queue);
+	} else {
+		char line[LOG_LINE];
+		FormatRecord(direct, line, sizeof(line));
+		fputs(line, logOut);
+	}
+}
+
+// Drains and stops the sink if the program exits without CloseLog, e.g. exit(1) on a setup error
+static void CloseLogAtExit()
+{
+	if (sink.joinable()) { CloseLog(); }
+}
+
+/* Sets the level and starts the sink thread. From here on, logging threads
+ * only queue records.
+ * \param[in] level The most detailed level written
+ * \param[in] out Where the sink writes, e.g. stdout
+*/
+void SetupLog(const log_level &level, FILE *out)
+{
+	logLevel = level;
+	logOut = out;
+	if (rings == NULL) {
+		rings = new log_ring[LOG_PRODUCERS];
+	}
+	for (int r = 0; r < LOG_PRODUCERS; r++) {
+		ResetSpsc(rings[r].queue);
+	}
+	running = true;
+	sink = std::thread(LogSink);
+	static bool registered = false;
+	if (!registered) { registered = (atexit(CloseLogAtExit) == 0); }
+}
+
+// Writes out everything queued and stops the sink, logging is direct after
+void CloseLog()
+{
+	running = false;
+	sink.join();
+}
+
+/* Level by name
+ * \param[in] name "error", "warn", "info" or "debug"
+*/
+log_level LogLevel(const char *name)
+{
+	if (strcmp(name, "error") == 0) { return LOG_ERROR; }
+	if (strcmp(name, "warn") == 0) { return LOG_WARN; }
+	if (strcmp(name, "debug") == 0) { return LOG_DEBUG; }
+	return LOG_INFO;
+}
@@ -0,0 +1,86 @@
+#ifndef LOG_H
+#define LOG_H
+
+#include <atomic>
+#include <cstdio>
+#include <stdint.h>
+
+enum log_level {
+	LOG_ERROR,
+	LOG_WARN,
+	LOG_INFO,   // Detections, location and direction, setup
+	LOG_DEBUG   // Per-window, per-channel and per-band detail
+};
+
+const int LOG_MAX_ARGS = 10;   // Arguments per record, a format with more doesn't compile
+const int LOG_RING = 512;   // Records buffered per producing thread
+const int LOG_PRODUCERS = 8;   // Threads that may log while the sink runs
+const int LOG_LINE = 512;   // Longest formatted line
+
+/* One argument, kept as the type it was passed as, so the sink can hand it
+ * to the conversion the compiler checked it against
+*/
+struct log_arg {
+	char type;
+	union {
+		int i;
+		unsigned u;
+		long l;
+		unsigned long ul;
+		long long ll;
+		unsigned long long ull;
+		double d;
+		const char *s;   // Must outlive the record, e.g. a literal
+	};
+};
+
+/* Fixed-size record: the format and its arguments, formatted later by the sink
+*/
+struct log_record {
+	uint64_t ns;   // CLOCK_MONOTONIC when logged, records are written in this order
+	log_level level;
+	const char *fmt;   // Must be a literal
+	int nargs;
+	log_arg args[LOG_MAX_ARGS];
+};
+
+extern std::atomic<int> logLevel;
+
+inline bool LogEnabled(const log_level &level)
+{
+	return level <= logLevel.load(std::memory_order_relaxed);
+}
+
+inline log_arg LogArg(const int &v) { log_arg a; a.type = 'i'; a.i = v; return a; }
+inline log_arg LogArg(const unsigned &v) { log_arg a; a.type = 'u'; a.u = v; return a; }
+inline log_arg LogArg(const long &v) { log_arg a; a.type = 'l'; a.l = v; return a; }
+inline log_arg LogArg(const unsigned long &v) { log_arg a; a.type = 'L'; a.ul = v; return a; }
+inline log_arg LogArg(const long long &v) { log_arg a; a.type = 'q'; a.ll = v; return a; }
+inline log_arg LogArg(const unsigned long long &v) { log_arg a; a.type = 'Q'; a.ull = v; return a; }
+inline log_arg LogArg(const double &v) { log_arg a; a.type = 'd'; a.d = v; return a; }
+inline log_arg LogArg(const char *v) { log_arg a; a.type = 's'; a.s = v; return a; }
+
+void LogPush(const log_level &level, const char *fmt, const log_arg *args, const int &nargs);
+
+template<typename... A>
+void LogWrite(const log_level &level, const char *fmt, const A &... args)
+{
+	static_assert(sizeof...(A) <= LOG_MAX_ARGS, "Too many arguments for one log record");
+	log_arg packed[sizeof...(A) + 1] = {LogArg(args)...};
+	LogPush(level, fmt, packed, sizeof...(A));
+}
+
+/* Logs a printf-style line at a level. Below the level this is one relaxed
+ * load and a compare. Otherwise the record is queued for the sink thread to
+ * format and write, and never waits; without a running sink it is written
+ * directly. The dead printf has the compiler check the format.
+*/
+#define LOG(level, ...) do { if (LogEnabled(level)) { if (0) { printf(__VA_ARGS__); } LogWrite(level, __VA_ARGS__); } } while (0)
+
+void SetupLog(const log_level &level, FILE *out);
+
+void CloseLog();
+
+log_level LogLevel(const char *name);
+
+#endif
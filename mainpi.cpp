@@ -1,448 +1,532 @@
+// Build: g++ -O2 -march=native -o mainpi mainpi.cpp adcsource.cpp adcspi.cpp alloccheck.cpp arena.cpp capture.cpp bandsum.cpp display.cpp detection.cpp frames.cpp halfcache.cpp log.cpp metrics.cpp micarray.cpp netproto.cpp pipeline.cpp plans.cpp sampleclock.cpp simadc.cpp sirengen.cpp sparse.cpp spectrum.cpp stft.cpp workers.cpp -lfftw3 -lfftw3f -lbcm2835 -lpthread
+// Run with --adc bcm2835|spidev|sim to pick how the MCP3008 is read (--sim for --adc sim), --hop <ms> to analyse overlapping windows every hop,
+// --workers <k> to set the # of threads analysing channels in parallel, --sdft to track only the
+// multithresholding bins with a sliding DFT instead of full FFTs (needs a hop of at most N/2), --half-cache to
+// transform each half window once and combine the parent and split windows from those (needs a hop of N/2 or N),
+// --plan measure|patient --wisdom <file> to plan rigorously once and load the plans from wisdom after,
+// --float to run the history and FFTs in single precision (fftwf), --rate <Hz> to sample at another rate
+// than fs, --mock-spi to run the real sampling loop against a mock MCP3008 (no Pi required),
+// --capture <file> to record every analysed block, --replay <file> to analyse a capture instead of
+// sampling, as fast as analysis allows or at --speed <x> times real time,
+// --synth wail|yelp|hilo|none to run end to end on a generated scene on a virtual clock and report
+// time to detect, false alarms and CPU per simulated hour (--snr <dB> --doppler <m/s> --hours <h> --seed <n>),
+// --log error|warn|info|debug for how much the analysis loop logs (info: detections; debug: every window and band),
+// --metrics <port|socket path> to serve per-stage latency histograms and counters for Prometheus on 127.0.0.1 or a Unix socket,
+// --alloc-check to fail if the sampling or analysis threads allocate from the heap once the first window is analysed,
+// --channels <n> to sample n mics spread evenly around the array (inputs 0-7 on CS0, then CS1), or --array <file> to load
+// the wiring and bearing of each mic, one "select input bearing" line per channel, and --group <n> for the # of channels
+// per analysis task (default: enough tasks for every worker to have two to steal between),
+// --net <host[:port]> --node <id> to send every window's verdict and band averages to an aggregator, detections at
+// once and quiet windows batched for up to --net-flush <s>
+
 #include <cstdio>
 #include <cstdlib>
-#include <fftw3.h>
 #include <math.h>
 #include <bcm2835.h>
 #include <sched.h>
 #include <sys/mman.h>
+#include <time.h>
 #include <chrono>
 #include <iostream>
 #include <algorithm>
-#include <fstream>
 #include <string>
-#include <list>
-#include <array>
+#include <thread>
+#include <csignal>
+#include "adcsource.h"
+#include "alloccheck.h"
+#include "bandsum.h"
+#include "capture.h"
 #include "display.h"
-
-
-// Extreme doppler effect coefficients
-const double DOPPLER_MIN = 0.9592;
-const double DOPPLER_MAX = 1.1777;
-// Define frequency band of interest
-const double BAND_FREQ_MIN  =700;
-const double BAND_FREQ_MAX = 1600;
-// Frequencies for multithresholding
-const double NOISE_LOWMIN = 250;
-const double NOISE_LOWMAX = 500;
-const double NOISE_HIGHMIN = 1885;
-const double NOISE_HIGHMAX = 3000;
-// Number of bands for multithresholding
-const int BANDS = 6;
-const double NOISE_COEFF[BANDS] = {3.2,3.0,3.2,2.8,2.8,3.2};  
-// Sampling constants (might need to check in program)
-const double st = 2.058;   // Sampling time
-const double fs = 8000;   // 8kHz sampling
-const int N = 16464;   // # of samples
-const int N_CH = 4;   // # of Mics
-const char CHANNELS[4] = {0x80,0x90,0xa0,0xb0};   // Code to send to ADC
-const int S = 2;   // # of fft_analysis to store (per channel)
-// Testing-tuned microsecond delay to achieve 8kHz sampling
-const int SAMPLE_DELAY = 55; //55; //21;  //87;  //90; //
-// FFT-variables
-const bool DOPPLER = true;
-// Direction, location constants
-const double DIR_MARGIN = 0.02;
-const double LOC_MARGIN = 0.1;  // Used to compare two opposite sides if wall echo is suspected 
-
-struct multi_thresh_indeces {
-	int bandIndeces[BANDS + 1];
-	int bandLength;
-	int noiseIndexLowMin;
-	int noiseIndexLowMax;
-	int noiseIndexHighMin;
-	int noiseIndexHighMax;
-};
-
-struct fft_vars {
-	double *window;
-	fftw_complex *out;   
-	fftw_plan p;
-	double *absFFT;
-};
-
-struct fft_analysis {
-	double bandAvgs[BANDS];
-	double noiseThresh;
-};
-
-void FftPrint(const char* fileName, double *data, const double df)
-{
-	std::ofstream myFile;
-	myFile.open(fileName);
-
-	for (int i = 0; i < N/2-1; i++) {
-
-		myFile << (double)i*df << ": " << data[i]*(N/2) << "\n";
-	}
-	myFile.close();
-}
-
-/* Configures the SPI communication with the ADC 
-*/
-void SpiSetup() 
-{
-	if (!bcm2835_init())
-	{
-		printf("bcm2835 initialisation failed \n");
-		exit(1);
-	}
-	
-	bcm2835_spi_begin();
-	bcm2835_spi_setBitOrder(BCM2835_SPI_BIT_ORDER_MSBFIRST);
-	bcm2835_spi_setDataMode(BCM2835_SPI_MODE0); // Data comes in on falling edge
-	bcm2835_spi_setClockDivider(BCM2835_SPI_CLOCK_DIVIDER_256); // 250MHz / 256 = ~1000kHz
-	bcm2835_spi_chipSelect(BCM2835_SPI_CS0);
-	bcm2835_spi_setChipSelectPolarity(BCM2835_SPI_CS0, LOW);
-}
-
-/* Creates a multi_thresh_indeces variable containing the array
- * indeces representing relevant band frequcneis to be used in multithresholding
- * \param[in] n The window length to setup for
- * \param[in] doppler Whether doppler's effect will be accounted for
+#include "detection.h"
+#include "halfcache.h"
+#include "log.h"
+#include "netproto.h"
+#include "metrics.h"
+#include "pipeline.h"
+#include "plans.h"
+#include "sampleclock.h"
+#include "sparse.h"
+#include "spectrum.h"
+#include "stft.h"
+#include "workers.h"
+
+bool allocCheck = false;   // Count heap allocations after initialisation, see alloccheck.h
+
+/* Producer: samples blocks back to back into the ring for as long as it runs,
+ * so no audio is missed while the previous window is being analysed.
+ * \param[in] ring The ring to publish sampled blocks to
+ * \param[in] src The ADC to sample, set up for ring.n frames per block
 */
-multi_thresh_indeces SetupMultiThresholding(const int &n, const bool &doppler)
+void SamplingThread(window_ring &ring, adc_source &src)
 {
-	multi_thresh_indeces mtIndeces;
-
-	double threshLow = BAND_FREQ_MIN * (1 + (doppler * (DOPPLER_MAX - 1)));
-	double threshHigh = BAND_FREQ_MAX * (1 + (doppler * (DOPPLER_MIN - 1)));
-	// TESTING ONLY
-	printf("The band minimum is %.1f and the maximum is %.1f \n", threshLow, threshHigh);
+	unsigned long seq = 0;
+	bool spi = (src.backend == ADC_BCM2835) || (src.backend == ADC_SPIDEV);
+	bool hardware = spi && !src.mock;
 	
-	// Find array indeces
-	double df = (double)fs / (double)n;
-	mtIndeces.bandIndeces[0] = (int)(threshLow / df);
-	mtIndeces.bandIndeces[BANDS] = (int)(threshHigh / df);
-	mtIndeces.bandLength = (mtIndeces.bandIndeces[BANDS] - mtIndeces.bandIndeces[0]) / BANDS;
-	for (int i = 1; i < BANDS; i++) {
-		mtIndeces.bandIndeces[i] = mtIndeces.bandIndeces[i - 1] + mtIndeces.bandLength;
+	if (spi) {
+		// Set sampling thread as highest priority in the OS scheduler (per-thread on Linux)
+		struct sched_param sp;
+		//memset(&sp, 0, sizeof(sp));
+		sp.sched_priority = sched_get_priority_max(SCHED_FIFO);
+		sched_setscheduler(0, SCHED_FIFO, &sp);
+		
+		if (hardware && (mlockall(MCL_CURRENT | MCL_FUTURE) != 0)) {   // Prevent paging
+			printf("mlockall failed \n");
+			exit(1);
+		}
+		StartSampleClock(src.clock);
 	}
-
-	mtIndeces.noiseIndexLowMin = (int)(NOISE_LOWMIN / df);
-	mtIndeces.noiseIndexLowMax = (int)(NOISE_LOWMAX / df);
-	mtIndeces.noiseIndexHighMin = (int)(NOISE_HIGHMIN / df);
-	mtIndeces.noiseIndexHighMax = (int)(NOISE_HIGHMAX / df);
-
-	return mtIndeces;
-}
-
-/* Performs an entire sample window (all channels), saving the results in the
- * parameter array. 
- * \param[in] *samples[N_CH] The array that will hold all samples for this window
- * \return The time taken to complete the sampling window
-*/
-double DoSampling(double *samples[N_CH])
-{
-	static char mosi[4][3] = {{0x01,CHANNELS[0],0x00},{0x01,CHANNELS[1],0x00},{0x01,CHANNELS[2],0x00},{0x01,CHANNELS[3],0x00}};
-	char miso[3] = { 0 };
 	
-	// Set process as highest priority in the OS scheduler
-	struct sched_param sp;
-	//memset(&sp, 0, sizeof(sp));
-	sp.sched_priority = sched_get_priority_max(SCHED_FIFO);
-	sched_setscheduler(0, SCHED_FIFO, &sp);
+	while (ring.running) {
+		bool virtualClock = (src.backend == ADC_REPLAY) || (src.backend == ADC_SYNTH);
+		window_slot *slot = virtualClock ? WaitWriteSlot(ring) : AcquireWriteSlot(ring);   // Recorded or generated audio loses nothing by waiting
+		if (slot == NULL) { break; }
+		slot->timeSpan = AdcSample(src, slot->frames, ring.n);
+		if (slot->timeSpan < 0) {
+			ring.running = false;   // End of the capture or scene, the consumer drains what was published
+			break;
+		}
+		if (spi) {
+			slot->jitterMean = src.clock.jitter.sum / std::max(src.clock.jitter.count, 1L);
+			slot->jitterMax = src.clock.jitter.max;
+		}
+		slot->seq = seq++;
+		PublishWriteSlot(ring, slot);
+		if (allocCheck && (seq == 1)) { ArmAllocCheck(); }   // Set up once the first block is out
+	}
 	
-	if (mlockall(MCL_CURRENT | MCL_FUTURE) == 0) {   // Prevent paging
-		auto begin = std::chrono::high_resolution_clock::now();
-		for(int i = 0; i < N; i++) {
-			for (int j = 0; j < N_CH; j++) {
-				bcm2835_spi_transfernb(mosi[j], miso, 3); // send/receive 3 bytes
-				samples[j][i] = (miso[1] << 8) + miso[2];
-			}
-			bcm2835_delayMicroseconds(SAMPLE_DELAY);
-		}	
-		auto end = std::chrono::high_resolution_clock::now();
-		munlockall();
-		return std::chrono::duration_cast<std::chrono::milliseconds>(end-begin).count() / 1000.0; // Get actual time
-	} else exit(1);
-}
-
-/* Creates and allocates the variables needed to perform FFT repeatedly
-*/ 
-fft_vars SetupFFT() {
-	fft_vars vars;
+	if (hardware) { munlockall(); }
 	
-	vars.window = (double*)malloc(sizeof(double) * 2 * (N / 2 - 1));
-	vars.out = (fftw_complex*)fftw_malloc(sizeof(fftw_complex) * 2 * (N / 2 - 1));   // In-place fft requires in and out to accomodate two out-arrays 
-	vars.p = fftw_plan_dft_r2c_1d(N, vars.window, vars.out, FFTW_ESTIMATE); // MEASURE consumes extra time on initial plan execution. ESTIMATE has no initial timecost.
-	vars.absFFT = (double*)malloc(sizeof(double) * (N / 2 - 1));	
-
-	return vars;
+	struct timespec cpu;
+	clock_gettime(CLOCK_THREAD_CPUTIME_ID, &cpu);
+	src.cpu = cpu.tv_sec + cpu.tv_nsec / 1e9;
 }
 
-/* Employs the multi-thresholding scheme and returns an array
- * of average band volumes.
- * \param[in] vars The fft variables
- * \param[in] *samples The samples to be FFT'd
+/* Consumer: appends every block the sampling thread publishes to a sliding
+ * history and analyses the latest full window each hop. With hop == N the
+ * windows don't overlap, and an inconclusive window is retried on the split
+ * window straddling the previous one. Shorter hops analyse those overlapping
+ * windows anyway, so detection latency scales with the hop instead.
+ * Channels are analysed in parallel on a work-stealing pool. Each task transforms
+ * its own run of channels with one batched plan reading the history in place,
+ * workers that finish early take tasks from those still busy, and results are
+ * joined in channel order before location and direction.
+ * \param[in] ring The ring to read sampled blocks from
  * \param[in] mtIndeces The multithresholding variables
- * \param[in] split Whether the window to analyse is a subwindow
- * \param[in] i The subwindow to FFT - 0 if parent window
- * \return The FFT-analysis in the form of multithresholding average band values
+ * \param[in] array The microphones, one per channel of the ring
+ * \param[in] workers The # of threads to analyse channels on
+ * \param[in] group The # of channels per task
+ * The band indeces follow the sampling rate actually measured, recomputed
+ * whenever it drifts by more than RATE_TOLERANCE from the one in use.
+ * \param[in] sparse Whether to use the sliding DFT backend instead of FFTs
+ * \param[in] cached Whether to combine windows from cached half-window spectra instead
+ * \param[in] rate The target sampling rate mtIndeces was set up for
+ * \param[in] cap Where to record every block before analysis, or NULL
+ * \param[in] score Where to score every window's verdict against a generated scene, or NULL
+ * \param[in] net Where to send every window's verdict for fusion with other nodes, or NULL
+ * \tparam T The precision samples are kept and transformed in, double or float
 */
-fft_analysis DoFFT(fft_vars &vars, const double *samples, const multi_thresh_indeces &mtIndeces, const bool &split, const int &i)
+template<typename T>
+void AnalysisThread(window_ring &ring, multi_thresh_indeces mtIndeces, const mic_array &array, const int workers, const int group, const bool sparse, const bool cached, double rate, capture_writer *cap, detection_score *score, net_sender *net)
 {
-	fft_analysis fftAnal;
-	int n = N;
+	const int channels = array.count;
+	const int tasks = (channels + group - 1) / group;
+	stft_history<T> hist;
+	SetupStftHistory(hist, N, ring.n, channels);
 	
-	// Fill plan input array
-
-	for (int j = 0; j < n; j++) {
-		vars.window[j] = samples[n*i+j];
+	worker_pool pool;
+	SetupWorkerPool(pool, workers);
+	std::vector<multi_fft_vars<T>> spectra(tasks);   // Plans are created here, only execution is thread safe
+	std::vector<fft_vars<T>> fftV(workers);   // Split-window retries, one channel at a time
+	std::vector<half_cache<T>> halves(cached ? tasks : 0);
+	for (int t = 0; t < tasks; t++) {
+		int first = t * group;
+		spectra[t] = SetupMultiFFT(hist, first, std::min(group, channels - first), mtIndeces);
+		if (cached) { halves[t] = SetupHalfCache(hist, first, spectra[t].count); }
+	}
+	for (int k = 0; k < workers; k++) {
+		fftV[k] = SetupFFT<T>();
 	}
+	SavePlanRegistry();   // Keep rigorous plans for the next start
+	sparse_bank bank;
+	if (sparse) { SetupSparseBank(bank, mtIndeces, N, channels); }
 	
-	fftw_execute(vars.p); // Repeatable
+	bool streaming = (hist.hop < N);
+	int hopsPerWindow = (N + hist.hop - 1) / hist.hop;
+	int keep = streaming ? hopsPerWindow + 1 : S;   // Direction compares windows N apart
 	
-	// Obtain absolute, normalised FFT
-	vars.absFFT[0] = vars.out[0][0] / n;
-	for (int j = 1; j < (n/ 2 - 1); j++) {
-		vars.absFFT[j] = 2 * sqrt(pow(vars.out[j][0], 2) + pow(vars.out[j][1], 2)) / n;
-	}
-
-	// Obtain noise levels
-	double totalNoise = 0;
-	for (int j = mtIndeces.noiseIndexLowMin; j < mtIndeces.noiseIndexLowMax; j++) {
-		totalNoise += vars.absFFT[j];
-	}
-	for (int j = mtIndeces.noiseIndexHighMin; j < mtIndeces.noiseIndexHighMax; j++) {
-		totalNoise += vars.absFFT[j];
-	}
-	fftAnal.noiseThresh = totalNoise / ((mtIndeces.noiseIndexLowMax - mtIndeces.noiseIndexLowMin) + 
-		(mtIndeces.noiseIndexHighMax - mtIndeces.noiseIndexHighMin));
-
-	// Obtain BoI (Bands of Interest) levels
-	double totalVol[BANDS] = { 0 };
-
-	for (int j = 0; j < BANDS; j++) {
-		for (int k = mtIndeces.bandIndeces[j]; k < mtIndeces.bandIndeces[j + 1]; k++) {
-			totalVol[j] += vars.absFFT[k];
+	arena mem;   // Everything the loop keeps between windows, reserved once
+	SetupArena(mem, AnalysisRingBytes(keep, channels));
+	analysis_ring anals;
+	SetupAnalysisRing(anals, keep, channels, mem);
+	
+	int evPresent = 0;
+	fft_analysis chAnals[MAX_CH];
+	int detectedBands[MAX_CH][2][BANDS];
+	int detections[MAX_CH];
+	int loc = -1;   // Located channel
+	direction dir = no_dir;
+	int cycles = (MAX_CYCLES + 1) * hopsPerWindow; // # of hops since last detection. init to prevent dir being run on first det
+	double sampled = 0;   // # of samples and seconds the rate is measured over
+	double sampledTime = 0;
+	int s = 0;   // Which of the two detectedBands rows this window fills
+	net_window netWin;   // Reused, it holds every channel's analysis
+	netWin.node = net ? net->node : 0;
+	netWin.channels = channels;
+	
+	// Detection on each task's channels, in parallel. Task state is per task, scratch per worker k.
+	// Made once, building a std::function per window would allocate
+	worker_job analyse = [&](const int &k, const int &t) {
+		metric_time stage = MetricNow();
+		if (sparse) {
+			SlideHop(bank, hist, spectra[t].first, spectra[t].count);
+		} else if (cached) {
+			CacheHalves(halves[t], hist);   // Only the halves that completed, the parent and split windows are sums of them
+		} else {
+			MultiFFT(spectra[t], hist, 0);
+		}
+		ObserveStage(STAGE_FFT, stage);
+		
+		for (int ch = spectra[t].first; ch < spectra[t].first + spectra[t].count; ch++) {
+			stage = MetricNow();
+			if (sparse) {
+				chAnals[ch] = AnalyseSpectrum(SparseRow(bank, ch), mtIndeces);
+			} else if (cached) {
+				chAnals[ch] = HalfWindowAnalysis(halves[t], ch, 0, mtIndeces);
+			} else {
+				chAnals[ch] = SpectrumAnalysis(spectra[t], ch, mtIndeces);
+			}
+			detections[ch] = Detect(chAnals[ch], detectedBands[ch][s]);
+			ObserveStage(STAGE_DETECT, stage);
+			
+			if (((detections[ch] > 0) && (detections[ch] <= (BANDS / 2))) && !streaming && WindowReady(hist, N/2)) { 
+				stage = MetricNow();
+				if (cached) {
+					SplitWindowDetection(mtIndeces, detections[ch], halves[t], ch, chAnals[ch]);
+				} else {
+					SplitWindowDetection(mtIndeces, detections[ch], hist, ch, chAnals[ch], fftV[k]); 
+				}
+				ObserveStage(STAGE_SPLIT, stage);
+				CountMetric(COUNT_SPLITS);
+			} 
+		}
+	};
+	bool armed = false;
+	
+	for (unsigned long w = 0; ; w++) {
+		window_slot *cur = AcquireReadSlot(ring, w);
+		if (cur == NULL) { break; }
+		s = w % 2;
+		double blockEnd = (cur->seq + 1) * (double)ring.n / rate;   // Simulated time, for scoring
+		
+		LOG(LOG_DEBUG, "The sampling window of %d samples was %f seconds \n", ring.n, cur->timeSpan);
+		if (cur->jitterMax > 0) {
+			LOG(LOG_DEBUG, "Sample jitter mean %.1fus, max %.1fus \n", cur->jitterMean, cur->jitterMax);
+		}
+		RecordLatency(metrics.stages[STAGE_SAMPLING], (uint64_t)(cur->timeSpan * 1e9));
+		if (cur->overruns > 0) {
+			CountMetric(COUNT_OVERRUNS, cur->overruns);
+			LOG(LOG_WARN, "Overrun: %lu blocks dropped before block %lu, %lu in total \n", cur->overruns, cur->seq, ring.overruns.load());
+			ResetStftHistory(hist);   // Windows must not straddle the gap
+			if (sparse) { ResetSparseBank(bank); }
+			for (int k = 0; k < (int)halves.size(); k++) { ResetHalfCache(halves[k]); }
+			ClearAnalyses(anals);
+		}
+		
+		// Follow the measured rate once a window's worth of samples has been timed
+		sampled += ring.n;
+		sampledTime += cur->timeSpan;
+		double measured = sampled / sampledTime;
+		if ((sampled >= N) && (fabs(measured - rate) > RATE_TOLERANCE * rate)) {
+			LOG(LOG_INFO, "Measured sampling rate %.1fHz, band indeces recomputed \n", measured);
+			rate = measured;
+			mtIndeces = SetupMultiThresholding(N, DOPPLER, rate);
+			for (int t = 0; t < tasks; t++) {
+				BinRange(mtIndeces, spectra[t].lo, spectra[t].hi);
+			}
+			if (sparse) {
+				RetuneSparseBank(bank, mtIndeces);   // In place, the alloc check stays armed
+				for (int ch = 0; (ch < channels) && WindowReady(hist, 0); ch++) {
+					GoertzelBins(bank, ch, WindowPtr(hist, ch, 0));   // Reseed, appended below slides on from here
+				}
+			}
+		}
+		if (cap) { CaptureBlock(*cap, *cur); }   // Queued for the writer thread, sampling is never held up
+		AppendHop(hist, cur->frames);   // Converted and deinterleaved here, off the sampling thread
+		ReleaseReadSlots(ring, w + 1);   // Block is copied into the history
+		if (!WindowReady(hist, 0)) {
+			if (sparse) { SlideHop(bank, hist, 0, channels); }   // Sliding state must see every sample
+			continue;
+		}
+		
+		metric_time begin = MetricNow();
+		uint64_t windowEnd = net ? NetNowNs() : 0;   // The latest block is in, for the aggregator
+		
+		RunOnPoolStealing(pool, tasks, analyse);
+		
+		// Join in channel order
+		for (int ch = 0; ch < channels; ch++) {
+			PrintAnalysis(chAnals[ch], ch, "Channel");
+			PrintDetection(detectedBands[ch][s]);
+			
+			// TESTING ONLY
+			//FftPrint("mcp3008test.txt", fftV[0].absFFT, (double)fs / (double)n);   // After AnalyseWindowReference
+			
+			LOG(LOG_DEBUG, "Siren was detected in %d out of %d bands \n", detections[ch], BANDS);
+			
+			evPresent += (detections[ch] > (BANDS / 2) );   // Detection verdict - only one channel needs to detect
+		}
+		PushAnalyses(anals, chAnals);   // Overwrites the oldest once keep windows are held
+		
+		if (score) { ScoreWindow(*score, blockEnd - N / rate, blockEnd, evPresent > 0); }
+		
+		// Direction, Location, UI
+		CountMetric(COUNT_WINDOWS);
+		bool detected = (evPresent > 0);
+		if (evPresent) {				
+			CountMetric(COUNT_DETECTIONS);
+			metric_time stage = MetricNow();
+			loc = Location(anals, array);
+			if ((cycles == 0) && (anals.count == keep)) { dir = Direction(anals, keep - 1, loc); } // Only run direction on two consecutive detections
+			cycles = 0;   // 0 hops since last detection
+			evPresent = 0;
+			ObserveStage(STAGE_LOCATION, stage);
+		} else {
+			cycles++;
+			dir = no_dir;
+		}		
+			
+		metric_time stage = MetricNow();
+		update_display(cycles / hopsPerWindow, MicLocation(array, loc), dir);
+		ObserveStage(STAGE_DISPLAY, stage);
+		
+		if (net) {   // Queued for the aggregator, sent at once on a detection
+			netWin.window = w;
+			netWin.endNs = windowEnd;
+			netWin.detected = detected;
+			netWin.dir = dir;
+			netWin.loc = detected ? loc : -1;
+			netWin.bearing = (netWin.loc < 0) ? 0 : array.mics[loc].bearing;
+			netWin.detecting = 0;
+			for (int ch = 0; ch < channels; ch++) {
+				netWin.detecting |= (detections[ch] > (BANDS / 2)) << ch;
+				netWin.chAnals[ch] = chAnals[ch];
+			}
+			SendWindow(*net, netWin);
+		}
+					
+		ObserveStage(STAGE_WINDOW, begin);
+		LOG(LOG_DEBUG, "Algorithms took %.1fms \n \n", std::chrono::duration<double, std::milli>(MetricNow() - begin).count());
+		
+		if (allocCheck && !armed) {   // Everything is set up once a whole window has been through
+			ArmAllocCheck();
+			RunOnPool(pool, workers, [](const int &, const int &) { ArmAllocCheck(); });
+			armed = true;
 		}
-		fftAnal.bandAvgs[j] = totalVol[j] / mtIndeces.bandLength / fftAnal.noiseThresh;
-	}
-
-	// Print for testing
-	printf("Window %d: The noise threshold is %f, and the band averages are", i, fftAnal.noiseThresh);
-	for (int j = 0; j < BANDS; j++) {
-		printf(" %.2f ", fftAnal.bandAvgs[j]);
 	}
-	printf("\n");
-
-	return fftAnal;
-}
-
-/* Runs the detection algorithm on the parameter fft-analysis
- * \param[in] fftAnal The FFT-analysis
- * \param[in] detectedBands[BANDS] The array to hold the detection results
- * \return The number of bands that detected an EV.
- */
-int Detect(const fft_analysis &fftAnal, int (&detectedBands)[BANDS]) 
-{
-	int detections = 0;
-
-	for (int i = 0; i < BANDS; i++) {
-		detectedBands[i] = (fftAnal.bandAvgs[i] >= NOISE_COEFF[i]);
-		detections += detectedBands[i];
+	DisarmAllocCheck();
+	
+	FreeWorkerPool(pool);
+	for (int t = 0; t < tasks; t++) {
+		FreeMultiFFT(spectra[t]);
+		if (cached) { FreeHalfCache(halves[t]); }
 	}
-
-	//printf("The siren is present in %d out of %d bands, and they are:", detections, BANDS);
-
-	for (int j = 0; j < BANDS; j++)	{
-		printf(" %d ", detectedBands[j]);
+	for (int k = 0; k < workers; k++) {
+		FreeFFT(fftV[k]);
 	}
-	printf("\n");
-	
-	return detections;
+	if (sparse) { FreeSparseBank(bank); }
+	FreeStftHistory(hist);
+	FreeArena(mem);
 }
 
-// Re-evaluate siren presence by merging consecutive half-windows when inconclusive
-// number of bands are detected
-void SplitWindowDetection(multi_thresh_indeces mtIndeces, int &detections, double *in[S][N_CH], double *inRev, fft_analysis &fftAnal, fft_vars &fftV, int &s, int &ch) 
+window_ring ring;
+
+void StopHandler(int)
 {
-	int detectionsRev = 0;
-	int detectedBandsRev[BANDS];
-	fft_analysis fftAnalRev;
-	
-	// Create new window consisting of latter half of previous window 
-	// and first half of current window
-	for (int j = N/2; j < N; j++) {
-		inRev[j-(N/2)] = in[!s][ch][j];
-	}
-	for (int j = 0; j < N/2; j++) {
-		inRev[j+(N/2)] = in[!s][ch][j];
-	}
-	
-	// Analyse new window and replace results if better detection
-	fftAnalRev = DoFFT(fftV, inRev, mtIndeces, false, 0);
-	detectionsRev = Detect(fftAnalRev, detectedBandsRev);
-	if (detectionsRev > detections) {
-		detections = detectionsRev;
-		fftAnal = fftAnalRev; 
-	}
+	ring.running = false;
 }
 
-/* Runs the direction analysis, comparing two consecutive windows
- * \param[in] fftAnalPrev The FFT-analysis for the first window
- * \param[in] fftAnalCur The FFT-analysis for the second window
- * \param[in] detectedBands[2][BANDS] The two detection results
- */
-direction Direction(const std::array<std::list<fft_analysis>, N_CH> fftAnals, location loc) 
+int main(int argc, char *argv[]) 
 {
-	double relAvg = 0;
-	
-	int s = 0;
-	double windowAvgs[S] = { 0 };   // l <= S
-	for (fft_analysis l : fftAnals[(int)loc % N_CH]) {
-		for (int j = 0; j < BANDS; j++) {
-			windowAvgs[s] += l.bandAvgs[j] * (l.bandAvgs[j] >= NOISE_COEFF[j]);
+	adc_backend backend = ADC_BCM2835;
+	int hop = N;   // # of samples between analysed windows
+	int workers = (int)std::thread::hardware_concurrency();
+	int group = 0;   // Channels per task, 0 to fit the workers
+	int channels = N_CH;
+	const char *arrayFile = NULL;
+	bool sparse = false;   // Sliding DFT over the multithresholding bins only
+	bool cached = false;   // Windows combined from half-window spectra
+	unsigned planner = FFTW_ESTIMATE;
+	const char *wisdomFile = WISDOM_FILE;
+	bool single = false;   // Single precision history and FFTs
+	bool mock = false;   // Real sampling loop, mock SPI
+	double rate = fs;   // Target sampling rate
+	double hopMs = 0;   // 0 for a whole window
+	const char *captureFile = NULL;
+	const char *replayFile = NULL;
+	double speed = 0;   // Replay pace, 0 for as fast as analysis allows
+	siren_scene scene = DefaultScene(SIREN_WAIL, fs);
+	double hours = 1;   // Simulated time of a generated scene
+	log_level level = LOG_INFO;
+	const char *metricsAddress = NULL;   // No endpoint
+	const char *netAddress = NULL;   // No aggregator
+	uint32_t node = 0;
+	double netFlush = NET_FLUSH;
+	for (int i = 1; i < argc; i++) {
+		std::string arg = argv[i];
+		if (arg == "--sim") {
+			backend = ADC_SIM;   // Simulated ADC, no Pi required
+		} else if ((arg == "--adc") && (i + 1 < argc)) {
+			backend = AdcBackend(argv[++i]);
+		} else if ((arg == "--hop") && (i + 1 < argc)) {
+			hopMs = atof(argv[++i]);
+		} else if ((arg == "--workers") && (i + 1 < argc)) {
+			workers = atoi(argv[++i]);
+		} else if (arg == "--sdft") {
+			sparse = true;
+		} else if (arg == "--half-cache") {
+			cached = true;
+		} else if ((arg == "--plan") && (i + 1 < argc)) {
+			planner = PlannerFlags(argv[++i]);
+		} else if ((arg == "--wisdom") && (i + 1 < argc)) {
+			wisdomFile = argv[++i];
+		} else if (arg == "--float") {
+			single = true;
+		} else if (arg == "--mock-spi") {
+			mock = true;
+		} else if ((arg == "--rate") && (i + 1 < argc)) {
+			rate = atof(argv[++i]);
+		} else if ((arg == "--capture") && (i + 1 < argc)) {
+			captureFile = argv[++i];
+		} else if ((arg == "--replay") && (i + 1 < argc)) {
+			replayFile = argv[++i];
+			backend = ADC_REPLAY;
+		} else if ((arg == "--speed") && (i + 1 < argc)) {
+			speed = atof(argv[++i]);
+		} else if ((arg == "--synth") && (i + 1 < argc)) {
+			siren_scene pattern = DefaultScene(SirenPattern(argv[++i]), fs);
+			scene.pattern = pattern.pattern;
+			scene.fMin = pattern.fMin;
+			scene.fMax = pattern.fMax;
+			scene.period = pattern.period;
+			backend = ADC_SYNTH;
+		} else if ((arg == "--snr") && (i + 1 < argc)) {
+			scene.snr = atof(argv[++i]);
+		} else if ((arg == "--doppler") && (i + 1 < argc)) {
+			scene.speed = atof(argv[++i]);
+		} else if ((arg == "--hours") && (i + 1 < argc)) {
+			hours = atof(argv[++i]);
+		} else if ((arg == "--seed") && (i + 1 < argc)) {
+			scene.seed = atoll(argv[++i]);
+		} else if ((arg == "--log") && (i + 1 < argc)) {
+			level = LogLevel(argv[++i]);
+		} else if ((arg == "--metrics") && (i + 1 < argc)) {
+			metricsAddress = argv[++i];
+		} else if (arg == "--alloc-check") {
+			allocCheck = true;
+		} else if ((arg == "--channels") && (i + 1 < argc)) {
+			channels = atoi(argv[++i]);
+		} else if ((arg == "--array") && (i + 1 < argc)) {
+			arrayFile = argv[++i];
+		} else if ((arg == "--group") && (i + 1 < argc)) {
+			group = atoi(argv[++i]);
+		} else if ((arg == "--net") && (i + 1 < argc)) {
+			netAddress = argv[++i];
+		} else if ((arg == "--node") && (i + 1 < argc)) {
+			node = strtoul(argv[++i], NULL, 10);
+		} else if ((arg == "--net-flush") && (i + 1 < argc)) {
+			netFlush = atof(argv[++i]);
 		}
-		windowAvgs[s] = windowAvgs[s] / BANDS;
-		s++;
 	}
+	SetupLog(level, stdout);   // The analysis loop only queues records from here on
+	mic_array array = arrayFile ? LoadMicArray(arrayFile) : DefaultMicArray(channels);
+	channels = array.count;
 	
-	for (int s = 1; s < fftAnals[0].size(); s++) {
-		relAvg += windowAvgs[s] / windowAvgs[s - 1];
-	}
-	
-	if (relAvg > (1 + DIR_MARGIN)) {
-		printf("Detected EV is approaching at %f. \n", relAvg);
-		return approaching;
-	}
-	else if (relAvg < (1 - DIR_MARGIN)) {
-		printf("Detected EV is moving away at %f. \n", relAvg);
-		return receding;
-	}
-	else {
-		printf("Detected direction is inconclusive at %f. \n", relAvg);
-		return no_dir;
-	}
-} 
-
-location Location(std::array<std::list<fft_analysis>, N_CH> fftAnals, const int (&detectedBands)[N_CH][2][BANDS]) 
-{
-	double windowAvgs[N_CH] = { 0 };
-	for (int ch = 0; ch < N_CH; ch++) {
-		for (int j = 0; j < BANDS; j++) {
-			windowAvgs[ch] += (fftAnals[ch].back().bandAvgs[j]); 
+	adc_source src;
+	if (backend == ADC_REPLAY) {
+		OpenReplay(src.replay, replayFile, speed);
+		if (src.replay.header.channels != (uint32_t)channels) {
+			printf("The capture has %u channels, %d are analysed \n", src.replay.header.channels, channels);
+			exit(1);
 		}
-		windowAvgs[ch] = windowAvgs[ch] / BANDS;
+		rate = src.replay.header.fs;
 	}
 	
-	location loc = (location)0;
-
-	double maxAvg = windowAvgs[0];
-	for (int ch = 1; ch < N_CH; ch++) {
-		if (windowAvgs[ch] > maxAvg) {
-			maxAvg = windowAvgs[ch];
-			loc = (location)ch;
-		} 		
+	if (hopMs > 0) { hop = std::min(std::max((int)(hopMs * rate / 1000) & ~1, 2), N); }   // Even keeps windows SIMD-aligned
+	if ((backend == ADC_SIM) || (backend == ADC_REPLAY) || (backend == ADC_SYNTH) || mock) { bcm2835_set_debug(1); }   // Log SPI/GPIO calls instead of accessing hardware
+	if (!bcm2835_init())
+	{
+		printf("bcm2835 initialisation failed \n");
+		exit(1);
 	}
+	initialize_display_pins();
 	
-	// If the indicated location and the opposite side are within LOC_MARGIN % of each other,
-	// a wall might be present. Conclude that location can't be determined confidently
-	if (maxAvg < (1+LOC_MARGIN) * windowAvgs[((int)loc + 2) % N_CH]) {
-		loc = no_loc;
+	multi_thresh_indeces mtIndeces = SetupMultiThresholding(N, DOPPLER, rate);
+	SetupPlanRegistry(planner, wisdomFile);
+	workers = std::min(std::max(workers, 1), channels);
+	if (group <= 0) { group = std::max(channels / (2 * workers), 1); }   // Two tasks a worker, so there is something to steal
+	group = std::min(group, channels);
+	if (sparse && (hop > N/2)) {
+		printf("--sdft needs a hop of at most half a window \n");
+		exit(1);
+	}
+	if (cached && (sparse || (hop % (N/2) != 0))) {
+		printf("--half-cache needs a hop of half or a whole window, and no --sdft \n");
+		exit(1);
 	}
-		
-		
-	printf("The EV was detected in direction %d. \n", loc);
 	
-	return loc;
-}
-
-int main() 
-{
-	SpiSetup();
-	initialize_display_pins();
+	SetupWindowRing(ring, hop, channels, RING_WINDOWS * ((N + hop - 1) / hop));
+	SetupAdcSource(src, backend, mock, rate, hop, array);
+	printf("Sampling %d channels at %.0fHz through %s%s, %d per task on %d workers \n", channels, rate, AdcBackendName(backend), mock ? " (mock SPI)" : "", group, workers);
+	if (arrayFile) { PrintMicArray(array); }
+	capture_writer cap;
+	if (captureFile) { OpenCapture(cap, captureFile, rate, hop, channels); }
+	detection_score score;
+	if (backend == ADC_SYNTH) {
+		SetupSirenGen(src.synth, scene, rate, channels);
+		src.synthEnd = (long)(hours * 3600 * rate);
+		SetupScore(score, scene, hours * 3600);
+	}
+	SetupMetrics(metricsAddress, hop / rate);   // Served from its own thread, the pipeline only adds to atomics
+	net_sender net;
+	if (netAddress) { OpenNetSender(net, netAddress, node, netFlush); }
+	signal(SIGINT, StopHandler);
 	
-	multi_thresh_indeces mtIndeces = SetupMultiThresholding(N, DOPPLER);
-
-	fft_vars fftV = SetupFFT();
+	auto begin = std::chrono::steady_clock::now();
+	std::thread sampler(SamplingThread, std::ref(ring), std::ref(src));
+	std::thread analyser(single ? AnalysisThread<float> : AnalysisThread<double>, std::ref(ring), mtIndeces, std::cref(array), workers, group, sparse, cached, rate, captureFile ? &cap : NULL, (backend == ADC_SYNTH) ? &score : NULL, netAddress ? &net : NULL);
+	sampler.join();
+	analyser.join();
 	
-	double timeSpan; // Actual sampling time
-	bool firstRunFlag = true; // Prevent 'empty' array from being used
-	int evPresent = 0;
-	double *in[2][N_CH]; // Store 2 consecutive sampling windows at a time for each channel
-	double *inRev;
-	for (int s = 0; s < 2; s++) {
-		for (int ch = 0; ch < N_CH; ch++) {
-			in[s][ch] = (double*)malloc(sizeof(double) * N);
-			in[s][ch] = (double*)malloc(sizeof(double) * N);
-		}
+	if (backend == ADC_REPLAY) {
+		double elapsed = std::chrono::duration<double>(std::chrono::steady_clock::now() - begin).count();
+		printf("Replayed %.1fs of audio in %.1fs, %.1fx real time \n", src.replay.played, elapsed, src.replay.played / elapsed);
 	}
-	inRev = (double*)malloc(sizeof(double) * N);
-	std::array<std::list<fft_analysis>, N_CH> fftAnals;
-	//fft_analysis fftAnal[S][N_CH];
-	int detectedBands[N_CH][2][BANDS];
-	int detections[N_CH];
-	location loc;
-	direction dir = no_dir;
-	int cycles = MAX_CYCLES + 1; // # of sampling windows since last detection. init to prevent dir being run on first det
-	//std::string exit;
-	
-	while (1) {
-		
-		for (int s = 0; s < 2; s++) {
-			timeSpan = DoSampling(in[s]);		
-			printf("The sampling window of %d samples was %f seconds \n", N, timeSpan);
-			
-			auto begin = std::chrono::high_resolution_clock::now();   // Testing only
-			
-			// Detection on each channel
-			for (int ch = 0; ch < N_CH; ch++) {
-				printf("Channel %d: ", ch); 
-				
-				fftAnals[ch].push_back(DoFFT(fftV, in[s][ch], mtIndeces, false, 0));
-				detections[ch] = Detect(fftAnals[ch].back(), detectedBands[ch][s]);
-				
-				// TESTING ONLY
-				//FftPrint("mcp3008test.txt", fftV.absFFT, (double)fs / (double)n);
-				
-				if (((detections[ch] > 0) && (detections[ch] <= (BANDS / 2))) && (!firstRunFlag)) { 
-					SplitWindowDetection(mtIndeces, detections[ch], in, inRev, fftAnals[ch].back(), fftV, s, ch); 
-				} 
-				
-				printf("Siren was detected in %d out of %d bands \n", detections[ch], BANDS);
-				
-				evPresent += (detections[ch] > (BANDS / 2) );   // Detection verdict - only one channel needs to detect
-				
-				if (fftAnals[ch].size() > S) { fftAnals[ch].pop_front(); }	// Maintain list to specified length
-				
-				firstRunFlag = false;
-			}
-			
-			// Direction, Location, UI
-			if (evPresent) {				
-				loc = Location(fftAnals, detectedBands);
-				if (cycles == 0) { dir = Direction(fftAnals, loc); } // Only run direction on two consecutive detections
-				cycles = 0;   // 0 windows since last detection
-				evPresent = 0;
-			} else {
-				cycles++;
-				dir = no_dir;
-			}		
-				
-			update_display(cycles, loc, dir);
-						
-			auto end = std::chrono::high_resolution_clock::now();
-			double tim = std::chrono::duration_cast<std::chrono::milliseconds>(end-begin).count();
-			printf("Algorithms took %.1fms \n \n", tim);
-		}
+	if (backend == ADC_SYNTH) {
+		struct timespec cpu;
+		clock_gettime(CLOCK_PROCESS_CPUTIME_ID, &cpu);
+		score.cpu = cpu.tv_sec + cpu.tv_nsec / 1e9 - src.cpu;   // Everything but generating the scene
+		PrintScore(score);
 	}
 	
 	// Free resources
-	for (int s = 0; s < 2; s++) {
-		for (int ch = 0; ch < N_CH; ch++) {
-			free(in[s][ch]);
-		}
+	CloseMetrics();
+	if (captureFile) { CloseCapture(cap); }
+	if (netAddress) {
+		CloseNetSender(net);
+		printf("Sent %lu datagrams to the aggregator, %lu dropped \n", net.sent, net.dropped);
 	}
-	free(inRev);
-	fftw_destroy_plan(fftV.p);
-	fftw_free(fftV.out);
-	free(fftV.absFFT);
+	FreeWindowRing(ring);
+	FreeAdcSource(src);
+	FreePlanRegistry();
 	
-	bcm2835_spi_end();
 	bcm2835_close();
 	
+	CloseLog();
+	if (allocCheck) {
+		printf("%lu heap allocations after initialisation \n", AllocsAfterInit());
+	}
 	printf("Program ended \n");
 		
-	return 0;
+	return (allocCheck && (AllocsAfterInit() > 0)) ? 1 : 0;
 }
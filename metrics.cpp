@@ -0,0 +1,243 @@
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <unistd.h>
+#include <poll.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <netinet/in.h>
+#include <arpa/inet.h>
+#include "metrics.h"
+
+
+pipeline_metrics metrics;
+
+static const char *STAGE_NAMES[STAGES] = {"sampling", "fft", "detect", "split", "location", "display", "window"};
+static const char *COUNTER_NAMES[COUNTERS] = {"siren_windows_total", "siren_detections_total", "siren_split_retries_total", "siren_overruns_total"};
+static const char *COUNTER_HELP[COUNTERS] = {"Windows analysed", "Windows with a siren detected on some channel",
+	"Split-window retries of inconclusive channels", "Sampled blocks dropped because analysis fell behind"};
+
+/* Bucket of a duration. Below 2 * HIST_SUB ns every ns has its own bucket,
+ * above, each power of 2 is split into HIST_SUB equal buckets.
+*/
+static int BucketIndex(const uint64_t &ns)
+{
+	if (ns < HIST_SUB) { return (int)ns; }
+	int shift = 63 - __builtin_clzll(ns) - HIST_SUB_BITS;
+	if (shift >= HIST_SHIFTS) { return HIST_BUCKETS - 1; }
+	return (shift + 1) * HIST_SUB + (int)(ns >> shift) - HIST_SUB;
+}
+
+// Smallest duration counted in a bucket, ns
+static uint64_t BucketLower(const int &b)
+{
+	if (b < HIST_SUB) { return b; }
+	int shift = b / HIST_SUB - 1;
+	return (uint64_t)(HIST_SUB + b % HIST_SUB) << shift;
+}
+
+// Width of a bucket, ns
+static uint64_t BucketWidth(const int &b)
+{
+	return (b < HIST_SUB) ? 1 : (uint64_t)1 << (b / HIST_SUB - 1);
+}
+
+void ClearHistogram(latency_histogram &hist)
+{
+	for (int b = 0; b < HIST_BUCKETS; b++) {
+		hist.counts[b].store(0, std::memory_order_relaxed);
+	}
+	hist.count = 0;
+	hist.sum = 0;
+	hist.max = 0;
+}
+
+/* Records one duration. Wait-free apart from raising the maximum, which only
+ * retries while another thread raises it concurrently.
+*/
+void RecordLatency(latency_histogram &hist, const uint64_t &ns)
+{
+	hist.counts[BucketIndex(ns)].fetch_add(1, std::memory_order_relaxed);
+	hist.count.fetch_add(1, std::memory_order_relaxed);
+	hist.sum.fetch_add(ns, std::memory_order_relaxed);
+	uint64_t max = hist.max.load(std::memory_order_relaxed);
+	while ((ns > max) && !hist.max.compare_exchange_weak(max, ns, std::memory_order_relaxed)) {}
+}
+
+/* # of recorded durations below a bound, exact when the bound is a bucket
+ * boundary, e.g. a power of 2 of at least HIST_SUB
+ * \param[in] ns The bound, ns
+*/
+uint64_t HistogramBelow(const latency_histogram &hist, const uint64_t &ns)
+{
+	uint64_t below = 0;
+	for (int b = 0; (b < HIST_BUCKETS) && (BucketLower(b) + BucketWidth(b) <= ns); b++) {
+		below += hist.counts[b].load(std::memory_order_relaxed);
+	}
+	return below;
+}
+
+/* Percentile of the recorded durations, the middle of the bucket it falls in
+ * \param[in] p The percentile, 0 to 100
+ * \return The duration in ns, 0 if nothing was recorded
+*/
+double HistogramPercentile(const latency_histogram &hist, const double &p)
+{
+	uint64_t total = 0;
+	for (int b = 0; b < HIST_BUCKETS; b++) {
+		total += hist.counts[b].load(std::memory_order_relaxed);
+	}
+	if (total == 0) { return 0; }
+
+	uint64_t rank = (uint64_t)(p / 100 * (total - 1)) + 1;
+	uint64_t seen = 0;
+	int b = 0;
+	for (; b < HIST_BUCKETS - 1; b++) {
+		seen += hist.counts[b].load(std::memory_order_relaxed);
+		if (seen >= rank) { break; }
+	}
+	return BucketLower(b) + (BucketWidth(b) - 1) / 2.0;
+}
+
+/* Renders every histogram and counter in the Prometheus text exposition
+ * format. Only reads the atomics, so it can run while the pipeline records.
+*/
+std::string MetricsText()
+{
+	std::string text;
+	char line[256];
+
+	text += "# HELP siren_stage_seconds Time spent per window in each pipeline stage\n";
+	text += "# TYPE siren_stage_seconds histogram\n";
+	for (int s = 0; s < STAGES; s++) {
+		const latency_histogram &hist = metrics.stages[s];
+		uint64_t counts[HIST_BUCKETS];   // One snapshot, so the buckets and count agree
+		uint64_t total = 0;
+		for (int b = 0; b < HIST_BUCKETS; b++) {
+			counts[b] = hist.counts[b].load(std::memory_order_relaxed);
+			total += counts[b];
+		}
+
+		uint64_t below = 0;
+		int b = 0;
+		for (int le = HIST_LE_MIN; le <= HIST_LE_MAX; le += 2) {
+			for (; (b < HIST_BUCKETS) && (BucketLower(b) + BucketWidth(b) <= ((uint64_t)1 << le)); b++) {
+				below += counts[b];
+			}
+			snprintf(line, sizeof(line), "siren_stage_seconds_bucket{stage=\"%s\",le=\"%.9g\"} %llu\n", STAGE_NAMES[s], ((uint64_t)1 << le) / 1e9, (unsigned long long)below);
+			text += line;
+		}
+		snprintf(line, sizeof(line), "siren_stage_seconds_bucket{stage=\"%s\",le=\"+Inf\"} %llu\n", STAGE_NAMES[s], (unsigned long long)total);
+		text += line;
+		snprintf(line, sizeof(line), "siren_stage_seconds_sum{stage=\"%s\"} %.9g\n", STAGE_NAMES[s], hist.sum.load(std::memory_order_relaxed) / 1e9);
+		text += line;
+		snprintf(line, sizeof(line), "siren_stage_seconds_count{stage=\"%s\"} %llu\n", STAGE_NAMES[s], (unsigned long long)total);
+		text += line;
+	}
+
+	text += "# HELP siren_stage_max_seconds Longest time spent in each pipeline stage\n";
+	text += "# TYPE siren_stage_max_seconds gauge\n";
+	for (int s = 0; s < STAGES; s++) {
+		snprintf(line, sizeof(line), "siren_stage_max_seconds{stage=\"%s\"} %.9g\n", STAGE_NAMES[s], metrics.stages[s].max.load(std::memory_order_relaxed) / 1e9);
+		text += line;
+	}
+
+	text += "# HELP siren_sampling_nominal_seconds Nominal sampling time of a block\n";
+	text += "# TYPE siren_sampling_nominal_seconds gauge\n";
+	snprintf(line, sizeof(line), "siren_sampling_nominal_seconds %.9g\n", metrics.nominal.load(std::memory_order_relaxed));
+	text += line;
+
+	for (int c = 0; c < COUNTERS; c++) {
+		snprintf(line, sizeof(line), "# HELP %s %s\n# TYPE %s counter\n%s %llu\n", COUNTER_NAMES[c], COUNTER_HELP[c], COUNTER_NAMES[c],
+			COUNTER_NAMES[c], (unsigned long long)metrics.counters[c].load(std::memory_order_relaxed));
+		text += line;
+	}
+	return text;
+}
+
+/* Endpoint thread. Answers every connection with the current metrics as an
+ * HTTP/1.0 response, whatever was requested, one connection at a time.
+*/
+static void ServeMetrics()
+{
+	while (metrics.running) {
+		struct pollfd listener = {metrics.fd, POLLIN, 0};
+		if (poll(&listener, 1, 100) <= 0) { continue; }   // Wakes up to see if the metrics were closed
+		int conn = accept(metrics.fd, NULL, NULL);
+		if (conn < 0) { continue; }
+
+		struct timeval timeout = {1, 0};   // A stalled client can't hold up the next scrape for long
+		setsockopt(conn, SOL_SOCKET, SO_RCVTIMEO, &timeout, sizeof(timeout));
+		setsockopt(conn, SOL_SOCKET, SO_SNDTIMEO, &timeout, sizeof(timeout));
+		char request[1024];
+		if (recv(conn, request, sizeof(request), 0) > 0) {
+			std::string body = MetricsText();
+			char header[128];
+			int len = snprintf(header, sizeof(header), "HTTP/1.0 200 OK\r\nContent-Type: text/plain; version=0.0.4\r\nContent-Length: %zu\r\n\r\n", body.size());
+			send(conn, header, len, MSG_NOSIGNAL);
+			send(conn, body.data(), body.size(), MSG_NOSIGNAL);
+		}
+		close(conn);
+	}
+}
+
+/* Clears the histograms and counters and, given an address, starts serving
+ * them. Recording works either way.
+ * \param[in] address A Unix socket path (anything with a '/'), a port on
+ * 127.0.0.1, or NULL for no endpoint
+ * \param[in] nominal The nominal sampling time of a block, s
+*/
+void SetupMetrics(const char *address, const double &nominal)
+{
+	for (int s = 0; s < STAGES; s++) {
+		ClearHistogram(metrics.stages[s]);
+	}
+	for (int c = 0; c < COUNTERS; c++) {
+		metrics.counters[c] = 0;
+	}
+	metrics.nominal = nominal;
+	metrics.fd = -1;
+	metrics.running = false;
+	if (address == NULL) { return; }
+
+	metrics.address = address;
+	bool local = (strchr(address, '/') != NULL);
+	int bound;
+	if (local) {
+		struct sockaddr_un addr;
+		memset(&addr, 0, sizeof(addr));
+		addr.sun_family = AF_UNIX;
+		strncpy(addr.sun_path, address, sizeof(addr.sun_path) - 1);
+		unlink(address);   // Left behind by a previous run
+		metrics.fd = socket(AF_UNIX, SOCK_STREAM, 0);
+		bound = bind(metrics.fd, (struct sockaddr*)&addr, sizeof(addr));
+	} else {
+		struct sockaddr_in addr;
+		memset(&addr, 0, sizeof(addr));
+		addr.sin_family = AF_INET;
+		addr.sin_port = htons(atoi(address));
+		addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);   // Scraped locally, or through a proxy
+		metrics.fd = socket(AF_INET, SOCK_STREAM, 0);
+		int on = 1;
+		setsockopt(metrics.fd, SOL_SOCKET, SO_REUSEADDR, &on, sizeof(on));
+		bound = bind(metrics.fd, (struct sockaddr*)&addr, sizeof(addr));
+	}
+	if ((metrics.fd < 0) || (bound != 0) || (listen(metrics.fd, 4) != 0)) {
+		printf("Not able to serve metrics on %s \n", address);
+		exit(1);
+	}
+
+	metrics.running = true;
+	metrics.server = std::thread(ServeMetrics);
+	printf("Serving metrics on %s%s \n", local ? "" : "127.0.0.1:", address);
+}
+
+void CloseMetrics()
+{
+	if (metrics.fd < 0) { return; }
+	metrics.running = false;
+	metrics.server.join();
+	close(metrics.fd);
+	if (strchr(metrics.address.c_str(), '/') != NULL) { unlink(metrics.address.c_str()); }
+	metrics.fd = -1;
+}
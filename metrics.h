@@ -0,0 +1,91 @@
+#ifndef METRICS_H
+#define METRICS_H
+
+#include <atomic>
+#include <chrono>
+#include <string>
+#include <thread>
+#include <stdint.h>
+
+const int HIST_SUB_BITS = 4;   // 16 sub-buckets per power of 2, within 6.25% of the true value
+const int HIST_SUB = 1 << HIST_SUB_BITS;
+const int HIST_SHIFTS = 41;   // Up to 2^45ns, about 10 hours, longer is counted in the last bucket
+const int HIST_BUCKETS = (HIST_SHIFTS + 1) * HIST_SUB;
+const int HIST_LE_MIN = 10;   // Exported bucket bounds are 2^10ns (~1us) .. 2^36ns (~69s), every 2nd power of 2
+const int HIST_LE_MAX = 36;
+
+enum metric_stage {
+	STAGE_SAMPLING,   // Sampling time of a block, against its nominal time
+	STAGE_FFT,   // Transforms of one worker's channels, or its sliding DFT update
+	STAGE_DETECT,   // Spectrum analysis and detection of one channel
+	STAGE_SPLIT,   // Split-window retry of one channel
+	STAGE_LOCATION,   // Location and direction
+	STAGE_DISPLAY,
+	STAGE_WINDOW,   // Everything after the history is updated, until the display is
+	STAGES
+};
+
+enum metric_counter {
+	COUNT_WINDOWS,   // Windows analysed
+	COUNT_DETECTIONS,   // Windows with a siren on some channel
+	COUNT_SPLITS,   // Split-window retries
+	COUNT_OVERRUNS,   // Blocks dropped because analysis fell behind
+	COUNTERS
+};
+
+/* Log-linear histogram of durations in ns, in the manner of HdrHistogram:
+ * fixed memory, constant-time updates and a bounded relative error. Updates
+ * are relaxed atomic adds, so any thread may record while the endpoint reads.
+*/
+struct latency_histogram {
+	std::atomic<uint64_t> counts[HIST_BUCKETS];
+	std::atomic<uint64_t> count;
+	std::atomic<uint64_t> sum;   // ns
+	std::atomic<uint64_t> max;   // ns
+};
+
+struct pipeline_metrics {
+	latency_histogram stages[STAGES];
+	std::atomic<uint64_t> counters[COUNTERS];
+	std::atomic<double> nominal;   // Nominal sampling time of a block, s
+	std::string address;   // Unix socket path, or localhost port
+	int fd;   // Listening socket, -1 without an endpoint
+	std::atomic<bool> running;
+	std::thread server;
+};
+
+extern pipeline_metrics metrics;
+
+typedef std::chrono::steady_clock::time_point metric_time;
+
+inline metric_time MetricNow()
+{
+	return std::chrono::steady_clock::now();
+}
+
+void ClearHistogram(latency_histogram &hist);
+
+void RecordLatency(latency_histogram &hist, const uint64_t &ns);
+
+// Records the time since begin against a stage
+inline void ObserveStage(const metric_stage &stage, const metric_time &begin)
+{
+	RecordLatency(metrics.stages[stage], std::chrono::duration_cast<std::chrono::nanoseconds>(MetricNow() - begin).count());
+}
+
+inline void CountMetric(const metric_counter &counter, const uint64_t &n = 1)
+{
+	metrics.counters[counter].fetch_add(n, std::memory_order_relaxed);
+}
+
+uint64_t HistogramBelow(const latency_histogram &hist, const uint64_t &ns);
+
+double HistogramPercentile(const latency_histogram &hist, const double &p);
+
+void SetupMetrics(const char *address, const double &nominal);
+
+void CloseMetrics();
+
+std::string MetricsText();
+
+#endif
@@ -0,0 +1,124 @@
+#include <cstdio>
+#include <cstdlib>
+#include <math.h>
+#include "micarray.h"
+
+
+// Angle between two bearings, 0 to 180 degrees
+static double BearingGap(const double &a, const double &b)
+{
+	double gap = fmod(fabs(a - b), 360);
+	return (gap > 180) ? 360 - gap : gap;
+}
+
+// Pairs every channel with the one whose bearing is closest to its back
+static void FindOpposites(mic_array &array)
+{
+	for (int ch = 0; ch < array.count; ch++) {
+		array.opposite[ch] = ch;
+		double best = -1;
+		for (int other = 0; other < array.count; other++) {
+			double gap = BearingGap(array.mics[ch].bearing, array.mics[other].bearing);
+			if ((other != ch) && (gap > best)) {
+				best = gap;
+				array.opposite[ch] = other;
+			}
+		}
+	}
+}
+
+/* count microphones evenly around the array, on ADC inputs in order, the
+ * first MCP_INPUTS on CS0 and the rest on CS1. Four are east, north, west
+ * and south on inputs 0-3, as the array has always been wired.
+ * \param[in] count The # of microphones, at most MAX_CH
+*/
+mic_array DefaultMicArray(const int &count)
+{
+	if ((count < 1) || (count > MAX_CH)) {
+		printf("Between 1 and %d microphones can be sampled, not %d \n", MAX_CH, count);
+		exit(1);
+	}
+
+	mic_array array;
+	array.count = count;
+	for (int ch = 0; ch < count; ch++) {
+		array.mics[ch].select = ch / MCP_INPUTS;
+		array.mics[ch].input = ch % MCP_INPUTS;
+		array.mics[ch].bearing = 360.0 * ch / count;
+	}
+	FindOpposites(array);
+	return array;
+}
+
+/* Reads the array from a file of one "select input bearing" line per
+ * microphone, in channel order. Lines starting with '#' are comments.
+ * \param[in] fileName The array file
+*/
+mic_array LoadMicArray(const char *fileName)
+{
+	FILE *file = fopen(fileName, "r");
+	if (!file) {
+		printf("Not able to open microphone array %s \n", fileName);
+		exit(1);
+	}
+
+	mic_array array;
+	array.count = 0;
+	bool used[MCP_SELECTS][MCP_INPUTS] = {};
+	char line[256];
+	for (int l = 1; fgets(line, sizeof(line), file); l++) {
+		mic_channel mic;
+		char first[2];
+		if ((sscanf(line, " %1s", first) != 1) || (first[0] == '#')) { continue; }
+		if (sscanf(line, "%d %d %lf", &mic.select, &mic.input, &mic.bearing) != 3) {
+			printf("%s:%d: expected \"select input bearing\" \n", fileName, l);
+			exit(1);
+		}
+		if ((mic.select < 0) || (mic.select >= MCP_SELECTS) || (mic.input < 0) || (mic.input >= MCP_INPUTS)) {
+			printf("%s:%d: no input %d on CS%d \n", fileName, l, mic.input, mic.select);
+			exit(1);
+		}
+		if (used[mic.select][mic.input] || (array.count == MAX_CH)) {
+			printf("%s:%d: input %d on CS%d is taken, or more than %d microphones \n", fileName, l, mic.input, mic.select, MAX_CH);
+			exit(1);
+		}
+		used[mic.select][mic.input] = true;
+		array.mics[array.count++] = mic;
+	}
+	fclose(file);
+
+	if (array.count == 0) {
+		printf("%s lists no microphones \n", fileName);
+		exit(1);
+	}
+	FindOpposites(array);
+	return array;
+}
+
+// # of channels sampled through one chip select
+int SelectCount(const mic_array &array, const int &select)
+{
+	int count = 0;
+	for (int ch = 0; ch < array.count; ch++) {
+		count += (array.mics[ch].select == select);
+	}
+	return count;
+}
+
+/* The display direction closest to a channel's bearing
+ * \param[in] ch The channel, or -1 for no_loc
+*/
+location MicLocation(const mic_array &array, const int &ch)
+{
+	if ((ch < 0) || (ch >= array.count)) { return no_loc; }
+	double bearing = fmod(fmod(array.mics[ch].bearing, 360) + 360, 360);
+	return (location)((int)floor(bearing / 90 + 0.5) % 4);   // east, north, west, south
+}
+
+void PrintMicArray(const mic_array &array)
+{
+	for (int ch = 0; ch < array.count; ch++) {
+		printf("Channel %d: CS%d input %d, bearing %.0f, opposite channel %d \n", ch, array.mics[ch].select,
+			array.mics[ch].input, array.mics[ch].bearing, array.opposite[ch]);
+	}
+}
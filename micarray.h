@@ -0,0 +1,37 @@
+#ifndef MICARRAY_H
+#define MICARRAY_H
+
+#include "display.h"
+
+const int MAX_CH = 16;   // Two MCP3008s, on CS0 and CS1
+const int MCP_INPUTS = 8;   // Single-ended inputs per MCP3008
+const int MCP_SELECTS = 2;
+
+/* Where one microphone is wired and which way it faces
+*/
+struct mic_channel {
+	int select;   // SPI chip select of its ADC, 0 or 1
+	int input;   // ADC input, 0-7
+	double bearing;   // Degrees counterclockwise from east, as the display is laid out
+};
+
+/* The microphones analysed, in channel order, loaded at startup. Frames hold
+ * one code per channel in this order, whichever ADC it comes from.
+*/
+struct mic_array {
+	int count;
+	mic_channel mics[MAX_CH];
+	int opposite[MAX_CH];   // The channel facing furthest away from each, for the wall-echo check
+};
+
+mic_array DefaultMicArray(const int &count);
+
+mic_array LoadMicArray(const char *fileName);
+
+int SelectCount(const mic_array &array, const int &select);
+
+location MicLocation(const mic_array &array, const int &ch);
+
+void PrintMicArray(const mic_array &array);
+
+#endif
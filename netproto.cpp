@@ -0,0 +1,261 @@
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <math.h>
+#include <algorithm>
+#include <time.h>
+#include <unistd.h>
+#include <poll.h>
+#include <netdb.h>
+#include <arpa/inet.h>
+#include "netproto.h"
+
+
+static_assert(sizeof(net_header) == 24 && sizeof(net_record) == 16, "The wire layout must not be padded");
+
+// CLOCK_REALTIME, ns. Nodes and the aggregator compare these, so their clocks should be NTP-synced
+uint64_t NetNowNs()
+{
+	timespec now;
+	clock_gettime(CLOCK_REALTIME, &now);
+	return (uint64_t)now.tv_sec * 1000000000ULL + now.tv_nsec;
+}
+
+// Bytes a window of channels takes in a datagram
+int NetRecordBytes(const int &channels)
+{
+	return sizeof(net_record) + channels * (BANDS + 1) * sizeof(int16_t);
+}
+
+static int16_t LevelToWire(const double &level)
+{
+	double db = 20 * log10(std::max(level, 1e-12)) * NET_DB_SCALE;
+	return (int16_t)std::min(std::max(lround(db), (long)INT16_MIN), (long)INT16_MAX);
+}
+
+static double LevelFromWire(const int16_t &wire)
+{
+	return pow(10, wire / NET_DB_SCALE / 20);
+}
+
+/* Writes one window as a record
+ * \param[in] *dst Where to write it, after the header and earlier records
+ * \param[in] room The # of bytes left in the datagram
+ * \param[in] sentNs When the datagram goes out, for the window's age
+ * \return The # of bytes written, 0 if it doesn't fit
+*/
+int EncodeWindow(char *dst, const int &room, const net_window &win, const uint64_t &sentNs)
+{
+	int bytes = NetRecordBytes(win.channels);
+	if (bytes > room) { return 0; }
+
+	net_record rec;
+	rec.window = win.window;
+	rec.age = (uint32_t)std::min((sentNs > win.endNs ? sentNs - win.endNs : 0) / 1000, (uint64_t)UINT32_MAX);
+	rec.channels = win.channels;
+	rec.verdict = (win.detected ? NET_DETECTED : 0) | (win.dir << 1);
+	rec.loc = win.loc;
+	rec.reserved = 0;
+	rec.bearing = (win.loc < 0) ? 0 : (int16_t)lround(fmod(fmod(win.bearing, 360) + 360, 360) * 10);
+	rec.detecting = win.detecting;
+	memcpy(dst, &rec, sizeof(rec));
+
+	int16_t *levels = (int16_t*)(dst + sizeof(rec));
+	for (int ch = 0; ch < win.channels; ch++) {
+		for (int b = 0; b < BANDS; b++) {
+			levels[ch * (BANDS + 1) + b] = LevelToWire(win.chAnals[ch].bandAvgs[b]);
+		}
+		levels[ch * (BANDS + 1) + BANDS] = LevelToWire(win.chAnals[ch].noiseThresh);
+	}
+	return bytes;
+}
+
+/* Checks a datagram and decodes its windows
+ * \param[out] header The datagram's header
+ * \param[out] *windows Room for NET_MAX_RECORDS windows
+ * \return The # of windows decoded, -1 if the datagram is malformed
+*/
+int DecodeDatagram(const char *data, const int &length, net_header &header, net_window *windows)
+{
+	if (length < (int)sizeof(net_header)) { return -1; }
+	memcpy(&header, data, sizeof(header));
+	if ((header.magic != NET_MAGIC) || (header.version != NET_VERSION) || (header.records > NET_MAX_RECORDS)) { return -1; }
+
+	int offset = sizeof(header);
+	for (int r = 0; r < header.records; r++) {
+		net_record rec;
+		if (offset + (int)sizeof(rec) > length) { return -1; }
+		memcpy(&rec, data + offset, sizeof(rec));
+		if ((rec.channels < 1) || (rec.channels > MAX_CH) || (offset + NetRecordBytes(rec.channels) > length) ||
+			(rec.loc >= rec.channels) || ((rec.verdict >> 1) > no_dir)) { return -1; }
+
+		net_window &win = windows[r];
+		win.node = header.node;
+		win.window = rec.window;
+		win.endNs = header.sentNs - (uint64_t)rec.age * 1000;
+		win.channels = rec.channels;
+		win.detected = rec.verdict & NET_DETECTED;
+		win.dir = (direction)(rec.verdict >> 1);
+		win.loc = std::max((int)rec.loc, -1);
+		win.bearing = rec.bearing / 10.0;
+		win.detecting = rec.detecting;
+
+		int16_t levels[MAX_CH * (BANDS + 1)];   // Copied out, the record may not be aligned
+		memcpy(levels, data + offset + sizeof(rec), rec.channels * (BANDS + 1) * sizeof(int16_t));
+		for (int ch = 0; ch < rec.channels; ch++) {
+			for (int b = 0; b < BANDS; b++) {
+				win.chAnals[ch].bandAvgs[b] = LevelFromWire(levels[ch * (BANDS + 1) + b]);
+			}
+			win.chAnals[ch].noiseThresh = LevelFromWire(levels[ch * (BANDS + 1) + BANDS]);
+		}
+		offset += NetRecordBytes(rec.channels);
+	}
+	return header.records;
+}
+
+/* Opens a node's socket to the aggregator
+ * \param[in] address host:port, or host for NET_PORT
+ * \param[in] node This node's id, unique in the cluster
+ * \param[in] flushAfter The longest a quiet window waits to be sent, s
+*/
+void OpenNetSender(net_sender &net, const char *address, const uint32_t &node, const double &flushAfter)
+{
+	char host[256];
+	strncpy(host, address, sizeof(host) - 1);
+	host[sizeof(host) - 1] = 0;
+	char *colon = strrchr(host, ':');
+	int port = NET_PORT;
+	if (colon) {
+		*colon = 0;
+		port = atoi(colon + 1);
+	}
+
+	addrinfo hints;
+	memset(&hints, 0, sizeof(hints));
+	hints.ai_family = AF_INET;
+	hints.ai_socktype = SOCK_DGRAM;
+	addrinfo *found = NULL;
+	if ((port <= 0) || (port > 65535) || (getaddrinfo(host, NULL, &hints, &found) != 0)) {
+		printf("Not able to resolve aggregator %s \n", address);
+		exit(1);
+	}
+	memcpy(&net.to, found->ai_addr, sizeof(net.to));
+	net.to.sin_port = htons(port);
+	freeaddrinfo(found);
+
+	net.fd = socket(AF_INET, SOCK_DGRAM | SOCK_NONBLOCK, 0);
+	if ((net.fd < 0) || (connect(net.fd, (sockaddr*)&net.to, sizeof(net.to)) != 0)) {
+		printf("Not able to open a socket to aggregator %s \n", address);
+		exit(1);
+	}
+	net.node = node;
+	net.seq = 0;
+	net.used = sizeof(net_header);
+	net.records = 0;
+	net.flushAfter = (uint64_t)(flushAfter * 1e9);
+	net.sent = 0;
+	net.dropped = 0;
+	printf("Sending detections as node %u to %s:%d \n", node, inet_ntoa(net.to.sin_addr), port);
+}
+
+// Sends whatever is queued as one datagram
+void FlushNetSender(net_sender &net)
+{
+	if (net.records == 0) { return; }
+
+	net_header header;
+	header.magic = NET_MAGIC;
+	header.version = NET_VERSION;
+	header.records = net.records;
+	header.node = net.node;
+	header.seq = net.seq++;   // Counted even if dropped, so the aggregator sees the gap
+	header.sentNs = NetNowNs();
+	memcpy(net.buffer, &header, sizeof(header));
+	for (int r = 0; r < net.records; r++) {
+		net_record rec;
+		memcpy(&rec, net.buffer + net.offsets[r], sizeof(rec));
+		rec.age = (uint32_t)std::min((header.sentNs > net.ends[r] ? header.sentNs - net.ends[r] : 0) / 1000, (uint64_t)UINT32_MAX);
+		memcpy(net.buffer + net.offsets[r], &rec, sizeof(rec));
+	}
+
+	if (send(net.fd, net.buffer, net.used, MSG_DONTWAIT) == net.used) {
+		net.sent++;
+	} else {
+		net.dropped++;   // Full socket buffer, or the aggregator is down
+	}
+	net.used = sizeof(net_header);
+	net.records = 0;
+}
+
+/* Queues a window, and sends the batch if the window has a detection, the
+ * batch is full or its oldest window has waited long enough. Never allocates.
+*/
+void SendWindow(net_sender &net, const net_window &win)
+{
+	if ((net.records == NET_MAX_RECORDS) || (net.used + NetRecordBytes(win.channels) > NET_DATAGRAM)) {
+		FlushNetSender(net);
+	}
+	net.offsets[net.records] = net.used;
+	net.ends[net.records] = win.endNs;
+	net.used += EncodeWindow(net.buffer + net.used, NET_DATAGRAM - net.used, win, win.endNs);
+	net.records++;
+
+	if (win.detected || (NetNowNs() - net.ends[0] >= net.flushAfter)) {
+		FlushNetSender(net);
+	}
+}
+
+void CloseNetSender(net_sender &net)
+{
+	FlushNetSender(net);
+	close(net.fd);
+}
+
+/* Binds the aggregator's socket on every interface
+ * \param[in] port The port to listen on, 0 for any free one, then in rx.port
+*/
+void OpenNetReceiver(net_receiver &rx, const int &port)
+{
+	rx.fd = socket(AF_INET, SOCK_DGRAM, 0);
+	int size = NET_RCVBUF;
+	setsockopt(rx.fd, SOL_SOCKET, SO_RCVBUF, &size, sizeof(size));   // Capped by net.core.rmem_max
+	sockaddr_in addr;
+	memset(&addr, 0, sizeof(addr));
+	addr.sin_family = AF_INET;
+	addr.sin_port = htons(port);
+	addr.sin_addr.s_addr = htonl(INADDR_ANY);
+	socklen_t len = sizeof(addr);
+	if ((rx.fd < 0) || (bind(rx.fd, (sockaddr*)&addr, sizeof(addr)) != 0) || (getsockname(rx.fd, (sockaddr*)&addr, &len) != 0)) {
+		printf("Not able to listen for detections on port %d \n", port);
+		exit(1);
+	}
+	rx.port = ntohs(addr.sin_port);
+
+	rx.buffers = (char(*)[NET_DATAGRAM])malloc(sizeof(char) * NET_DATAGRAM * NET_RECV_BATCH);
+	memset(rx.msgs, 0, sizeof(rx.msgs));
+	for (int d = 0; d < NET_RECV_BATCH; d++) {
+		rx.iovs[d].iov_base = rx.buffers[d];
+		rx.iovs[d].iov_len = NET_DATAGRAM;
+		rx.msgs[d].msg_hdr.msg_iov = &rx.iovs[d];
+		rx.msgs[d].msg_hdr.msg_iovlen = 1;
+	}
+}
+
+/* Waits for datagrams, then takes as many as are queued, up to
+ * NET_RECV_BATCH, in one call. Datagram d is rx.buffers[d], rx.msgs[d].msg_len long.
+ * \param[in] timeoutMs The longest to wait for the first one
+ * \return The # of datagrams received, 0 on timeout
+*/
+int ReceiveDatagrams(net_receiver &rx, const int &timeoutMs)
+{
+	pollfd ready = {rx.fd, POLLIN, 0};
+	if (poll(&ready, 1, timeoutMs) <= 0) { return 0; }
+	int count = recvmmsg(rx.fd, rx.msgs, NET_RECV_BATCH, MSG_DONTWAIT, NULL);
+	return std::max(count, 0);
+}
+
+void CloseNetReceiver(net_receiver &rx)
+{
+	close(rx.fd);
+	free(rx.buffers);
+}
@@ -0,0 +1,112 @@
+#ifndef NETPROTO_H
+#define NETPROTO_H
+
+#include <stdint.h>
+#include <sys/socket.h>
+#include <netinet/in.h>
+#include "detection.h"
+
+const uint32_t NET_MAGIC = 0x4e524953;   // "SIRN" as sent
+const uint16_t NET_VERSION = 1;
+const int NET_PORT = 5515;   // Aggregator port unless given
+const int NET_DATAGRAM = 1400;   // Largest datagram sent, under a typical Ethernet MTU so it is never fragmented
+const double NET_FLUSH = 10;   // Longest a quiet window waits to be batched, s, unless given
+const double NET_DB_SCALE = 100;   // Levels are sent in 0.01dB steps
+const int NET_MAX_RECORDS = 48;   // Records per datagram, 45 single-channel records fit, 19 of 4 channels
+const int NET_RECV_BATCH = 64;   // Datagrams per recvmmsg
+const int NET_RCVBUF = 4 << 20;   // Aggregator socket buffer, bytes, rides out bursts from many nodes
+
+/* Datagram layout, all little endian as written by the Pi: a net_header,
+ * then header.records records, each a net_record followed by channels *
+ * (BANDS + 1) int16 levels, every channel's band averages then its noise
+ * threshold, in NET_DB_SCALE steps of dB. Gaps in seq are datagrams lost.
+*/
+struct net_header {
+	uint32_t magic;
+	uint16_t version;
+	uint16_t records;
+	uint32_t node;
+	uint32_t seq;   // Per node datagram #
+	uint64_t sentNs;   // CLOCK_REALTIME when sent
+};
+
+struct net_record {
+	uint32_t window;   // Per node window #
+	uint32_t age;   // us from the end of the window to sentNs
+	uint8_t channels;
+	uint8_t verdict;   // NET_DETECTED | direction << 1
+	int8_t loc;   // Located channel, -1 for none
+	uint8_t reserved;
+	int16_t bearing;   // Of the located channel in the node's frame, tenths of a degree
+	uint16_t detecting;   // Bit per channel with a siren in most bands
+};
+
+const uint8_t NET_DETECTED = 1;
+
+/* One node's verdict on one window, as sent and as decoded
+*/
+struct net_window {
+	uint32_t node;
+	uint32_t window;
+	uint64_t endNs;   // CLOCK_REALTIME at the end of the window, on the node
+	int channels;
+	bool detected;
+	direction dir;
+	int loc;
+	double bearing;   // Degrees counterclockwise from the node's east
+	uint16_t detecting;
+	fft_analysis chAnals[MAX_CH];
+};
+
+/* A node's batching sender. Windows with a detection go out at once, quiet
+ * windows wait until a datagram fills or the oldest has waited flushAfter.
+ * Sends never block, a datagram the socket can't take is dropped and counted.
+*/
+struct net_sender {
+	int fd;
+	sockaddr_in to;
+	uint32_t node;
+	uint32_t seq;
+	char buffer[NET_DATAGRAM];
+	int used;   // Bytes in buffer, the header included
+	int records;
+	uint64_t ends[NET_MAX_RECORDS];   // endNs of each queued record, ages are filled in when sent
+	int offsets[NET_MAX_RECORDS];
+	uint64_t flushAfter;   // ns
+	unsigned long sent;   // Datagrams
+	unsigned long dropped;
+};
+
+/* The aggregator's socket and the buffers one recvmmsg fills
+*/
+struct net_receiver {
+	int fd;
+	int port;
+	char (*buffers)[NET_DATAGRAM];   // [NET_RECV_BATCH]
+	mmsghdr msgs[NET_RECV_BATCH];
+	iovec iovs[NET_RECV_BATCH];
+};
+
+uint64_t NetNowNs();
+
+int NetRecordBytes(const int &channels);
+
+int EncodeWindow(char *dst, const int &room, const net_window &win, const uint64_t &sentNs);
+
+int DecodeDatagram(const char *data, const int &length, net_header &header, net_window *windows);
+
+void OpenNetSender(net_sender &net, const char *address, const uint32_t &node, const double &flushAfter);
+
+void SendWindow(net_sender &net, const net_window &win);
+
+void FlushNetSender(net_sender &net);
+
+void CloseNetSender(net_sender &net);
+
+void OpenNetReceiver(net_receiver &rx, const int &port);
+
+int ReceiveDatagrams(net_receiver &rx, const int &timeoutMs);
+
+void CloseNetReceiver(net_receiver &rx);
+
+#endif
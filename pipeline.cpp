@@ -0,0 +1,114 @@
+#include <cstdlib>
+#include <chrono>
+#include <thread>
+#include "pipeline.h"
+
+
+static void SetupSlot(window_slot &slot, const int &n, const int &channels)
+{
+	slot.frames = (uint16_t*)malloc(sizeof(uint16_t) * n * channels);
+	slot.timeSpan = 0;
+	slot.jitterMean = 0;
+	slot.jitterMax = 0;
+	slot.seq = 0;
+	slot.overruns = 0;
+}
+
+static void FreeSlot(window_slot &slot)
+{
+	free(slot.frames);
+}
+
+/* Allocates every block buffer up front, so neither thread allocates while running
+ * \param[in] n The # of samples per channel in a block
+ * \param[in] channels The # of channels sampled per block
+ * \param[in] size The # of blocks the ring holds
+*/
+void SetupWindowRing(window_ring &ring, const int &n, const int &channels, const int &size)
+{
+	ring.n = n;
+	ring.channels = channels;
+	ring.size = size;
+	ring.slots = (window_slot*)malloc(sizeof(window_slot) * size);
+	for (int i = 0; i < size; i++) {
+		SetupSlot(ring.slots[i], n, channels);
+	}
+	SetupSlot(ring.spare, n, channels);
+	ResetSpsc(ring.queue);
+	ring.overruns = 0;
+	ring.dropped = 0;
+	ring.running = true;
+}
+
+void FreeWindowRing(window_ring &ring)
+{
+	for (int i = 0; i < ring.size; i++) {
+		FreeSlot(ring.slots[i]);
+	}
+	free(ring.slots);
+	FreeSlot(ring.spare);
+}
+
+/* Producer side. Never blocks: if the consumer still holds every slot, the
+ * spare slot is returned and the block sampled into it is counted as an overrun.
+ * \return The slot to sample the next block into
+*/
+window_slot *AcquireWriteSlot(window_ring &ring)
+{
+	if (!SpscRoom(ring.queue, ring.size)) {
+		return &ring.spare;
+	}
+	return &ring.slots[SpscHead(ring.queue) % ring.size];
+}
+
+/* Producer side for sources that can wait, like a replayed capture: instead
+ * of dropping blocks, waits until the consumer has freed a slot.
+ * \return The slot to sample the next block into, or NULL if the ring was stopped first
+*/
+window_slot *WaitWriteSlot(window_ring &ring)
+{
+	while (!SpscRoom(ring.queue, ring.size)) {
+		if (!ring.running) {
+			return NULL;
+		}
+		std::this_thread::sleep_for(std::chrono::milliseconds(1));
+	}
+	return &ring.slots[SpscHead(ring.queue) % ring.size];
+}
+
+/* Hands a sampled block over to the consumer, or drops it if it was sampled
+ * into the spare slot
+*/
+void PublishWriteSlot(window_ring &ring, window_slot *slot)
+{
+	if (slot == &ring.spare) {
+		ring.dropped++;
+		ring.overruns.fetch_add(1, std::memory_order_relaxed);
+		return;
+	}
+	slot->overruns = ring.dropped;
+	ring.dropped = 0;
+	SpscPublish(ring.queue);
+}
+
+/* Consumer side. Waits until block # index has been published.
+ * \param[in] index The block to read, counted in published blocks
+ * \return The published slot, or NULL if the ring was stopped first
+*/
+window_slot *AcquireReadSlot(window_ring &ring, const unsigned long &index)
+{
+	while (!SpscReady(ring.queue, index)) {
+		if (!ring.running) {
+			return NULL;
+		}
+		std::this_thread::sleep_for(std::chrono::milliseconds(1));   // Blocks are hundreds of ms long, polling is cheap
+	}
+	return &ring.slots[index % ring.size];
+}
+
+/* Returns all blocks before # index to the producer
+*/
+void ReleaseReadSlots(window_ring &ring, const unsigned long &index)
+{
+	SpscRelease(ring.queue, index);
+}
@@ -0,0 +1,48 @@
+#ifndef PIPELINE_H
+#define PIPELINE_H
+
+#include <atomic>
+#include <stdint.h>
+#include "spsc.h"
+
+const int RING_WINDOWS = 4;   // # of full sampling windows' worth of blocks buffered between acquisition and analysis
+
+struct window_slot {
+	uint16_t *frames;   // [n][channels] raw ADC codes, interleaved as sampled
+	double timeSpan;   // Actual sampling time of this block
+	double jitterMean;   // Lateness of the samples against the sample clock, us, 0 when simulated
+	double jitterMax;
+	unsigned long seq;   // Block number since start, dropped blocks included
+	unsigned long overruns;   // # of blocks dropped directly before this one
+};
+
+/* Single-producer/single-consumer ring of sampled blocks, a whole window or
+ * one streaming hop each, see spsc.h
+ */
+struct window_ring {
+	int n;   // # of samples per channel in a block
+	int channels;
+	int size;   // # of slots
+	window_slot *slots;
+	window_slot spare;   // Sampled into when the ring is full, then discarded
+	spsc_index queue;   // Blocks published and released by the consumer
+	std::atomic<unsigned long> overruns;   // Total # of blocks dropped
+	unsigned long dropped;   // Producer only: blocks dropped since the last publish
+	std::atomic<bool> running;
+};
+
+void SetupWindowRing(window_ring &ring, const int &n, const int &channels, const int &size);
+
+void FreeWindowRing(window_ring &ring);
+
+window_slot *AcquireWriteSlot(window_ring &ring);
+
+window_slot *WaitWriteSlot(window_ring &ring);
+
+void PublishWriteSlot(window_ring &ring, window_slot *slot);
+
+window_slot *AcquireReadSlot(window_ring &ring, const unsigned long &index);
+
+void ReleaseReadSlots(window_ring &ring, const unsigned long &index);
+
+#endif
@@ -0,0 +1,155 @@
+#include <cstdio>
+#include <cstring>
+#include <string>
+#include <map>
+#include <tuple>
+#include <mutex>
+#include <chrono>
+#include "plans.h"
+
+
+typedef std::tuple<int, bool, int, int, unsigned, int> plan_key;   // n, inverse, howmany, dist, extra flags, stride
+
+static std::map<plan_key, fftw_plan> plans;
+static std::map<plan_key, fftwf_plan> plansFloat;
+static std::mutex planLock;   // The FFTW planner isn't thread safe
+static unsigned plannerFlags = FFTW_ESTIMATE;
+static std::string wisdom;
+static int fresh[2] = {0, 0};   // # of plans not found in wisdom since the last save, double and float
+
+// The cache of each precision
+template<typename T> std::map<plan_key, typename fftw_api<T>::plan> &Plans();
+template<> std::map<plan_key, fftw_plan> &Plans<double>() { return plans; }
+template<> std::map<plan_key, fftwf_plan> &Plans<float>() { return plansFloat; }
+
+// Where the wisdom of each precision is kept
+template<typename T> std::string WisdomFile()
+{
+	return (sizeof(T) == sizeof(double)) ? wisdom : wisdom + WISDOM_FLOAT_SUFFIX;
+}
+
+/* Imports wisdom, if any, and sets the rigor new plans are made with
+ * \param[in] flags FFTW_ESTIMATE, FFTW_MEASURE or FFTW_PATIENT
+ * \param[in] wisdomFile Where wisdom is loaded from and saved to
+*/
+void SetupPlanRegistry(const unsigned &flags, const char *wisdomFile)
+{
+	std::lock_guard<std::mutex> lock(planLock);
+	plannerFlags = flags;
+	wisdom = wisdomFile;
+
+	auto begin = std::chrono::steady_clock::now();
+	int imported = fftw_api<double>::import_wisdom(WisdomFile<double>().c_str());
+	imported += fftw_api<float>::import_wisdom(WisdomFile<float>().c_str());
+	auto end = std::chrono::steady_clock::now();
+	printf("%s wisdom from %s in %.1fms \n", imported ? "Imported" : "No", wisdomFile,
+		std::chrono::duration<double, std::milli>(end - begin).count());
+}
+
+/* Returns the cached plan for a problem, planning it first if needed
+ * \tparam T double for fftw_plan, float for fftwf_plan
+ * \param[in] n The transform length
+ * \param[in] inverse false for real-to-complex, true for complex-to-real
+ * \param[in] howmany The # of transforms done per execute
+ * \param[in] dist The # of elements between the real arrays of consecutive transforms
+ * \param[in] extra Flags to plan with on top of the planner rigor, e.g. FFTW_UNALIGNED
+ * \param[in] stride The # of elements between consecutive samples of one real
+ * array, e.g. the channel count to read interleaved frames in place. Forward only.
+*/
+template<typename T>
+typename fftw_api<T>::plan GetPlan(const int &n, const bool &inverse, const int &howmany, const int &dist, const unsigned &extra, const int &stride)
+{
+	typedef fftw_api<T> api;
+	std::lock_guard<std::mutex> lock(planLock);
+	plan_key key(n, inverse, howmany, dist, extra, stride);
+	auto found = Plans<T>().find(key);
+	if (found != Plans<T>().end()) {
+		return found->second;
+	}
+
+	int bins = n / 2 + 1;
+	T *real = (T*)fftw_malloc(sizeof(T) * ((long)dist * (howmany - 1) + (long)stride * (n - 1) + 1));
+	typename api::complex *complex = (typename api::complex*)fftw_malloc(sizeof(typename api::complex) * bins * howmany);
+
+	auto begin = std::chrono::steady_clock::now();
+	typename api::plan p = NULL;
+	for (int pass = 0; (pass < 2) && (p == NULL); pass++) {
+		unsigned flags = plannerFlags | extra | (pass == 0 ? FFTW_WISDOM_ONLY : 0);   // Wisdom first
+		if (inverse) {
+			p = api::plan_many_c2r(n, howmany, complex, bins, real, dist, flags);
+		} else {
+			p = api::plan_many_r2c(n, howmany, real, dist, complex, bins, flags, stride);
+		}
+		fresh[sizeof(T) != sizeof(double)] += (pass == 1);
+	}
+	auto end = std::chrono::steady_clock::now();
+	printf("Planned %s %s n = %d x %d%s in %.1fms \n", api::name(), inverse ? "c2r" : "r2c", n, howmany, (stride > 1) ? " strided" : "",
+		std::chrono::duration<double, std::milli>(end - begin).count());
+
+	fftw_free(real);
+	fftw_free(complex);
+	Plans<T>()[key] = p;
+	return p;
+}
+
+// Batch of contiguous transforms
+template<typename T>
+typename fftw_api<T>::plan GetPlan(const int &n, const bool &inverse, const int &howmany, const int &dist, const unsigned &extra)
+{
+	return GetPlan<T>(n, inverse, howmany, dist, extra, 1);
+}
+
+/* Single contiguous forward or inverse transform of length n
+*/
+template<typename T>
+typename fftw_api<T>::plan GetPlan(const int &n, const bool &inverse)
+{
+	return GetPlan<T>(n, inverse, 1, n, 0);
+}
+
+template fftw_plan GetPlan<double>(const int &n, const bool &inverse, const int &howmany, const int &dist, const unsigned &extra, const int &stride);
+template fftwf_plan GetPlan<float>(const int &n, const bool &inverse, const int &howmany, const int &dist, const unsigned &extra, const int &stride);
+template fftw_plan GetPlan<double>(const int &n, const bool &inverse, const int &howmany, const int &dist, const unsigned &extra);
+template fftwf_plan GetPlan<float>(const int &n, const bool &inverse, const int &howmany, const int &dist, const unsigned &extra);
+template fftw_plan GetPlan<double>(const int &n, const bool &inverse);
+template fftwf_plan GetPlan<float>(const int &n, const bool &inverse);
+
+/* Exports wisdom if any plan had to be made from scratch
+*/
+void SavePlanRegistry()
+{
+	std::lock_guard<std::mutex> lock(planLock);
+	if (plannerFlags != FFTW_ESTIMATE) {   // ESTIMATE plans aren't worth keeping
+		if ((fresh[0] > 0) && !fftw_api<double>::export_wisdom(WisdomFile<double>().c_str())) {
+			printf("Could not save wisdom to %s \n", WisdomFile<double>().c_str());
+		}
+		if ((fresh[1] > 0) && !fftw_api<float>::export_wisdom(WisdomFile<float>().c_str())) {
+			printf("Could not save wisdom to %s \n", WisdomFile<float>().c_str());
+		}
+	}
+	fresh[0] = fresh[1] = 0;
+}
+
+void FreePlanRegistry()
+{
+	std::lock_guard<std::mutex> lock(planLock);
+	for (auto &entry : plans) {
+		fftw_destroy_plan(entry.second);
+	}
+	for (auto &entry : plansFloat) {
+		fftwf_destroy_plan(entry.second);
+	}
+	plans.clear();
+	plansFloat.clear();
+}
+
+/* Planner rigor by name
+ * \param[in] mode "estimate", "measure", "patient" or "exhaustive"
+*/
+unsigned PlannerFlags(const char *mode)
+{
+	if (strcmp(mode, "measure") == 0) { return FFTW_MEASURE; }
+	if (strcmp(mode, "patient") == 0) { return FFTW_PATIENT; }
+	if (strcmp(mode, "exhaustive") == 0) { return FFTW_EXHAUSTIVE; }
+	return FFTW_ESTIMATE;
+}
@@ -0,0 +1,35 @@
+#ifndef PLANS_H
+#define PLANS_H
+
+#include <fftw3.h>
+#include "precision.h"
+
+const char WISDOM_FILE[] = "siren.wisdom";   // Default wisdom file, opened relative to the working directory, so services should give mainpi an absolute --wisdom
+const char WISDOM_FLOAT_SUFFIX[] = ".float";
+
+/* Process-wide cache of FFTW plans, one per (length, direction, batch layout, stride).
+ * Plans are made on scratch arrays, so MEASURE/PATIENT planning never
+ * clobbers live data, and must be executed with the new-array interface
+ * (fftw_execute_dft_r2c/c2r) on fftw_malloc'd arrays. Wisdom is imported at
+ * setup, so rigorous plans generated once are loaded instantly at boot.
+ * Double and single precision plans are kept apart, single precision wisdom
+ * in the wisdom file name with WISDOM_FLOAT_SUFFIX appended.
+*/
+void SetupPlanRegistry(const unsigned &flags, const char *wisdomFile);
+
+template<typename T = double>
+typename fftw_api<T>::plan GetPlan(const int &n, const bool &inverse, const int &howmany, const int &dist, const unsigned &extra, const int &stride);
+
+template<typename T = double>
+typename fftw_api<T>::plan GetPlan(const int &n, const bool &inverse, const int &howmany, const int &dist, const unsigned &extra);
+
+template<typename T = double>
+typename fftw_api<T>::plan GetPlan(const int &n, const bool &inverse);
+
+void SavePlanRegistry();
+
+void FreePlanRegistry();
+
+unsigned PlannerFlags(const char *mode);
+
+#endif
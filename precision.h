@@ -0,0 +1,47 @@
+#ifndef PRECISION_H
+#define PRECISION_H
+
+#include <fftw3.h>
+
+/* FFTW's double (fftw_*) and single (fftwf_*) interfaces behind one name, so
+ * the detection path can be instantiated for either sample type. The MCP3008
+ * gives 10 bits, well within float, and float halves memory traffic and
+ * doubles SIMD width. Single precision needs -lfftw3f next to -lfftw3.
+*/
+template<typename T> struct fftw_api;
+
+template<> struct fftw_api<double> {
+	typedef fftw_complex complex;
+	typedef fftw_plan plan;
+	static const char *name() { return "double"; }
+	static plan plan_many_r2c(int n, int howmany, double *in, int idist, complex *out, int odist, unsigned flags, int istride = 1)
+	{
+		return fftw_plan_many_dft_r2c(1, &n, howmany, in, NULL, istride, idist, out, NULL, 1, odist, flags);
+	}
+	static plan plan_many_c2r(int n, int howmany, complex *in, int idist, double *out, int odist, unsigned flags)
+	{
+		return fftw_plan_many_dft_c2r(1, &n, howmany, in, NULL, 1, idist, out, NULL, 1, odist, flags);
+	}
+	static void execute_r2c(const plan p, double *in, complex *out) { fftw_execute_dft_r2c(p, in, out); }
+	static int import_wisdom(const char *file) { return fftw_import_wisdom_from_filename(file); }
+	static int export_wisdom(const char *file) { return fftw_export_wisdom_to_filename(file); }
+};
+
+template<> struct fftw_api<float> {
+	typedef fftwf_complex complex;
+	typedef fftwf_plan plan;
+	static const char *name() { return "float"; }
+	static plan plan_many_r2c(int n, int howmany, float *in, int idist, complex *out, int odist, unsigned flags, int istride = 1)
+	{
+		return fftwf_plan_many_dft_r2c(1, &n, howmany, in, NULL, istride, idist, out, NULL, 1, odist, flags);
+	}
+	static plan plan_many_c2r(int n, int howmany, complex *in, int idist, float *out, int odist, unsigned flags)
+	{
+		return fftwf_plan_many_dft_c2r(1, &n, howmany, in, NULL, 1, idist, out, NULL, 1, odist, flags);
+	}
+	static void execute_r2c(const plan p, float *in, complex *out) { fftwf_execute_dft_r2c(p, in, out); }
+	static int import_wisdom(const char *file) { return fftwf_import_wisdom_from_filename(file); }
+	static int export_wisdom(const char *file) { return fftwf_export_wisdom_to_filename(file); }
+};
+
+#endif
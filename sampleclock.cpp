@@ -0,0 +1,88 @@
+#include <cstring>
+#include <algorithm>
+#include "sampleclock.h"
+
+
+static long Nanoseconds(const struct timespec &t)
+{
+	return t.tv_sec * 1000000000L + t.tv_nsec;
+}
+
+static struct timespec Timespec(const long &ns)
+{
+	struct timespec t;
+	t.tv_sec = ns / 1000000000L;
+	t.tv_nsec = ns % 1000000000L;
+	return t;
+}
+
+/* \param[in] fs The rate to sample at, any rate the SPI transfers keep up with
+ * \param[in] spin How long before each deadline to stop sleeping and busy-wait, ns
+*/
+void SetupSampleClock(sample_clock &clock, const double &fs, const long &spin)
+{
+	clock.fs = fs;
+	clock.period = (long)(1e9 / fs);
+	clock.spin = spin;
+	ResetJitter(clock.jitter);
+	StartSampleClock(clock);
+}
+
+/* Makes the next deadline now, e.g. after the thread was held up
+*/
+void StartSampleClock(sample_clock &clock)
+{
+	clock_gettime(CLOCK_MONOTONIC, &clock.next);
+}
+
+/* Blocks until the next sample is due, records how late it returned and
+ * moves the deadline on by one period
+*/
+void WaitNextSample(sample_clock &clock)
+{
+	long deadline = Nanoseconds(clock.next);
+	struct timespec now;
+	clock_gettime(CLOCK_MONOTONIC, &now);
+
+	if (deadline - Nanoseconds(now) > clock.spin) {
+		struct timespec wake = Timespec(deadline - clock.spin);
+		clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &wake, NULL);
+	}
+	do {
+		clock_gettime(CLOCK_MONOTONIC, &now);
+	} while (Nanoseconds(now) < deadline);
+
+	double lateness = (Nanoseconds(now) - deadline) / 1000.0;
+	jitter_stats &jitter = clock.jitter;
+	jitter.count++;
+	jitter.sum += lateness;
+	jitter.max = std::max(jitter.max, lateness);
+	jitter.buckets[std::min((int)lateness, JITTER_BUCKETS - 1)]++;
+
+	if (Nanoseconds(now) - deadline > clock.period) {
+		jitter.late++;
+		clock.next = now;   // Don't burst to catch up, the missed time is lost either way
+	}
+	clock.next = Timespec(Nanoseconds(clock.next) + clock.period);
+}
+
+void ResetJitter(jitter_stats &jitter)
+{
+	memset(&jitter, 0, sizeof(jitter));
+}
+
+/* Lateness below which a fraction p of the samples were taken, to 1us
+ * \param[in] p The fraction, e.g. 0.99
+*/
+double JitterPercentile(const jitter_stats &jitter, const double &p)
+{
+	long target = (long)(p * jitter.count);
+	long seen = 0;
+	for (int b = 0; b < JITTER_BUCKETS; b++) {
+		seen += jitter.buckets[b];
+		if (seen > target) {
+			return b + 1;
+		}
+	}
+	return JITTER_BUCKETS;
+}
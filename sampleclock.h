@@ -0,0 +1,43 @@
+#ifndef SAMPLECLOCK_H
+#define SAMPLECLOCK_H
+
+#include <time.h>
+
+const long SAMPLE_SPIN_NS = 60000;   // Busy-wait the last 60us before each deadline, sleep wake-ups are later than that
+const int JITTER_BUCKETS = 512;   // 1us histogram buckets, the last one collects everything later
+const double RATE_TOLERANCE = 0.005;   // Measured rate drift that triggers recomputing the band indeces
+
+/* Lateness of each sample against its deadline, in microseconds
+*/
+struct jitter_stats {
+	long count;
+	double sum;
+	double max;
+	long late;   // # of samples more than a whole period late, the clock was resynchronised after each
+	long buckets[JITTER_BUCKETS];
+};
+
+/* Absolute-deadline sample clock. Deadlines are period apart from the first
+ * one on CLOCK_MONOTONIC, so pacing errors don't accumulate as they did with
+ * a fixed delay after each sample. The thread sleeps (clock_nanosleep,
+ * TIMER_ABSTIME) until spin before the deadline and busy-waits the rest.
+*/
+struct sample_clock {
+	double fs;   // Target rate
+	long period;   // ns
+	long spin;   // ns
+	struct timespec next;   // Deadline of the next sample
+	jitter_stats jitter;   // Since the last ResetJitter
+};
+
+void SetupSampleClock(sample_clock &clock, const double &fs, const long &spin);
+
+void StartSampleClock(sample_clock &clock);
+
+void WaitNextSample(sample_clock &clock);
+
+void ResetJitter(jitter_stats &jitter);
+
+double JitterPercentile(const jitter_stats &jitter, const double &p);
+
+#endif
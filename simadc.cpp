@@ -0,0 +1,101 @@
+#include <cstdlib>
+#include <algorithm>
+#include <math.h>
+#include <thread>
+#include "simadc.h"
+
+
+void SetupSimAdc(sim_adc &adc, const double &fs, const int &n, const int &channels)
+{
+	adc.fs = fs;
+	adc.n = n;
+	adc.channels = channels;
+	adc.t = 0;
+	adc.phase = 0;
+	adc.seed = 1;
+	adc.realtime = true;
+	adc.deadline = std::chrono::steady_clock::now();
+}
+
+/* Instantaneous frequency of the simulated wail at time t
+*/
+static double SimSweep(const double &t)
+{
+	double pos = fmod(t, SIM_SWEEP_PERIOD) / SIM_SWEEP_PERIOD;
+	double tri = (pos < 0.5) ? 2 * pos : 2 * (1 - pos);
+	return SIM_SWEEP_MIN + tri * (SIM_SWEEP_MAX - SIM_SWEEP_MIN);
+}
+
+/* Advances the simulation by one sampling instant
+ * \param[in] adc The simulated ADC state
+ * \param[in] *codes The array to hold one 10-bit code per channel
+*/
+static void SimFrame(sim_adc &adc, double *codes)
+{
+	bool on = fmod(adc.t, SIM_SIREN_ON + SIM_SIREN_OFF) < SIM_SIREN_ON;
+	adc.phase = fmod(adc.phase + 2 * M_PI * SimSweep(adc.t) / adc.fs, 2 * M_PI);
+	double siren = on * SIM_AMPLITUDE * sin(adc.phase);
+
+	for (int ch = 0; ch < adc.channels; ch++) {
+		double noise = SIM_NOISE * (2.0 * rand_r(&adc.seed) / RAND_MAX - 1);
+		double gain = (ch < 4) ? SIM_GAIN[ch] : 0.5;
+		double v = round(512 + gain * siren + noise);
+		codes[ch] = std::min(std::max(v, 0.0), 1023.0);   // 10-bit ADC range
+	}
+	adc.t += 1.0 / adc.fs;
+}
+
+/* Sleeps until the window begun at begin would have finished on the real ADC
+ * \return The time taken to complete the sampling window
+*/
+static double SimPace(sim_adc &adc, const std::chrono::steady_clock::time_point &begin)
+{
+	if (!adc.realtime) {
+		return adc.n / adc.fs;
+	}
+	adc.deadline = std::max(adc.deadline, begin) + std::chrono::duration_cast<std::chrono::steady_clock::duration>(
+		std::chrono::duration<double>(adc.n / adc.fs));
+	std::this_thread::sleep_until(adc.deadline);
+
+	auto end = std::chrono::steady_clock::now();
+	return std::chrono::duration<double>(end - begin).count();
+}
+
+/* Fills one sampling window for all channels, then sleeps until the window
+ * would have finished on the real ADC.
+ * \param[in] adc The simulated ADC state
+ * \param[in] **samples The array that will hold all samples for this window, [channels][n]
+ * \return The time taken to complete the sampling window
+*/
+double SimSampling(sim_adc &adc, double **samples)
+{
+	auto begin = std::chrono::steady_clock::now();
+	double codes[SIM_MAX_CHANNELS];
+
+	for (int i = 0; i < adc.n; i++) {
+		SimFrame(adc, codes);
+		for (int ch = 0; ch < adc.channels; ch++) {
+			samples[ch][i] = codes[ch];
+		}
+	}
+
+	return SimPace(adc, begin);
+}
+
+/* As above, as raw interleaved frames like DoSampling
+ * \param[in] *frames The array that will hold all samples for this window, [n][channels]
+*/
+double SimSampling(sim_adc &adc, uint16_t *frames)
+{
+	auto begin = std::chrono::steady_clock::now();
+	double codes[SIM_MAX_CHANNELS];
+
+	for (int i = 0; i < adc.n; i++) {
+		SimFrame(adc, codes);
+		for (int ch = 0; ch < adc.channels; ch++) {
+			frames[(long)i * adc.channels + ch] = (uint16_t)codes[ch];
+		}
+	}
+
+	return SimPace(adc, begin);
+}
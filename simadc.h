@@ -0,0 +1,38 @@
+#ifndef SIMADC_H
+#define SIMADC_H
+
+#include <chrono>
+#include <stdint.h>
+
+// Simulated siren, a wail sweeping between the two frequencies
+const double SIM_SWEEP_MIN = 750;
+const double SIM_SWEEP_MAX = 1450;
+const double SIM_SWEEP_PERIOD = 4.0;   // Seconds per up-and-down sweep
+const double SIM_SIREN_ON = 20.0;   // Seconds the siren is present per cycle
+const double SIM_SIREN_OFF = 10.0;   // Seconds of background noise only per cycle
+const double SIM_AMPLITUDE = 150;   // ADC counts at the loudest microphone
+const double SIM_NOISE = 40;   // Peak ADC counts of uniform background noise
+const double SIM_GAIN[4] = {1.0, 0.6, 0.3, 0.6};   // Relative loudness per mic, siren is east
+const int SIM_MAX_CHANNELS = 16;
+
+/* Stands in for the MCP3008 so the pipeline can run without a Pi. Produces
+ * 10-bit samples in real time at the configured rate.
+*/
+struct sim_adc {
+	double fs;
+	int n;
+	int channels;
+	double t;   // Simulated time of the next sample
+	double phase;
+	unsigned int seed;
+	bool realtime;   // Sleep until each window would have been sampled
+	std::chrono::steady_clock::time_point deadline;   // When the current window is complete
+};
+
+void SetupSimAdc(sim_adc &adc, const double &fs, const int &n, const int &channels);
+
+double SimSampling(sim_adc &adc, double **samples);
+
+double SimSampling(sim_adc &adc, uint16_t *frames);
+
+#endif
@@ -0,0 +1,196 @@
+#include <cstdio>
+#include <cstring>
+#include <algorithm>
+#include <math.h>
+#include "sirengen.h"
+
+
+/* A scene with the pattern's usual sweep, the simulated ADC's loudness and
+ * noise, and the siren to the east of the array, as simadc.h places it
+ * \param[in] pattern The siren to sound
+ * \param[in] fs The sampling rate, which bounds the per-mic delays
+*/
+siren_scene DefaultScene(const siren_pattern &pattern, const double &fs)
+{
+	siren_scene scene;
+	scene.pattern = pattern;
+	scene.fMin = (pattern == SIREN_HILO) ? HILO_LOW : SIM_SWEEP_MIN;
+	scene.fMax = (pattern == SIREN_HILO) ? HILO_HIGH : SIM_SWEEP_MAX;
+	scene.period = (pattern == SIREN_YELP) ? YELP_PERIOD : (pattern == SIREN_HILO) ? HILO_PERIOD : SIM_SWEEP_PERIOD;
+	scene.speed = 0;
+	scene.snr = 10;
+	scene.noise = SIM_NOISE / sqrt(3);   // Same RMS as the simulated ADC's uniform noise
+	scene.on = SIM_SIREN_ON;
+	scene.off = 2 * SIM_SIREN_ON;
+	scene.seed = 1;
+
+	// East, north, west, south: the west mic is two spacings further away
+	const double hops[4] = {0, 1, 2, 1};
+	for (int ch = 0; ch < SIM_MAX_CHANNELS; ch++) {
+		scene.gain[ch] = (ch < 4) ? SIM_GAIN[ch] : 0.5;
+		scene.delay[ch] = std::min((ch < 4) ? hops[ch] * MIC_SPACING / SPEED_OF_SOUND : 0, (SIREN_DELAY_SAMPLES - 2) / fs);
+	}
+	return scene;
+}
+
+/* Pattern by name
+ * \param[in] name "wail", "yelp", "hilo" or "none"
+*/
+siren_pattern SirenPattern(const char *name)
+{
+	if (strcmp(name, "yelp") == 0) { return SIREN_YELP; }
+	if (strcmp(name, "hilo") == 0) { return SIREN_HILO; }
+	if (strcmp(name, "none") == 0) { return SIREN_NONE; }
+	return SIREN_WAIL;
+}
+
+void SetupSirenGen(siren_gen &gen, const siren_scene &scene, const double &fs, const int &channels)
+{
+	gen.scene = scene;
+	gen.fs = fs;
+	gen.channels = channels;
+	gen.i = 0;
+	gen.phase = 0;
+	gen.rng = scene.seed ? scene.seed : 1;
+	gen.hasSpare = false;
+	std::fill(gen.past, gen.past + SIREN_DELAY_SAMPLES, 0.0);
+}
+
+// Standard normal deviate from a xorshift64* stream, by Box-Muller
+static double Gauss(siren_gen &gen)
+{
+	if (gen.hasSpare) {
+		gen.hasSpare = false;
+		return gen.spare;
+	}
+	double u[2];
+	for (int k = 0; k < 2; k++) {
+		gen.rng ^= gen.rng >> 12;
+		gen.rng ^= gen.rng << 25;
+		gen.rng ^= gen.rng >> 27;
+		u[k] = (((gen.rng * 2685821657736338717ULL) >> 11) + 1) * (1.0 / 9007199254740992.0);   // (0, 1]
+	}
+	double r = sqrt(-2 * log(u[0]));
+	gen.spare = r * sin(2 * M_PI * u[1]);
+	gen.hasSpare = true;
+	return r * cos(2 * M_PI * u[1]);
+}
+
+// Instantaneous frequency of the siren tau seconds after its onset, Doppler shifted
+static double SirenFrequency(const siren_scene &scene, const double &tau)
+{
+	double pos = fmod(tau, scene.period) / scene.period;
+	double f;
+	if (scene.pattern == SIREN_HILO) {
+		f = (pos < 0.5) ? scene.fMax : scene.fMin;
+	} else {
+		double tri = (pos < 0.5) ? 2 * pos : 2 * (1 - pos);
+		f = scene.fMin + tri * (scene.fMax - scene.fMin);
+	}
+	return f * SPEED_OF_SOUND / (SPEED_OF_SOUND - scene.speed);
+}
+
+/* Generates the next n frames of the scene as 10-bit ADC codes
+ * \param[in] *frames The array to hold the frames, [n][channels]
+*/
+void GenerateFrames(siren_gen &gen, uint16_t *frames, const int &n)
+{
+	const siren_scene &scene = gen.scene;
+	double amplitude = scene.noise * sqrt(2) * pow(10, scene.snr / 20);   // Peak of a sine of that RMS
+	double cycle = scene.on + scene.off;
+
+	for (int f = 0; f < n; f++, gen.i++) {
+		double tau = fmod(gen.i / gen.fs, cycle);
+		bool on = (scene.pattern != SIREN_NONE) && (tau < scene.on);
+		gen.phase = fmod(gen.phase + 2 * M_PI * SirenFrequency(scene, tau) / gen.fs, 2 * M_PI);
+		gen.past[gen.i & (SIREN_DELAY_SAMPLES - 1)] = on * amplitude * sin(gen.phase);
+
+		for (int ch = 0; ch < gen.channels; ch++) {
+			double d = scene.delay[ch] * gen.fs;
+			long k = (long)d;
+			double a = gen.past[(gen.i - k) & (SIREN_DELAY_SAMPLES - 1)];
+			double b = gen.past[(gen.i - k - 1) & (SIREN_DELAY_SAMPLES - 1)];
+			double v = round(512 + scene.gain[ch] * (a + (d - k) * (b - a)) + scene.noise * Gauss(gen));
+			frames[(long)f * gen.channels + ch] = (uint16_t)std::min(std::max(v, 0.0), 1023.0);   // 10-bit ADC range
+		}
+	}
+}
+
+/* \param[in] seconds The simulated time the run will last, to size the latency lists up front
+*/
+void SetupScore(detection_score &score, const siren_scene &scene, const double &seconds)
+{
+	score.scene = scene;
+	score.latencies.clear();
+	score.detected.clear();
+	score.latencies.reserve((size_t)(seconds / (scene.on + scene.off)) + 2);   // Scoring a window never allocates
+	score.detected.reserve((size_t)(seconds / (scene.on + scene.off)) + 2);
+	score.falseAlarms = 0;
+	score.alarm = false;
+	score.simulated = 0;
+	score.cpu = 0;
+}
+
+/* Scores the verdict of one analysed window against the scene
+ * \param[in] start The simulated time the window starts at, s
+ * \param[in] end The simulated time the window ends at, when its verdict is known
+ * \param[in] detected Whether the window was detected as a siren
+*/
+void ScoreWindow(detection_score &score, const double &start, const double &end, const bool &detected)
+{
+	const siren_scene &scene = score.scene;
+	double cycle = scene.on + scene.off;
+	score.simulated = std::max(score.simulated, end);
+
+	// The siren cycle the window overlaps, if any. Windows are shorter than the silences
+	long k = (long)(end / cycle);
+	long overlap = -1;
+	if (scene.pattern != SIREN_NONE) {
+		if ((end > k * cycle) && (start < k * cycle + scene.on)) {
+			overlap = k;
+		} else if ((k > 0) && (start < (k - 1) * cycle + scene.on)) {
+			overlap = k - 1;
+		}
+	}
+
+	if (!detected) {
+		score.alarm = false;
+	} else if (overlap >= 0) {
+		if (score.detected.empty() || (score.detected.back() != overlap)) {
+			score.latencies.push_back(end - overlap * cycle);
+			score.detected.push_back(overlap);
+		}
+		score.alarm = false;
+	} else {
+		score.falseAlarms += !score.alarm;
+		score.alarm = true;
+	}
+}
+
+/* Prints the latency distribution over the siren cycles completed in the
+ * run, the false alarm rate and the CPU cost
+*/
+void PrintScore(const detection_score &score)
+{
+	const siren_scene &scene = score.scene;
+	double cycle = scene.on + scene.off;
+	long cycles = ((scene.pattern == SIREN_NONE) || (score.simulated < scene.on)) ? 0 : (long)((score.simulated - scene.on) / cycle) + 1;
+	double sirenTime = cycles * scene.on;
+	double hours = score.simulated / 3600;
+
+	std::vector<double> lat;
+	for (size_t j = 0; j < score.latencies.size(); j++) {
+		if (score.detected[j] < cycles) { lat.push_back(score.latencies[j]); }
+	}
+	std::sort(lat.begin(), lat.end());
+
+	printf("Simulated %.2fh, %ld siren cycles of %.0fs, detected %zu, missed %ld \n", hours, cycles, scene.on, lat.size(), cycles - (long)lat.size());
+	if (!lat.empty()) {
+		double mean = 0;
+		for (double l : lat) { mean += l; }
+		printf("Time to detect: mean %.2fs, p50 %.2fs, p90 %.2fs, p99 %.2fs, max %.2fs \n", mean / lat.size(),
+			lat[(size_t)(0.5 * (lat.size() - 1))], lat[(size_t)(0.9 * (lat.size() - 1))], lat[(size_t)(0.99 * (lat.size() - 1))], lat.back());
+	}
+	printf("False alarms: %ld, %.2f per hour without siren \n", score.falseAlarms, score.falseAlarms / std::max((score.simulated - sirenTime) / 3600, 1e-9));
+	printf("Analysis CPU: %.2fs, %.2fs per simulated hour \n", score.cpu, score.cpu / std::max(hours, 1e-9));
+}
@@ -0,0 +1,82 @@
+#ifndef SIRENGEN_H
+#define SIRENGEN_H
+
+#include <stdint.h>
+#include <vector>
+#include "simadc.h"
+
+const double SPEED_OF_SOUND = 343;   // m/s
+const double YELP_PERIOD = 0.33;   // Seconds per yelp sweep
+const double HILO_HIGH = 1100;   // Hz, the two hi-lo tones
+const double HILO_LOW = 800;
+const double HILO_PERIOD = 1.2;   // Seconds per high + low pair
+const double MIC_SPACING = 0.1;   // m between adjacent mics, for the default delays
+const int SIREN_DELAY_SAMPLES = 256;   // Longest per-mic delay in samples, a power of 2
+
+enum siren_pattern {
+	SIREN_WAIL,   // Slow triangle sweep
+	SIREN_YELP,   // Fast triangle sweep
+	SIREN_HILO,   // Two alternating tones
+	SIREN_NONE   // Background noise only
+};
+
+/* Everything the generator produces is derived from the scene and its seed,
+ * so a run can be repeated sample for sample.
+*/
+struct siren_scene {
+	siren_pattern pattern;
+	double fMin;   // Sweep range, Hz, before Doppler
+	double fMax;
+	double period;   // Seconds per sweep, or per hi-lo pair
+	double speed;   // Radial speed of the vehicle, m/s, positive approaching
+	double snr;   // dB of siren over noise RMS at a mic of gain 1
+	double noise;   // RMS ADC counts of Gaussian background noise
+	double on;   // Seconds the siren sounds per cycle, from the start of the cycle
+	double off;   // Seconds of background noise only per cycle
+	double gain[SIM_MAX_CHANNELS];   // Relative loudness per mic
+	double delay[SIM_MAX_CHANNELS];   // Arrival delay per mic, s, at most SIREN_DELAY_SAMPLES / fs
+	uint64_t seed;
+};
+
+struct siren_gen {
+	siren_scene scene;
+	double fs;
+	int channels;
+	long i;   // # of frames generated
+	double phase;
+	uint64_t rng;
+	double spare;   // Second normal deviate of the last Box-Muller pair
+	bool hasSpare;
+	double past[SIREN_DELAY_SAMPLES];   // Latest siren samples, for the per-mic delays
+};
+
+/* Ground truth and verdicts of an end-to-end run. Each siren cycle counts once:
+ * detected at the end of its first analysed window with a detection, or missed.
+ * Detections in windows that contain no siren at all are false alarms,
+ * counted once per run of consecutive such windows.
+*/
+struct detection_score {
+	siren_scene scene;
+	std::vector<double> latencies;   // Siren onset to the end of the detecting window, s
+	std::vector<long> detected;   // The siren cycle of each latency
+	long falseAlarms;
+	bool alarm;   // The previous window raised a false alarm
+	double simulated;   // Seconds of audio analysed
+	double cpu;   // CPU seconds of the analysis thread
+};
+
+siren_scene DefaultScene(const siren_pattern &pattern, const double &fs);
+
+siren_pattern SirenPattern(const char *name);
+
+void SetupSirenGen(siren_gen &gen, const siren_scene &scene, const double &fs, const int &channels);
+
+void GenerateFrames(siren_gen &gen, uint16_t *frames, const int &n);
+
+void SetupScore(detection_score &score, const siren_scene &scene, const double &seconds);
+
+void ScoreWindow(detection_score &score, const double &start, const double &end, const bool &detected);
+
+void PrintScore(const detection_score &score);
+
+#endif
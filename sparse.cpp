@@ -0,0 +1,175 @@
+#include <cstdlib>
+#include <cstring>
+#include <algorithm>
+#include <math.h>
+#include "sparse.h"
+
+
+/* Sets up a bank for the bins used by multithresholding. Room is kept for
+ * every bin below n/2, so RetuneSparseBank never allocates.
+ * \param[in] mtIndeces The multithresholding variables, for window length n
+ * \param[in] n The window length
+ * \param[in] channels The # of channels to keep state for
+*/
+void SetupSparseBank(sparse_bank &bank, const multi_thresh_indeces &mtIndeces, const int &n, const int &channels)
+{
+	bank.n = n;
+	bank.channels = channels;
+	bank.bins = (int*)malloc(sizeof(int) * (n / 2));
+	bank.coeff = (double*)malloc(sizeof(double) * (n / 2));
+	bank.twRe = (double*)malloc(sizeof(double) * (n / 2));
+	bank.twIm = (double*)malloc(sizeof(double) * (n / 2));
+	bank.re = (double*)calloc((long)channels * (n / 2), sizeof(double));
+	bank.im = (double*)calloc((long)channels * (n / 2), sizeof(double));
+	bank.absFFT = (double*)calloc((long)channels * (n / 2), sizeof(double));
+	bank.hops = (int*)calloc(channels, sizeof(int));
+	RetuneSparseBank(bank, mtIndeces);
+}
+
+/* Collects the bins of new multithresholding variables, e.g. for a measured
+ * rate, and precomputes their coefficients in place. The sliding DFT state
+ * is zeroed, GoertzelBins reseeds it.
+ * \param[in] mtIndeces The multithresholding variables, for the bank's window length
+*/
+void RetuneSparseBank(sparse_bank &bank, const multi_thresh_indeces &mtIndeces)
+{
+	const int ranges[3][2] = {{mtIndeces.noiseIndexLowMin, mtIndeces.noiseIndexLowMax},
+		{mtIndeces.bandIndeces[0], mtIndeces.bandIndeces[BANDS]},
+		{mtIndeces.noiseIndexHighMin, mtIndeces.noiseIndexHighMax}};
+
+	bank.count = 0;
+	for (int r = 0; r < 3; r++) {
+		for (int k = ranges[r][0]; k < ranges[r][1]; k++) {
+			if ((bank.count == 0) || (k > bank.bins[bank.count - 1])) {   // Ranges are ascending, skip overlaps
+				bank.bins[bank.count++] = k;
+			}
+		}
+	}
+
+	for (int b = 0; b < bank.count; b++) {
+		double w = 2 * M_PI * bank.bins[b] / bank.n;
+		bank.coeff[b] = 2 * cos(w);
+		bank.twRe[b] = cos(w);
+		bank.twIm[b] = sin(w);
+	}
+	ResetSparseBank(bank);
+}
+
+void FreeSparseBank(sparse_bank &bank)
+{
+	free(bank.bins);
+	free(bank.coeff);
+	free(bank.twRe);
+	free(bank.twIm);
+	free(bank.re);
+	free(bank.im);
+	free(bank.absFFT);
+	free(bank.hops);
+}
+
+/* Zeroes all sliding DFT state, e.g. after the history was reset
+*/
+void ResetSparseBank(sparse_bank &bank)
+{
+	memset(bank.re, 0, sizeof(double) * bank.channels * bank.count);
+	memset(bank.im, 0, sizeof(double) * bank.channels * bank.count);
+	memset(bank.hops, 0, sizeof(int) * bank.channels);
+}
+
+/* Evaluates every bin of one channel over a whole window with the Goertzel
+ * recurrence, GOERTZEL_LANES bins at a time so the inner loop vectorises.
+ * Also reseeds the sliding DFT state of the channel.
+ * \param[in] ch The channel the window belongs to
+ * \param[in] *window The n samples, oldest first
+*/
+template<typename T>
+void GoertzelBins(sparse_bank &bank, const int &ch, const T *window)
+{
+	double *row = bank.absFFT + (long)ch * (bank.n / 2);
+	double *re = bank.re + (long)ch * bank.count;
+	double *im = bank.im + (long)ch * bank.count;
+
+	for (int b0 = 0; b0 < bank.count; b0 += GOERTZEL_LANES) {
+		int lanes = std::min(GOERTZEL_LANES, bank.count - b0);
+		double c[GOERTZEL_LANES] = { 0 };
+		double s1[GOERTZEL_LANES] = { 0 };
+		double s2[GOERTZEL_LANES] = { 0 };
+		for (int l = 0; l < lanes; l++) {
+			c[l] = bank.coeff[b0 + l];
+		}
+
+		for (int j = 0; j < bank.n; j++) {
+			for (int l = 0; l < GOERTZEL_LANES; l++) {
+				double s0 = window[j] + c[l] * s1[l] - s2[l];
+				s2[l] = s1[l];
+				s1[l] = s0;
+			}
+		}
+
+		for (int l = 0; l < lanes; l++) {
+			int b = b0 + l;
+			// X_k = e^(2pi i k/n) s1 - s2, in the same phase the sliding DFT keeps
+			re[b] = bank.twRe[b] * s1[l] - s2[l];
+			im[b] = bank.twIm[b] * s1[l];
+			row[bank.bins[b]] = 2 * sqrt(re[b] * re[b] + im[b] * im[b]) / bank.n;
+		}
+	}
+}
+
+/* Advances the sliding DFT of a run of channels by the hop just appended to
+ * the history, then refreshes their magnitudes. Every SDFT_RESYNC hops the state
+ * is recomputed exactly to stop rounding errors accumulating.
+ * \param[in] hist The history, hop <= n/2 so the samples leaving the window are still held
+ * \param[in] first The first channel
+ * \param[in] count The # of consecutive channels
+*/
+template<typename T>
+void SlideHop(sparse_bank &bank, const stft_history<T> &hist, const int &first, const int &count)
+{
+	long oldest = hist.pos - hist.hop - bank.n;   // Sample leaving the window as the first new one enters
+	for (int ch = first; ch < first + count; ch++) {
+		if ((++bank.hops[ch] >= SDFT_RESYNC) && WindowReady(hist, 0)) {
+			GoertzelBins(bank, ch, WindowPtr(hist, ch, 0));
+			bank.hops[ch] = 0;
+			continue;
+		}
+		
+		const T *samples = hist.block + (long)ch * hist.stride;
+		double *__restrict re = bank.re + (long)ch * bank.count;
+		double *__restrict im = bank.im + (long)ch * bank.count;
+		const double *__restrict twRe = bank.twRe;
+		const double *__restrict twIm = bank.twIm;
+
+		for (int j = 0; j < hist.hop; j++) {
+			double xNew = samples[(hist.pos - hist.hop + j) % hist.length];
+			double xOld = (oldest + j >= 0) ? samples[(oldest + j) % hist.length] : 0;   // Zeros before the first sample
+			double d = xNew - xOld;
+
+			// X_k = (X_k + x_new - x_old) e^(2pi i k/n), over all bins
+			for (int b = 0; b < bank.count; b++) {
+				double r = re[b] + d;
+				re[b] = r * twRe[b] - im[b] * twIm[b];
+				im[b] = r * twIm[b] + im[b] * twRe[b];
+			}
+		}
+
+		double *row = bank.absFFT + (long)ch * (bank.n / 2);
+		for (int b = 0; b < bank.count; b++) {
+			row[bank.bins[b]] = 2 * sqrt(re[b] * re[b] + im[b] * im[b]) / bank.n;
+		}
+	}
+}
+
+/* The sparse magnitude spectrum of one channel, for AnalyseSpectrum
+*/
+const double *SparseRow(const sparse_bank &bank, const int &ch)
+{
+	return bank.absFFT + (long)ch * (bank.n / 2);
+}
+
+#define INSTANTIATE_SPARSE(T) \
+	template void GoertzelBins(sparse_bank &bank, const int &ch, const T *window); \
+	template void SlideHop(sparse_bank &bank, const stft_history<T> &hist, const int &first, const int &count);
+
+INSTANTIATE_SPARSE(double)
+INSTANTIATE_SPARSE(float)
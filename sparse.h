@@ -0,0 +1,46 @@
+#ifndef SPARSE_H
+#define SPARSE_H
+
+#include "detection.h"
+#include "stft.h"
+
+const int GOERTZEL_LANES = 8;   // Bins run through the Goertzel recurrence side by side
+const int SDFT_RESYNC = 256;   // # of hops between exact recomputations of the sliding DFT
+
+/* Sparse spectral backend: only the bins multithresholding reads (both noise
+ * ranges and the bands of interest) are evaluated, either once per window
+ * with a Goertzel bank or per incoming sample with a sliding DFT. Results
+ * go into an absFFT-shaped row so AnalyseSpectrum works unchanged.
+ * The recurrences always run in double, reading float or double history.
+*/
+struct sparse_bank {
+	int n;   // Window length
+	int channels;
+	int count;   // # of bins evaluated
+	int *bins;   // [count] bin indeces, room for n/2
+	double *coeff;   // [count] Goertzel 2cos(2pi k/n)
+	double *twRe;   // [count] sliding DFT twiddle e^(2pi i k/n)
+	double *twIm;
+	double *re;   // [channels][count] sliding DFT state, room for n/2 per channel
+	double *im;
+	double *absFFT;   // [channels][n/2], only the evaluated bins are filled in
+	int *hops;   // [channels] # of hops slid since the last exact recomputation
+};
+
+void SetupSparseBank(sparse_bank &bank, const multi_thresh_indeces &mtIndeces, const int &n, const int &channels);
+
+void RetuneSparseBank(sparse_bank &bank, const multi_thresh_indeces &mtIndeces);
+
+void FreeSparseBank(sparse_bank &bank);
+
+void ResetSparseBank(sparse_bank &bank);
+
+template<typename T>
+void GoertzelBins(sparse_bank &bank, const int &ch, const T *window);
+
+template<typename T>
+void SlideHop(sparse_bank &bank, const stft_history<T> &hist, const int &first, const int &count);
+
+const double *SparseRow(const sparse_bank &bank, const int &ch);
+
+#endif
@@ -0,0 +1,74 @@
+#include <cstdlib>
+#include "spectrum.h"
+#include "bandsum.h"
+#include "plans.h"
+
+
+/* Plans one transform covering channels [first, first + count) of the history
+ * \param[in] hist The history the windows will be read from
+ * \param[in] first The first channel
+ * \param[in] count The # of consecutive channels
+ * \param[in] mtIndeces The multithresholding variables, sets the bins kept
+*/
+template<typename T>
+multi_fft_vars<T> SetupMultiFFT(stft_history<T> &hist, const int &first, const int &count, const multi_thresh_indeces &mtIndeces)
+{
+	multi_fft_vars<T> vars;
+	vars.first = first;
+	vars.count = count;
+	vars.n = hist.n;
+	vars.bins = hist.n / 2 + 1;
+	vars.out = (typename fftw_api<T>::complex*)fftw_malloc(sizeof(typename fftw_api<T>::complex) * vars.bins * count);
+	vars.prefix = (double*)fftw_malloc(sizeof(double) * vars.bins * count);
+	BinRange(mtIndeces, vars.lo, vars.hi);
+
+	// Windows start 16-byte aligned in the aligned history, as the plan's SIMD
+	// codelets assume, only if all of these are multiples of 16 bytes of samples
+	const int align = 16 / sizeof(T);   // 2 doubles, 4 floats
+	unsigned extra = ((hist.n | hist.hop | hist.length) % align) ? FFTW_UNALIGNED : 0;
+	vars.p = GetPlan<T>(hist.n, false, count, hist.stride, extra);   // Planned on scratch arrays, history stays intact
+
+	return vars;
+}
+
+template<typename T>
+void FreeMultiFFT(multi_fft_vars<T> &vars)
+{
+	fftw_free(vars.out);
+	fftw_free(vars.prefix);
+}
+
+/* Transforms the window ending lag samples ago for every planned channel and
+ * prefix-sums their magnitudes
+ * \param[in] hist The history holding the windows
+ * \param[in] lag # of samples between the window end and the newest sample, <= n/2
+*/
+template<typename T>
+void MultiFFT(multi_fft_vars<T> &vars, const stft_history<T> &hist, const int &lag)
+{
+	// r2c plans preserve their input, so the history can be handed over as is
+	fftw_api<T>::execute_r2c(vars.p, (T*)WindowPtr(hist, vars.first, lag), vars.out);
+
+	for (int c = 0; c < vars.count; c++) {
+		MagnitudePrefix(vars.out + (long)c * vars.bins, vars.n, vars.lo, vars.hi, vars.prefix + (long)c * vars.bins);
+	}
+}
+
+/* Multithresholding of one channel after MultiFFT
+ * \param[in] ch The channel, within [first, first + count)
+ * \param[in] mtIndeces The multithresholding variables, within the planned bin range
+*/
+template<typename T>
+fft_analysis SpectrumAnalysis(const multi_fft_vars<T> &vars, const int &ch, const multi_thresh_indeces &mtIndeces)
+{
+	return PrefixAnalysis(vars.prefix + (long)(ch - vars.first) * vars.bins, vars.lo, mtIndeces);
+}
+
+#define INSTANTIATE_SPECTRUM(T) \
+	template multi_fft_vars<T> SetupMultiFFT(stft_history<T> &hist, const int &first, const int &count, const multi_thresh_indeces &mtIndeces); \
+	template void FreeMultiFFT(multi_fft_vars<T> &vars); \
+	template void MultiFFT(multi_fft_vars<T> &vars, const stft_history<T> &hist, const int &lag); \
+	template fft_analysis SpectrumAnalysis(const multi_fft_vars<T> &vars, const int &ch, const multi_thresh_indeces &mtIndeces);
+
+INSTANTIATE_SPECTRUM(double)
+INSTANTIATE_SPECTRUM(float)
@@ -0,0 +1,38 @@
+#ifndef SPECTRUM_H
+#define SPECTRUM_H
+
+#include <fftw3.h>
+#include "detection.h"
+#include "precision.h"
+#include "stft.h"
+
+/* Transforms a run of channels with one batched ("many") FFTW plan that reads
+ * the windows straight out of the stft_history block, so no samples are
+ * copied, and leaves every channel's prefix-summed magnitudes in one 2-D array.
+*/
+template<typename T>
+struct multi_fft_vars {
+	int first;   // First channel transformed
+	int count;   // # of channels transformed
+	int n;
+	int bins;   // # of r2c output bins per channel, n/2+1
+	typename fftw_api<T>::complex *out;   // [count][bins]
+	typename fftw_api<T>::plan p;
+	int lo;   // Bin range covered by the prefix sums, see BinRange
+	int hi;
+	double *prefix;   // [count][bins], channel first + c in row c
+};
+
+template<typename T>
+multi_fft_vars<T> SetupMultiFFT(stft_history<T> &hist, const int &first, const int &count, const multi_thresh_indeces &mtIndeces);
+
+template<typename T>
+void FreeMultiFFT(multi_fft_vars<T> &vars);
+
+template<typename T>
+void MultiFFT(multi_fft_vars<T> &vars, const stft_history<T> &hist, const int &lag);
+
+template<typename T>
+fft_analysis SpectrumAnalysis(const multi_fft_vars<T> &vars, const int &ch, const multi_thresh_indeces &mtIndeces);
+
+#endif
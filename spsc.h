@@ -0,0 +1,59 @@
+#ifndef SPSC_H
+#define SPSC_H
+
+#include <atomic>
+
+/* Indeces of a single-producer/single-consumer ring. The producer fills
+ * slot head % size and publishes it by advancing head, the consumer reads
+ * slot tail % size and frees it by advancing tail. Both only grow, so head -
+ * tail is the fill even as they wrap. No locks are taken on either side, the
+ * release of an index pairs with the other side's acquire of it.
+*/
+struct spsc_index {
+	std::atomic<unsigned long> head;   // # of slots published
+	std::atomic<unsigned long> tail;   // # of slots freed
+};
+
+inline void ResetSpsc(spsc_index &q)
+{
+	q.head.store(0, std::memory_order_relaxed);
+	q.tail.store(0, std::memory_order_relaxed);
+}
+
+// Producer only: the next slot # to fill
+inline unsigned long SpscHead(const spsc_index &q)
+{
+	return q.head.load(std::memory_order_relaxed);
+}
+
+// Consumer only: the next slot # to read
+inline unsigned long SpscTail(const spsc_index &q)
+{
+	return q.tail.load(std::memory_order_relaxed);
+}
+
+// Producer: whether slot # SpscHead is free in a ring of size slots
+inline bool SpscRoom(const spsc_index &q, const int &size)
+{
+	return q.head.load(std::memory_order_relaxed) - q.tail.load(std::memory_order_acquire) < (unsigned long)size;
+}
+
+// Producer: hands the filled slot to the consumer
+inline void SpscPublish(spsc_index &q)
+{
+	q.head.store(q.head.load(std::memory_order_relaxed) + 1, std::memory_order_release);
+}
+
+// Consumer: whether slot # index has been published
+inline bool SpscReady(const spsc_index &q, const unsigned long &index)
+{
+	return q.head.load(std::memory_order_acquire) > index;
+}
+
+// Consumer: hands every slot before # index back to the producer
+inline void SpscRelease(spsc_index &q, const unsigned long &index)
+{
+	q.tail.store(index, std::memory_order_release);
+}
+
+#endif
@@ -0,0 +1,125 @@
+#include <cstdlib>
+#include <cstring>
+#include <algorithm>
+#include <fftw3.h>
+#include "frames.h"
+#include "stft.h"
+
+
+/* Allocates the history for all channels
+ * \param[in] n The window length to analyse
+ * \param[in] hop The # of samples between consecutive windows
+ * \param[in] channels The # of channels to keep history for
+*/
+template<typename T>
+void SetupStftHistory(stft_history<T> &hist, const int &n, const int &hop, const int &channels)
+{
+	hist.n = n;
+	hist.hop = hop;
+	hist.channels = channels;
+	hist.length = n + n / 2;   // Keep the split window (half previous, half current) available
+	hist.stride = 2 * hist.length;
+	hist.block = (T*)fftw_malloc(sizeof(T) * hist.stride * channels);   // SIMD-aligned for FFTW
+	memset(hist.block, 0, sizeof(T) * hist.stride * channels);
+	hist.pos = 0;
+}
+
+template<typename T>
+void FreeStftHistory(stft_history<T> &hist)
+{
+	fftw_free(hist.block);
+}
+
+/* Forgets all history, e.g. after dropped samples made it discontiguous
+*/
+template<typename T>
+void ResetStftHistory(stft_history<T> &hist)
+{
+	hist.pos = 0;
+}
+
+/* Appends one block of hop samples to every channel, converting to T
+ * \param[in] **block The block, [channels][hop]
+*/
+template<typename T>
+void AppendHop(stft_history<T> &hist, double **block)
+{
+	int start = hist.pos % hist.length;
+	int first = std::min(hist.hop, hist.length - start);   // Samples before wrapping around
+
+	for (int ch = 0; ch < hist.channels; ch++) {
+		T *samples = hist.block + (long)ch * hist.stride;
+		std::copy(block[ch], block[ch] + first, samples + start);
+		std::copy(block[ch], block[ch] + first, samples + start + hist.length);
+		std::copy(block[ch] + first, block[ch] + hist.hop, samples);
+		std::copy(block[ch] + first, block[ch] + hist.hop, samples + hist.length);
+	}
+	hist.pos += hist.hop;
+}
+
+/* Appends one block of hop raw frames, converting and deinterleaving them
+ * straight into the history, then mirroring
+ * \param[in] *frames The block, [hop][channels] ADC codes
+*/
+template<typename T>
+void AppendHop(stft_history<T> &hist, const uint16_t *frames)
+{
+	int start = hist.pos % hist.length;
+	int first = std::min(hist.hop, hist.length - start);   // Samples before wrapping around
+
+	DeinterleaveFrames(frames, first, hist.channels, hist.block + start, (long)hist.stride);
+	DeinterleaveFrames(frames + (long)first * hist.channels, hist.hop - first, hist.channels, hist.block, (long)hist.stride);
+	for (int ch = 0; ch < hist.channels; ch++) {
+		T *samples = hist.block + (long)ch * hist.stride;
+		memcpy(samples + start + hist.length, samples + start, sizeof(T) * first);
+		memcpy(samples + hist.length, samples, sizeof(T) * (hist.hop - first));
+	}
+	hist.pos += hist.hop;
+}
+
+/* Whether enough contiguous samples are held for a window ending lag samples ago
+ * \param[in] lag # of samples between the window end and the newest sample, <= n/2
+*/
+template<typename T>
+bool WindowReady(const stft_history<T> &hist, const int &lag)
+{
+	return hist.pos >= hist.n + lag;
+}
+
+/* Points at one window inside the history, oldest sample first. Only valid
+ * until the next AppendHop.
+ * \param[in] ch The channel
+ * \param[in] lag # of samples between the window end and the newest sample, <= n/2
+ * \return The n contiguous samples of the window
+*/
+template<typename T>
+const T *WindowPtr(const stft_history<T> &hist, const int &ch, const int &lag)
+{
+	int start = (hist.pos - lag - hist.n) % hist.length;
+
+	return hist.block + (long)ch * hist.stride + start;
+}
+
+/* Copies one window out of the history, oldest sample first
+ * \param[in] ch The channel to copy
+ * \param[in] lag # of samples between the window end and the newest sample, <= n/2
+ * \param[in] *window The array to hold the n samples
+*/
+template<typename T>
+void CopyWindow(const stft_history<T> &hist, const int &ch, const int &lag, T *window)
+{
+	memcpy(window, WindowPtr(hist, ch, lag), sizeof(T) * hist.n);
+}
+
+#define INSTANTIATE_STFT(T) \
+	template void SetupStftHistory(stft_history<T> &hist, const int &n, const int &hop, const int &channels); \
+	template void FreeStftHistory(stft_history<T> &hist); \
+	template void ResetStftHistory(stft_history<T> &hist); \
+	template void AppendHop(stft_history<T> &hist, double **block); \
+	template void AppendHop(stft_history<T> &hist, const uint16_t *frames); \
+	template bool WindowReady(const stft_history<T> &hist, const int &lag); \
+	template const T *WindowPtr(const stft_history<T> &hist, const int &ch, const int &lag); \
+	template void CopyWindow(const stft_history<T> &hist, const int &ch, const int &lag, T *window);
+
+INSTANTIATE_STFT(double)
+INSTANTIATE_STFT(float)
@@ -0,0 +1,49 @@
+#ifndef STFT_H
+#define STFT_H
+
+#include <stdint.h>
+
+/* Sliding per-channel sample history for streaming analysis. Hop-sized blocks
+ * are appended as they arrive and any full window ending up to n/2 samples
+ * before the newest sample can be read back out.
+ * All channels share one aligned block, channel ch starting at ch * stride.
+ * Every sample is stored twice, length apart, so each window is contiguous
+ * in memory and can be transformed in place.
+ * Samples are kept as T, the precision they will be transformed in.
+*/
+template<typename T>
+struct stft_history {
+	int n;   // Window length
+	int hop;   // # of samples appended per block
+	int channels;
+	int length;   // # of samples kept per channel
+	int stride;   // # of samples between the starts of two channels
+	T *block;   // [channels][stride], circular and mirrored
+	long pos;   // # of samples appended since the last reset
+};
+
+template<typename T>
+void SetupStftHistory(stft_history<T> &hist, const int &n, const int &hop, const int &channels);
+
+template<typename T>
+void FreeStftHistory(stft_history<T> &hist);
+
+template<typename T>
+void ResetStftHistory(stft_history<T> &hist);
+
+template<typename T>
+void AppendHop(stft_history<T> &hist, double **block);
+
+template<typename T>
+void AppendHop(stft_history<T> &hist, const uint16_t *frames);
+
+template<typename T>
+bool WindowReady(const stft_history<T> &hist, const int &lag);
+
+template<typename T>
+const T *WindowPtr(const stft_history<T> &hist, const int &ch, const int &lag);
+
+template<typename T>
+void CopyWindow(const stft_history<T> &hist, const int &ch, const int &lag, T *window);
+
+#endif
@@ -0,0 +1,112 @@
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <algorithm>
+#include <chrono>
+#include "wavstream.h"
+
+
+/* Reader thread. Fills free blocks with sf_readf_double until the file ends
+ * or the stream is closed, waiting whenever the consumer is a full ring behind.
+*/
+static void ReadAhead(wav_stream &stream)
+{
+	while (stream.running) {
+		if (!SpscRoom(stream.queue, stream.size)) {
+			std::this_thread::sleep_for(std::chrono::milliseconds(1));   // Blocks are hundreds of ms of audio, polling is cheap
+			continue;
+		}
+
+		int b = SpscHead(stream.queue) % stream.size;
+		stream.counts[b] = sf_readf_double(stream.file, stream.blocks[b], stream.blockFrames);
+		if (stream.counts[b] > 0) {
+			SpscPublish(stream.queue);
+		}
+		if (stream.counts[b] < stream.blockFrames) {
+			break;
+		}
+	}
+	stream.eof.store(true, std::memory_order_release);
+}
+
+/* Opens a sound file and starts reading it ahead on a separate thread
+ * \param[in] fileName The sound file to stream
+ * \param[in] blockFrames The # of frames read per call
+ * \param[in] size The # of blocks buffered ahead of the consumer
+*/
+void OpenWavStream(wav_stream &stream, const char *fileName, const int &blockFrames, const int &size)
+{
+	SF_INFO sfinfo;
+
+	if (!(stream.file = sf_open(fileName, SFM_READ, &sfinfo))) {
+		printf("Not able to open sound file %s \n", fileName);
+		puts(sf_strerror(NULL));
+		exit(1);
+	}
+
+	stream.channels = sfinfo.channels;
+	stream.fs = sfinfo.samplerate;
+	stream.frames = sfinfo.frames;
+	stream.blockFrames = blockFrames;
+	stream.size = size;
+	stream.blocks = (double**)malloc(sizeof(double*) * size);
+	for (int i = 0; i < size; i++) {
+		stream.blocks[i] = (double*)malloc(sizeof(double) * blockFrames * stream.channels);
+	}
+	stream.counts = (long*)malloc(sizeof(long) * size);
+	ResetSpsc(stream.queue);
+	stream.eof = false;
+	stream.running = true;
+	stream.offset = 0;
+
+	printf("There are %d channels, %ld frames, rate is %d. \n", stream.channels, (long)stream.frames, stream.fs);
+
+	stream.reader = std::thread(ReadAhead, std::ref(stream));
+}
+
+void CloseWavStream(wav_stream &stream)
+{
+	stream.running = false;
+	stream.reader.join();
+	sf_close(stream.file);
+
+	for (int i = 0; i < stream.size; i++) {
+		free(stream.blocks[i]);
+	}
+	free(stream.blocks);
+	free(stream.counts);
+}
+
+/* Copies the next frames of the recording out of the ring, waiting for the
+ * reader where it has not caught up yet
+ * \param[in] *dst The array to hold the frames, [frames][channels]
+ * \param[in] frames The # of frames wanted
+ * \return The # of frames copied, fewer than requested only at the end of the file
+*/
+long ReadFrames(wav_stream &stream, double *dst, const long &frames)
+{
+	long done = 0;
+
+	while (done < frames) {
+		unsigned long tail = SpscTail(stream.queue);
+		if (!SpscReady(stream.queue, tail)) {
+			if (stream.eof.load(std::memory_order_acquire) && !SpscReady(stream.queue, tail)) {
+				break;
+			}
+			std::this_thread::sleep_for(std::chrono::milliseconds(1));
+			continue;
+		}
+
+		int b = tail % stream.size;
+		long take = std::min(frames - done, stream.counts[b] - stream.offset);
+		memcpy(dst + done * stream.channels, stream.blocks[b] + stream.offset * stream.channels, sizeof(double) * take * stream.channels);
+		done += take;
+		stream.offset += take;
+
+		if (stream.offset == stream.counts[b]) {
+			stream.offset = 0;
+			SpscRelease(stream.queue, tail + 1);   // Hand the block back to the reader
+		}
+	}
+	return done;
+}
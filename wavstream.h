@@ -0,0 +1,38 @@
+#ifndef WAVSTREAM_H
+#define WAVSTREAM_H
+
+#include <atomic>
+#include <thread>
+#include <sndfile.h>
+#include "spsc.h"
+
+const int WAV_BLOCK_FRAMES = 16384;   // Frames per sf_readf_double call, ~0.37 s at 44.1 kHz
+const int WAV_BLOCKS = 8;   // # of blocks read ahead of the analysis
+
+/* Reads a sound file of any length in fixed-size blocks, on its own thread,
+ * into a single-producer/single-consumer ring of reused buffers. Memory stays
+ * at size * blockFrames * channels doubles however long the recording is.
+*/
+struct wav_stream {
+	SNDFILE *file;
+	int channels;
+	int fs;
+	sf_count_t frames;   // Total # of frames as reported by the header
+	int blockFrames;
+	int size;   // # of blocks in the ring
+	double **blocks;   // [size][blockFrames * channels], interleaved as in the file
+	long *counts;   // # of frames actually read into each block
+	spsc_index queue;   // Blocks read and consumed
+	std::atomic<bool> eof;   // Set once the reader has published its last block
+	std::atomic<bool> running;
+	std::thread reader;
+	long offset;   // Consumer only: frames already taken from the oldest block
+};
+
+void OpenWavStream(wav_stream &stream, const char *fileName, const int &blockFrames = WAV_BLOCK_FRAMES, const int &size = WAV_BLOCKS);
+
+void CloseWavStream(wav_stream &stream);
+
+long ReadFrames(wav_stream &stream, double *dst, const long &frames);
+
+#endif
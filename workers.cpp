@@ -0,0 +1,143 @@
+#include "workers.h"
+
+
+static uint64_t PackRange(const uint64_t &begin, const uint64_t &end)
+{
+	return (begin << 32) | end;
+}
+
+/* Claims the first task left in a worker's own range
+ * \return False if the range is empty
+*/
+static bool PopTask(std::atomic<uint64_t> &range, int &task)
+{
+	uint64_t r = range.load(std::memory_order_acquire);
+	while ((r >> 32) < (r & 0xffffffff)) {
+		if (range.compare_exchange_weak(r, PackRange((r >> 32) + 1, r & 0xffffffff), std::memory_order_acq_rel)) {
+			task = r >> 32;
+			return true;
+		}
+	}
+	return false;
+}
+
+/* Takes the back half of the first non-empty range after this worker's own,
+ * runs its first task next and leaves the rest in the worker's own range
+ * \return False if every other range is empty
+*/
+static bool StealTask(worker_pool &pool, const int &worker, int &task)
+{
+	for (int i = 1; i < pool.size; i++) {
+		std::atomic<uint64_t> &victim = pool.ranges[(worker + i) % pool.size];
+		uint64_t r = victim.load(std::memory_order_acquire);
+		while ((r >> 32) < (r & 0xffffffff)) {
+			uint64_t begin = r >> 32, end = r & 0xffffffff;
+			uint64_t from = end - (end - begin + 1) / 2;
+			if (victim.compare_exchange_weak(r, PackRange(begin, from), std::memory_order_acq_rel)) {
+				task = from;
+				pool.ranges[worker].store(PackRange(from + 1, end), std::memory_order_release);
+				return true;
+			}
+		}
+	}
+	return false;
+}
+
+static void WorkerLoop(worker_pool &pool, const int worker)
+{
+	unsigned long seen = 0;
+
+	while (1) {
+		const worker_job *job;
+		int tasks;
+		bool steal;
+		{
+			std::unique_lock<std::mutex> lock(pool.m);
+			pool.start.wait(lock, [&] { return !pool.running || (pool.generation != seen); });
+			if (!pool.running) { return; }
+			seen = pool.generation;
+			job = pool.job;   // Not copied, a std::function copy may allocate
+			tasks = pool.tasks;
+			steal = pool.steal;
+		}
+
+		if (steal) {
+			int t;
+			while (PopTask(pool.ranges[worker], t) || StealTask(pool, worker, t)) {
+				(*job)(worker, t);
+			}
+		} else {
+			for (int t = worker; t < tasks; t += pool.size) {
+				(*job)(worker, t);
+			}
+		}
+
+		std::lock_guard<std::mutex> lock(pool.m);
+		if (--pool.pending == 0) { pool.done.notify_one(); }
+	}
+}
+
+/* Starts the worker threads, which then wait for work
+ * \param[in] size The # of workers
+*/
+void SetupWorkerPool(worker_pool &pool, const int &size)
+{
+	pool.size = size;
+	pool.generation = 0;
+	pool.pending = 0;
+	pool.tasks = 0;
+	pool.steal = false;
+	pool.job = NULL;
+	pool.ranges = std::vector<std::atomic<uint64_t>>(size);
+	pool.running = true;
+	for (int w = 0; w < size; w++) {
+		pool.threads.push_back(std::thread(WorkerLoop, std::ref(pool), w));
+	}
+}
+
+/* Runs job(worker, task) for every task in [0, tasks) and returns once all are done
+ * \param[in] tasks The # of tasks in this batch
+ * \param[in] job The work to do per task
+*/
+void RunOnPool(worker_pool &pool, const int &tasks, const worker_job &job)
+{
+	std::unique_lock<std::mutex> lock(pool.m);
+	pool.job = &job;
+	pool.tasks = tasks;
+	pool.steal = false;
+	pool.pending = pool.size;
+	pool.generation++;
+	pool.start.notify_all();
+	pool.done.wait(lock, [&] { return pool.pending == 0; });
+}
+
+/* As above, but any worker may run any task. Each worker starts on its own
+ * contiguous share of the tasks and steals from the others once it runs out.
+*/
+void RunOnPoolStealing(worker_pool &pool, const int &tasks, const worker_job &job)
+{
+	std::unique_lock<std::mutex> lock(pool.m);
+	for (int w = 0; w < pool.size; w++) {
+		pool.ranges[w].store(PackRange((long)tasks * w / pool.size, (long)tasks * (w + 1) / pool.size), std::memory_order_relaxed);
+	}
+	pool.job = &job;
+	pool.tasks = tasks;
+	pool.steal = true;
+	pool.pending = pool.size;
+	pool.generation++;
+	pool.start.notify_all();
+	pool.done.wait(lock, [&] { return pool.pending == 0; });
+}
+
+void FreeWorkerPool(worker_pool &pool)
+{
+	{
+		std::lock_guard<std::mutex> lock(pool.m);
+		pool.running = false;
+	}
+	pool.start.notify_all();
+	for (std::thread &t : pool.threads) {
+		t.join();
+	}
+	pool.threads.clear();
+}
@@ -0,0 +1,44 @@
+#ifndef WORKERS_H
+#define WORKERS_H
+
+#include <vector>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <functional>
+#include <atomic>
+#include <stdint.h>
+
+typedef std::function<void(const int &worker, const int &task)> worker_job;
+
+/* Fixed pool of threads that run one batch of tasks at a time. Task t always
+ * runs on worker t % size, so per-worker state (e.g. FFT plans) can be indexed
+ * by the worker number and results land in deterministic slots.
+ * RunOnPoolStealing instead deals out contiguous ranges of tasks and lets idle
+ * workers steal half of another worker's remaining range, for batches whose
+ * tasks differ widely in cost (e.g. recordings of different lengths).
+*/
+struct worker_pool {
+	int size;
+	std::vector<std::thread> threads;
+	std::mutex m;
+	std::condition_variable start;
+	std::condition_variable done;
+	unsigned long generation;   // Incremented for every batch
+	int pending;   // # of workers still busy with the current batch
+	int tasks;
+	const worker_job *job;   // The caller's, it outlives the batch since RunOnPool waits for it
+	bool steal;   // The current batch is work-stealing
+	std::vector<std::atomic<uint64_t>> ranges;   // Per worker: unclaimed tasks [begin, end), packed begin << 32 | end
+	bool running;
+};
+
+void SetupWorkerPool(worker_pool &pool, const int &size);
+
+void RunOnPool(worker_pool &pool, const int &tasks, const worker_job &job);
+
+void RunOnPoolStealing(worker_pool &pool, const int &tasks, const worker_job &job);
+
+void FreeWorkerPool(worker_pool &pool);
+
+#endif